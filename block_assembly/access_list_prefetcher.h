@@ -0,0 +1,203 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "xdr/transaction.h"
+#include "xdr/types.h"
+
+#include "config/static_constants.h"
+
+#include <utils/non_movable.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace scs
+{
+
+template<typename StateDB_t>
+class AccessListPrefetcher;
+
+/**
+ * A few helper threads, shared by every assembly worker, that walk
+ * the trie paths of queued txs' access lists while the workers
+ * execute the txs in front of them.
+ * A trie walk is a chain of dependent loads, so doing it here,
+ * rather than on a worker just before execution, is what lets
+ * the lookup latency overlap with execution.  The walk leaves the
+ * path in the shared last-level cache, which is all that a worker
+ * on another core can benefit from.
+ *
+ * The number of threads is fixed (ACCESS_LIST_PREFETCH_THREADS),
+ * not one per worker: a walk is mostly stalled on memory,
+ * so a few threads keep up with many workers.
+ *
+ * Reads only committed state, so every worker must cancel_and_wait()
+ * its AccessListPrefetcher before the state db is modified.
+ */
+template<typename StateDB_t>
+class AccessListPrefetchPool : public utils::NonMovableOrCopyable
+{
+	using prefetcher_t = AccessListPrefetcher<StateDB_t>;
+
+	struct Batch
+	{
+		prefetcher_t* owner;
+		std::vector<AddressAndKey> keys;
+	};
+
+	StateDB_t& state_db;
+
+	std::mutex mtx;
+	std::condition_variable cv;
+	bool done_flag = false;
+
+	// guarded by mtx
+	std::deque<Batch> queued;
+
+	std::vector<std::thread> threads;
+
+	friend class AccessListPrefetcher<StateDB_t>;
+
+	void run()
+	{
+		while (true)
+		{
+			Batch batch;
+			{
+				std::unique_lock lock(mtx);
+				cv.wait(lock,
+					[this]() { return done_flag || !queued.empty(); });
+				if (done_flag) {
+					return;
+				}
+				batch = std::move(queued.front());
+				queued.pop_front();
+				batch.owner->queued_batches--;
+				batch.owner->in_progress++;
+			}
+
+			for (auto const& key : batch.keys)
+			{
+				state_db.prefetch(key);
+			}
+
+			std::lock_guard lock(mtx);
+			batch.owner->in_progress--;
+			cv.notify_all();
+		}
+	}
+
+	// caller holds mtx
+	bool is_idle(prefetcher_t const& owner) const
+	{
+		return owner.queued_batches == 0 && owner.in_progress == 0;
+	}
+
+public:
+
+	AccessListPrefetchPool(StateDB_t& state_db,
+		uint32_t num_threads = ACCESS_LIST_PREFETCH_THREADS)
+		: state_db(state_db)
+	{
+		for (uint32_t i = 0; i < num_threads; i++)
+		{
+			threads.emplace_back([this] {run();});
+		}
+	}
+
+	~AccessListPrefetchPool()
+	{
+		{
+			std::lock_guard lock(mtx);
+			done_flag = true;
+			cv.notify_all();
+		}
+		for (auto& t : threads)
+		{
+			t.join();
+		}
+	}
+};
+
+/**
+ * One assembly worker's view of the shared AccessListPrefetchPool.
+ * Not threadsafe (one per worker).
+ */
+template<typename StateDB_t>
+class AccessListPrefetcher : public utils::NonMovableOrCopyable
+{
+	using pool_t = AccessListPrefetchPool<StateDB_t>;
+
+	pool_t& pool;
+
+	// guarded by pool.mtx
+	uint32_t queued_batches = 0;
+	uint32_t in_progress = 0;
+
+	friend pool_t;
+
+public:
+
+	AccessListPrefetcher(pool_t& pool)
+		: pool(pool)
+		{}
+
+	~AccessListPrefetcher()
+	{
+		cancel_and_wait();
+	}
+
+	// Access lists are unchecked hints, so cap the work
+	// that any one tx can make us do on its behalf.
+	void add(Transaction const& tx)
+	{
+		size_t len = std::min<size_t>(tx.access_list.size(), MAX_PREFETCH_ACCESS_LIST_LEN);
+		if (len == 0) {
+			return;
+		}
+		std::lock_guard lock(pool.mtx);
+		pool.queued.push_back(typename pool_t::Batch{
+			.owner = this,
+			.keys = std::vector<AddressAndKey>(tx.access_list.begin(), tx.access_list.begin() + len)});
+		queued_batches++;
+		pool.cv.notify_all();
+	}
+
+	// drops whatever of ours has not been prefetched yet,
+	// and waits for the walks of ours in progress
+	void cancel_and_wait()
+	{
+		std::unique_lock lock(pool.mtx);
+		std::erase_if(pool.queued, [this] (auto const& b) { return b.owner == this; });
+		queued_batches = 0;
+		pool.cv.wait(lock, [this] () { return pool.is_idle(*this); });
+	}
+
+	// waits until everything added has been prefetched
+	void wait_for_prefetches()
+	{
+		std::unique_lock lock(pool.mtx);
+		pool.cv.wait(lock, [this] () { return pool.is_idle(*this); });
+	}
+};
+
+} /* scs */
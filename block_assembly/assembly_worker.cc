@@ -28,8 +28,40 @@
 
 #include "crypto/hash.h"
 
+
 namespace scs {
 
+template<typename GlobalContext_t, typename BlockContext_t>
+void
+AssemblyWorker<GlobalContext_t, BlockContext_t>::fill_lookahead()
+{
+    while (lookahead.size() <= ACCESS_LIST_PREFETCH_DEPTH) {
+        auto tx = mempool.get_new_tx();
+        if (!tx) {
+            return;
+        }
+        prefetcher.add(tx->tx);
+        lookahead.push_back(std::move(*tx));
+    }
+}
+
+template<typename GlobalContext_t, typename BlockContext_t>
+void
+AssemblyWorker<GlobalContext_t, BlockContext_t>::stop_lookahead()
+{
+    // the state db is modified once assembly stops
+    prefetcher.cancel_and_wait();
+
+    if (lookahead.empty()) {
+        return;
+    }
+    std::vector<SignedTransaction> unused(
+        std::make_move_iterator(lookahead.begin()),
+        std::make_move_iterator(lookahead.end()));
+    lookahead.clear();
+    mempool.add_txs(std::move(unused));
+}
+
 template<typename GlobalContext_t, typename BlockContext_t>
 void
 AssemblyWorker<GlobalContext_t, BlockContext_t>::run(BlockContext_t& block_context, AssemblyLimits& limits)
@@ -40,22 +72,29 @@ AssemblyWorker<GlobalContext_t, BlockContext_t>::run(BlockContext_t& block_conte
         bool is_shutdown = limiter.wait_for_opening();
 
         if (is_shutdown) {
+            stop_lookahead();
             return;
         }
 
-        auto tx = mempool.get_new_tx();
-        if (!tx) {
+        fill_lookahead();
+
+        if (lookahead.empty()) {
             limits.notify_done();
+            stop_lookahead();
             return;
         }
 
-        auto reservation = limits.reserve_tx(*tx);
+        auto reservation = limits.reserve_tx(lookahead.front());
         if (!reservation) {
             limits.notify_done();
+            stop_lookahead();
             return;
         }
 
-        auto result = exec_ctx.execute(hash_xdr(*tx), *tx, global_context, block_context);
+        auto tx = std::move(lookahead.front());
+        lookahead.pop_front();
+
+        auto result = exec_ctx.execute(hash_xdr(tx), tx, global_context, block_context);
         if (result == TransactionStatus::SUCCESS) {
             reservation->commit();
         }
@@ -20,6 +20,7 @@
 #include <optional>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
 #include <vector>
 #include <memory>
 
@@ -27,6 +28,8 @@
 
 #include "transaction_context/execution_context.h"
 
+#include "block_assembly/access_list_prefetcher.h"
+
 
 namespace scs
 {
@@ -41,13 +44,28 @@ class AssemblyWorker
 	GlobalContext_t& global_context;
 	ExecutionContext<TransactionContext<GlobalContext_t>> exec_ctx;
 
+	// Txs pulled from the mempool but not yet executed.
+	// A tx's access list is handed to the prefetcher when the tx
+	// enters this window, ACCESS_LIST_PREFETCH_DEPTH txs before it executes.
+	std::deque<SignedTransaction> lookahead;
+
+	using prefetch_pool_t = AccessListPrefetchPool<decltype(GlobalContext_t::state_db)>;
+
+	AccessListPrefetcher<decltype(GlobalContext_t::state_db)> prefetcher;
+
 	using TxContext_t = typename BlockContext_t::tx_context_t;
 
+	void fill_lookahead();
+	// returns unexecuted txs to the mempool and stops prefetching
+	void stop_lookahead();
+
 public:
 
-	AssemblyWorker(Mempool& mempool, GlobalContext_t& global_context)
+	AssemblyWorker(Mempool& mempool, GlobalContext_t& global_context, prefetch_pool_t& prefetch_pool)
 		: mempool(mempool)
 		, global_context(global_context)
+		, lookahead()
+		, prefetcher(prefetch_pool)
 		{
 		}
 
@@ -173,11 +191,16 @@ AssemblyWorkerCache
 	Mempool& mempool;
 	GlobalContext_t& global_context;
 
+	// shared by this cache's workers, which are destroyed
+	// (in total_reset()) before it is
+	AccessListPrefetchPool<decltype(GlobalContext_t::state_db)> prefetch_pool;
+
 public:
 
 	AssemblyWorkerCache(Mempool& mp, GlobalContext_t& gc)
 		: mempool(mp)
 		, global_context(gc)
+		, prefetch_pool(gc.state_db)
 		{}
 
 	void start_assembly_threads(BlockContext_t* current_block_context, AssemblyLimits* limits, uint32_t n_threads)
@@ -187,7 +210,7 @@ public:
 		for (uint32_t i = 0; i < n_threads; i++)
 		{
 			StaticAsyncWorkerCache<GlobalContext_t, BlockContext_t>::get_worker(i)
-				.start_worker(current_block_context, limits, true, mempool, global_context);
+				.start_worker(current_block_context, limits, true, mempool, global_context, prefetch_pool);
 		}
 	}
 
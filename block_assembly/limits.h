@@ -73,6 +73,14 @@ class AssemblyLimits
         }
     };
 
+    // transactions not yet reserved (the block's limit, before assembly)
+    uint64_t remaining_txs() const
+    {
+        // reservations that fail briefly take this below 0
+        int64_t res = max_txs.load(std::memory_order_relaxed);
+        return res > 0 ? res : 0;
+    }
+
     void notify_done();
 
     std::optional<Reservation> reserve_tx(SignedTransaction const& tx);
@@ -0,0 +1,319 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "block_assembly/access_list_prefetcher.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace scs {
+
+namespace test {
+
+struct PrefetchRecordingStateDB
+{
+    std::mutex mtx;
+    std::vector<AddressAndKey> prefetched;
+    std::vector<std::thread::id> threads;
+
+    // prefetch() spins while closed
+    std::atomic<bool> gate_open = true;
+    std::atomic<bool> entered = false;
+
+    void prefetch(AddressAndKey const& key)
+    {
+        entered = true;
+        while (!gate_open) {
+            std::this_thread::yield();
+        }
+        std::lock_guard lock(mtx);
+        prefetched.push_back(key);
+        threads.push_back(std::this_thread::get_id());
+    }
+};
+
+Transaction
+prefetch_test_tx(uint64_t first_key, uint64_t num_keys)
+{
+    Transaction tx;
+    for (uint64_t i = 0; i < num_keys; i++) {
+        AddressAndKey key;
+        key.fill(0);
+        uint64_t k = first_key + i;
+        std::memcpy(key.data(), &k, sizeof(k));
+        tx.access_list.push_back(key);
+    }
+    return tx;
+}
+
+// Stand-in for a trie much larger than the last-level cache:
+// a lookup is a chain of dependent loads at random places.
+struct PointerChaseStateDB
+{
+    constexpr static uint64_t LOG_ENTRIES = 26;
+    constexpr static uint64_t MASK = (uint64_t(1) << LOG_ENTRIES) - 1;
+    constexpr static uint32_t DEPTH = 8;
+
+    std::vector<uint64_t> table;
+
+    PointerChaseStateDB()
+        : table(MASK + 1)
+    {
+        std::minstd_rand gen(1);
+        for (auto& e : table) {
+            e = ((uint64_t(gen()) << 31) ^ gen()) & MASK;
+        }
+    }
+
+    uint64_t lookup(AddressAndKey const& key) const
+    {
+        uint64_t pos;
+        std::memcpy(&pos, key.data(), sizeof(pos));
+        pos = (pos * 0x9E37'79B9'7F4A'7C15ull) & MASK;
+        for (uint32_t i = 0; i < DEPTH; i++) {
+            pos = table[pos];
+        }
+        return pos;
+    }
+
+    void prefetch(AddressAndKey const& key)
+    {
+        [[maybe_unused]] volatile uint64_t res = lookup(key);
+    }
+};
+
+// Each worker executes its own txs in order, handing each tx to
+// the prefetcher (if any) ACCESS_LIST_PREFETCH_DEPTH txs ahead.
+// Returns ns per tx.
+double
+run_prefetch_bench(PointerChaseStateDB& db,
+                   AccessListPrefetchPool<PointerChaseStateDB>* pool,
+                   uint32_t num_workers,
+                   uint32_t txs_per_worker)
+{
+    constexpr uint64_t KEYS_PER_TX = 8;
+    constexpr uint32_t EXEC_WORK = 2000;
+
+    std::atomic<uint64_t> sink = 0;
+
+    auto worker = [&](uint32_t w) {
+        std::optional<AccessListPrefetcher<PointerChaseStateDB>> prefetcher;
+        if (pool) {
+            prefetcher.emplace(*pool);
+        }
+        std::deque<Transaction> lookahead;
+        uint64_t next_tx = 0, acc = 0;
+        const uint64_t base = uint64_t(w) << 40;
+
+        for (uint32_t done = 0; done < txs_per_worker; done++) {
+            while (lookahead.size() <= ACCESS_LIST_PREFETCH_DEPTH
+                   && next_tx < txs_per_worker) {
+                lookahead.push_back(prefetch_test_tx(
+                    base + (next_tx++) * KEYS_PER_TX, KEYS_PER_TX));
+                if (prefetcher) {
+                    prefetcher->add(lookahead.back());
+                }
+            }
+            for (auto const& key : lookahead.front().access_list) {
+                acc += db.lookup(key);
+            }
+            for (uint32_t i = 0; i < EXEC_WORK; i++) {
+                acc = acc * 6364136223846793005ull + 1442695040888963407ull;
+            }
+            lookahead.pop_front();
+        }
+        sink += acc;
+    };
+
+    auto ts = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t w = 0; w < num_workers; w++) {
+        threads.emplace_back(worker, w);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - ts)
+                       .count();
+    return static_cast<double>(elapsed) / (uint64_t(num_workers) * txs_per_worker);
+}
+
+} // namespace test
+
+using namespace test;
+
+TEST_CASE("access list prefetch", "[assembly]")
+{
+    PrefetchRecordingStateDB db;
+    AccessListPrefetchPool<PrefetchRecordingStateDB> pool(db, 2);
+    AccessListPrefetcher<PrefetchRecordingStateDB> prefetcher(pool);
+
+    SECTION("runs off the calling thread")
+    {
+        prefetcher.add(prefetch_test_tx(0, 10));
+        prefetcher.add(prefetch_test_tx(10, 10));
+        prefetcher.wait_for_prefetches();
+
+        REQUIRE(db.prefetched.size() == 20);
+        for (auto const& id : db.threads) {
+            REQUIRE(id != std::this_thread::get_id());
+        }
+    }
+
+    SECTION("add does not wait for the prefetch")
+    {
+        db.gate_open = false;
+        prefetcher.add(prefetch_test_tx(0, 1));
+
+        while (!db.entered) {
+            std::this_thread::yield();
+        }
+        // a helper is stuck in prefetch(), but add() still returns
+        prefetcher.add(prefetch_test_tx(1, 1));
+
+        db.gate_open = true;
+        prefetcher.wait_for_prefetches();
+        REQUIRE(db.prefetched.size() == 2);
+    }
+
+    SECTION("access lists are capped")
+    {
+        prefetcher.add(prefetch_test_tx(0, MAX_PREFETCH_ACCESS_LIST_LEN + 100));
+        prefetcher.wait_for_prefetches();
+        REQUIRE(db.prefetched.size() == MAX_PREFETCH_ACCESS_LIST_LEN);
+    }
+
+    SECTION("cancel drops queued keys and waits for the walk in progress")
+    {
+        AccessListPrefetchPool<PrefetchRecordingStateDB> one_thread(db, 1);
+        AccessListPrefetcher<PrefetchRecordingStateDB> p(one_thread);
+
+        db.gate_open = false;
+        p.add(prefetch_test_tx(0, 1));
+        while (!db.entered) {
+            std::this_thread::yield();
+        }
+        p.add(prefetch_test_tx(1, 10));
+
+        std::thread opener([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            db.gate_open = true;
+        });
+
+        p.cancel_and_wait();
+        opener.join();
+
+        // the walk in progress finished before cancel_and_wait() returned
+        REQUIRE(db.prefetched.size() == 1);
+    }
+}
+
+TEST_CASE("access list prefetch pool is shared", "[assembly]")
+{
+    PrefetchRecordingStateDB db;
+    AccessListPrefetchPool<PrefetchRecordingStateDB> pool(db, 2);
+
+    constexpr uint32_t NUM_WORKERS = 8;
+    std::vector<std::unique_ptr<AccessListPrefetcher<PrefetchRecordingStateDB>>> prefetchers;
+    for (uint32_t i = 0; i < NUM_WORKERS; i++) {
+        prefetchers.push_back(
+            std::make_unique<AccessListPrefetcher<PrefetchRecordingStateDB>>(pool));
+    }
+
+    SECTION("more workers than threads")
+    {
+        for (uint32_t i = 0; i < NUM_WORKERS; i++) {
+            prefetchers[i]->add(prefetch_test_tx(100 * i, 10));
+        }
+        for (auto& p : prefetchers) {
+            p->wait_for_prefetches();
+        }
+        REQUIRE(db.prefetched.size() == 10 * NUM_WORKERS);
+
+        std::set<std::thread::id> ids(db.threads.begin(), db.threads.end());
+        REQUIRE(ids.size() <= 2);
+    }
+
+    SECTION("cancel only drops the caller's keys")
+    {
+        db.gate_open = false;
+        prefetchers[0]->add(prefetch_test_tx(0, 1));
+        prefetchers[0]->add(prefetch_test_tx(1, 1));
+        while (!db.entered) {
+            std::this_thread::yield();
+        }
+        // both threads may be stuck on worker 0's keys,
+        // so worker 1's stay queued until the gate opens
+        prefetchers[1]->add(prefetch_test_tx(100, 5));
+        prefetchers[0]->add(prefetch_test_tx(2, 5));
+
+        std::thread opener([&] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            db.gate_open = true;
+        });
+        prefetchers[0]->cancel_and_wait();
+        opener.join();
+
+        prefetchers[1]->wait_for_prefetches();
+
+        uint32_t from_1 = 0;
+        for (auto const& key : db.prefetched) {
+            uint64_t k;
+            std::memcpy(&k, key.data(), sizeof(k));
+            from_1 += (k >= 100);
+        }
+        REQUIRE(from_1 == 5);
+        REQUIRE(db.prefetched.size() <= 2 + 5);
+    }
+}
+
+TEST_CASE("access list prefetch speedup", "[.][assembly][bench]")
+{
+    PointerChaseStateDB db;
+    const uint32_t num_workers
+        = std::max<uint32_t>(1, std::thread::hardware_concurrency() / 2);
+    constexpr uint32_t TXS_PER_WORKER = 20'000;
+
+    double without = run_prefetch_bench(db, nullptr, num_workers, TXS_PER_WORKER);
+
+    AccessListPrefetchPool<PointerChaseStateDB> pool(db);
+    double with = run_prefetch_bench(db, &pool, num_workers, TXS_PER_WORKER);
+
+    std::printf("access list prefetch: %" PRIu32 " workers, %" PRIu32
+                " helpers: %.1f ns/tx without, %.1f ns/tx with\n",
+                num_workers,
+                ACCESS_LIST_PREFETCH_THREADS,
+                without,
+                with);
+}
+
+} // namespace scs
@@ -36,6 +36,19 @@ print_configs()
     std::printf("TLCACHE_SIZE = %" PRIu32 "\n", TLCACHE_SIZE);
     std::printf("Sisyphus SDB iface = %s\n", typeid(SisyphusStateDB::storage_t).name());
     std::printf("Persistence  = %u\n", PERSISTENT_STORAGE_ENABLED);
+    std::printf("Key log segment = %" PRIu64 " bytes, queue depth %" PRIu32 "\n",
+        KEY_LOG_SEGMENT_BYTES, KEY_LOG_QUEUE_DEPTH);
+    std::printf("Async io queue depth = %" PRIu32 ", chunk %" PRIu64 " bytes\n",
+        ASYNC_IO_QUEUE_DEPTH, ASYNC_IO_CHUNK_BYTES);
+    std::printf("RDB bulk load = at most %" PRIu32 " files of at least %" PRIu64 " entries\n",
+        RDB_BULK_LOAD_MAX_FILES, RDB_BULK_LOAD_MIN_FILE_ENTRIES);
+    std::printf("State snapshots = %u\n", STATE_SNAPSHOTS_ENABLED);
+    std::printf("Checkpoint every %" PRIu32 " blocks (index stride %" PRIu32 ")\n",
+        STATE_CHECKPOINT_INTERVAL_BLOCKS, CHECKPOINT_INDEX_STRIDE);
+    std::printf("Prefetch depth = %" PRIu32 " (%" PRIu32 " threads)\n",
+        ACCESS_LIST_PREFETCH_DEPTH, ACCESS_LIST_PREFETCH_THREADS);
+    std::printf("NN_INT64 stripes = %" PRIu32 " (after %" PRIu32 " deltas)\n",
+        NN_INT64_STRIPES, NN_INT64_HOT_THRESHOLD);
     std::printf("Sisyphus SDB USE_ASSETS = %u\n", SisyphusStateDB::USE_ASSETS);
     std::printf("Sisyphus SDB USE_PEDERSEN = %u\n", SisyphusStateDB::USE_PEDERSEN);
 }
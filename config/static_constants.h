@@ -29,4 +29,43 @@ static_assert (static_cast<uint32_t>(1) << TLCACHE_BITS_REQUIRED == TLCACHE_SIZE
 
 constexpr static bool PERSISTENT_STORAGE_ENABLED = true;
 
+// modified-key log: size of each preallocated segment file,
+// and how many blocks can wait to be written before
+// block production stalls
+constexpr static uint64_t KEY_LOG_SEGMENT_BYTES = static_cast<uint64_t>(1) << 28;
+constexpr static uint32_t KEY_LOG_QUEUE_DEPTH = 4;
+
+// persistence I/O: io_uring submission queue size, and the size
+// of the pieces that large reads/writes are split into
+constexpr static uint32_t ASYNC_IO_QUEUE_DEPTH = 64;
+constexpr static uint64_t ASYNC_IO_CHUNK_BYTES = static_cast<uint64_t>(1) << 20;
+
+// rocksdb bulk loads: a block's values are split into at most
+// this many SST files (written in parallel), each with at least
+// RDB_BULK_LOAD_MIN_FILE_ENTRIES entries (unless the block is smaller)
+constexpr static uint32_t RDB_BULK_LOAD_MAX_FILES = 16;
+constexpr static uint64_t RDB_BULK_LOAD_MIN_FILE_ENTRIES = 1 << 16;
+
+// keep read-only per-block snapshots of committed state for query threads.
+// Costs a second in-memory copy of every committed value, so off by default.
+constexpr static bool STATE_SNAPSHOTS_ENABLED = false;
+
+// write a full state checkpoint (from the snapshots, or else by replaying
+// the key logs) every this many blocks, after which older key logs are deleted
+constexpr static uint32_t STATE_CHECKPOINT_INTERVAL_BLOCKS = 1000;
+// entries per index entry in a checkpoint file
+constexpr static uint32_t CHECKPOINT_INDEX_STRIDE = 4096;
+
+// how many txs ahead of execution to prefetch declared access lists
+constexpr static uint32_t ACCESS_LIST_PREFETCH_DEPTH = 4;
+// helper threads that do the prefetching, shared by all assembly workers
+constexpr static uint32_t ACCESS_LIST_PREFETCH_THREADS = 4;
+// entries of an access list past this are ignored
+constexpr static uint32_t MAX_PREFETCH_ACCESS_LIST_LEN = 64;
+
+// nonnegative int64 objects with more deltas than this in a block
+// switch to striped accumulators
+constexpr static uint32_t NN_INT64_HOT_THRESHOLD = 64;
+constexpr static uint32_t NN_INT64_STRIPES = 16;
+
 }
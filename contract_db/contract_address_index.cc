@@ -0,0 +1,97 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "contract_db/contract_address_index.h"
+
+#include "utils/seeded_hash.h"
+
+#include <sodium.h>
+
+#include <stdexcept>
+
+namespace scs {
+
+ContractAddressIndex::ContractAddressIndex()
+    : table(MIN_TABLE_SIZE)
+    , num_entries(0)
+{
+    randombytes_buf(&seed, sizeof(seed));
+}
+
+uint64_t
+ContractAddressIndex::hash(Address const& addr) const
+{
+    return seeded_hash(addr, seed);
+}
+
+bool
+ContractAddressIndex::place(Address const& addr, RunnableScriptView script)
+{
+    const size_t mask = table.size() - 1;
+    for (size_t pos = hash(addr) & mask;; pos = (pos + 1) & mask) {
+        auto& slot = table[pos];
+        if (!slot.occupied) {
+            slot.addr = addr;
+            slot.script = script;
+            slot.occupied = true;
+            return true;
+        }
+        if (slot.addr == addr) {
+            return false;
+        }
+    }
+}
+
+void
+ContractAddressIndex::grow()
+{
+    std::vector<Slot> old(table.size() * 2);
+    std::swap(old, table);
+    for (auto const& slot : old) {
+        if (slot.occupied) {
+            place(slot.addr, slot.script);
+        }
+    }
+}
+
+void
+ContractAddressIndex::insert(Address const& addr, RunnableScriptView script)
+{
+    if (2 * (num_entries + 1) > table.size()) {
+        grow();
+    }
+    if (!place(addr, script)) {
+        throw std::runtime_error("double insert into contract address index");
+    }
+    num_entries++;
+}
+
+std::optional<RunnableScriptView>
+ContractAddressIndex::find(Address const& addr) const
+{
+    const size_t mask = table.size() - 1;
+    for (size_t pos = hash(addr) & mask;; pos = (pos + 1) & mask) {
+        auto const& slot = table[pos];
+        if (!slot.occupied) {
+            return std::nullopt;
+        }
+        if (slot.addr == addr) {
+            return slot.script;
+        }
+    }
+}
+
+} // namespace scs
@@ -0,0 +1,79 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "xdr/types.h"
+
+#include "contract_db/runnable_script.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace scs {
+
+/**
+ * Committed deployments, for lookups on the execution path
+ * (the merkle trie in ContractDB is only for hashing).
+ *
+ * Open-addressed (linear probing) table, kept at most half full,
+ * storing each address's script view inline, so a lookup is
+ * (usually) one cache miss and takes no locks.
+ *
+ * Addresses are hashed with seeded_hash(), seeded at construction,
+ * so deployers cannot grind addresses into one probe sequence.
+ *
+ * IMPORTANT:
+ * insert() cannot be called concurrently with find().
+ * Inserts happen only in ContractDB::commit(), between blocks.
+ */
+class ContractAddressIndex
+{
+    struct Slot
+    {
+        Address addr;
+        RunnableScriptView script;
+        bool occupied = false;
+    };
+
+    constexpr static size_t MIN_TABLE_SIZE = 1 << 10;
+
+    std::vector<Slot> table;
+    size_t num_entries = 0;
+
+    uint64_t seed;
+
+    uint64_t hash(Address const& addr) const;
+
+    // table has room
+    bool place(Address const& addr, RunnableScriptView script);
+
+    void grow();
+
+  public:
+    ContractAddressIndex();
+
+    // Throws if addr is already present.
+    void insert(Address const& addr, RunnableScriptView script);
+
+    // nullopt if nothing is deployed at addr
+    std::optional<RunnableScriptView> find(Address const& addr) const;
+
+    size_t size() const { return num_entries; }
+};
+
+} // namespace scs
@@ -22,14 +22,26 @@
 
 #include "contract_db/contract_db_proxy.h"
 
+#include "crypto/hash.h"
+
 #include "debug/debug_utils.h"
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <utils/time.h>
+
+#include <cstdio>
+#include <vector>
+
 namespace scs {
 
 ContractDB::ContractDB()
     : addresses_to_contracts_map()
+    , address_index()
     , hashes_to_contracts_map()
     , uncommitted_contracts()
+    , metered_cache()
     , persistence("contract_log/")
 {}
 
@@ -46,20 +58,18 @@ ContractDB::assert_not_uncommitted_modifications() const
 RunnableScriptView
 ContractDB::get_script_by_address(Address const& addr) const
 {
-    auto const* contract = addresses_to_contracts_map.get_value_nolocks(addr);
-    if (contract == nullptr)
+    auto script = address_index.find(addr);
+    if (!script)
     {
         return null_script;
     }
 
-    auto const* metered_script_out = contract -> contract.get();
-
-    if (metered_script_out == nullptr || metered_script_out -> to_view().data == nullptr)
+    if (script -> data == nullptr)
     {
         throw std::runtime_error("invalid script stored within ContractDB!");
     }
 
-    return metered_script_out -> to_view();//{ metered_script_out -> data(), metered_script_out -> size()};
+    return *script;
 }
 
 RunnableScriptView
@@ -90,16 +100,32 @@ ContractDB::commit_registration(Address const& new_address,
 {
     auto ptr = hashes_to_contracts_map.at(contract_hash);
 
-    if (addresses_to_contracts_map.get_value_nolocks(new_address) != nullptr)
+    if (address_index.find(new_address))
     {
         throw std::runtime_error("double registration of a contract");
     }
 
+    address_index.insert(new_address, ptr -> to_view());
     addresses_to_contracts_map.insert(new_address, value_t(ptr));
 
     persistence.log_deploy(new_address, contract_hash);
 }
 
+bool
+ContractDB::check_address_open_for_deployment(const Address& addr) const
+{
+    return !address_index.find(addr);
+}
+
+bool
+ContractDB::try_claim_deploy_address(Address const& addr)
+{
+    if (!check_address_open_for_deployment(addr)) {
+        return false;
+    }
+    return uncommitted_contracts.try_claim_address(addr);
+}
+
 void
 ContractDB::deploy_contract_to_address(Address const& addr,
                                        Hash const& script_hash)
@@ -115,6 +141,27 @@ ContractDB::check_committed_contract_exists(const Hash& contract_hash) const
            != hashes_to_contracts_map.end();
 }
 
+void
+ContractDB::premeter_contracts(std::span<const Contract> contracts)
+{
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, contracts.size(), 1),
+        [&] (auto r) {
+            for (size_t i = r.begin(); i < r.end(); i++) {
+                Hash h = hash_xdr(contracts[i]);
+                if (!check_committed_contract_exists(h)) {
+                    metered_cache.get_or_meter(h, contracts[i]);
+                }
+            }
+        });
+}
+
+void
+ContractDB::prepare_for_block(uint64_t max_txs)
+{
+    assert_not_uncommitted_modifications();
+    uncommitted_contracts.reserve_deploy_claims(max_txs);
+}
+
 void
 ContractDB::add_new_uncommitted_contract(
     Hash const& h, 
@@ -130,6 +177,7 @@ void
 ContractDB::commit(uint32_t timestamp)
 {
     uncommitted_contracts.commit(*this);
+    metered_cache.clear();
     has_uncommitted_modifications.store(false, std::memory_order_relaxed);
     persistence.write(timestamp);
 }
@@ -138,6 +186,7 @@ void
 ContractDB::rewind()
 {
     uncommitted_contracts.clear();
+    metered_cache.clear();
     has_uncommitted_modifications.store(false, std::memory_order_relaxed);
     persistence.nowrite();
 }
@@ -153,4 +202,60 @@ ContractDB::hash()
 
 }
 
+bool
+ContractDB::restore_from_disk(uint32_t max_round)
+{
+    assert_not_uncommitted_modifications();
+
+    auto ts = utils::init_time_measurement();
+
+    // Contracts are made durable before the key log, so the store
+    // can hold rounds after max_round that the restored chain never
+    // reached.  They would otherwise sit in front of the rounds this
+    // node writes next, and replay on a later restart.
+    persistence.truncate_after(max_round);
+
+    ContractStoreReader reader(persistence.get_folder());
+    if (reader.empty()) {
+        return false;
+    }
+
+    std::vector<std::pair<Hash, std::span<const uint8_t>>> stored;
+    reader.for_each_contract(max_round, [&] (Hash const& h, std::span<const uint8_t> bytes) {
+        stored.emplace_back(h, bytes);
+    });
+
+    // metering dominates, and is independent per contract
+    std::vector<metered_contract_ptr_t> metered(stored.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, stored.size()),
+        [&] (auto r) {
+            for (size_t i = r.begin(); i < r.end(); i++) {
+                auto const& bytes = stored[i].second;
+                auto unmetered = std::make_shared<const Contract>(bytes.begin(), bytes.end());
+                metered[i] = std::make_shared<const MeteredContract>(unmetered);
+            }
+        });
+
+    for (size_t i = 0; i < stored.size(); i++) {
+        commit_contract_to_db(stored[i].first, std::move(metered[i]));
+    }
+
+    // a later deployment to an address (e.g. genesis, after a rerun)
+    // overrides an earlier one
+    std::map<Address, Hash> deployments;
+    reader.for_each_deployment(max_round, [&] (ContractStoreDeployment const& d) {
+        deployments[d.address] = d.hash;
+    });
+
+    for (auto const& [addr, h] : deployments) {
+        auto const& ptr = hashes_to_contracts_map.at(h);
+        address_index.insert(addr, ptr -> to_view());
+        addresses_to_contracts_map.insert(addr, value_t(ptr));
+    }
+
+    std::printf("restored %zu contracts, %zu deployments in %lf\n",
+                stored.size(), deployments.size(), utils::measure_time(ts));
+    return true;
+}
+
 } // namespace scs
@@ -31,9 +31,13 @@
 
 #include "metering_ffi/metered_contract.h"
 
+#include "contract_db/contract_address_index.h"
 #include "contract_db/contract_persistence.h"
+#include "contract_db/metered_contract_cache.h"
 #include "contract_db/runnable_script.h"
 
+#include <span>
+
 namespace scs {
 
 class ContractDB
@@ -71,11 +75,16 @@ class ContractDB
     using contract_map_t
         = trie::MerkleTrie<prefix_t, value_t, metadata_t>;
 
+    // only for hashing; lookups go through address_index
     contract_map_t addresses_to_contracts_map;
+    ContractAddressIndex address_index;
     std::map<Hash, metered_contract_ptr_t> hashes_to_contracts_map;
 
     UncommittedContracts uncommitted_contracts;
 
+    // cleared when the block's contracts are committed (or rewound)
+    MeteredContractCache metered_cache;
+
     std::atomic<bool> has_uncommitted_modifications = false;
 
     AsyncPersistContracts persistence;
@@ -94,9 +103,12 @@ class ContractDB
     friend class ContractDeployClosure;
     friend class ContractDBProxy;
 
-    void undo_deploy_contract_to_address(Address const& addr)
+    // false if addr is deployed to, or claimed by another tx this block
+    bool try_claim_deploy_address(Address const& addr);
+
+    void release_deploy_address(Address const& addr)
     {
-        uncommitted_contracts.undo_deploy_contract_to_address(addr);
+        uncommitted_contracts.release_address(addr);
     }
 
     void
@@ -121,11 +133,36 @@ class ContractDB
 
     bool check_committed_contract_exists(const Hash& contract_hash) const;
 
+    // Meters a transaction's deployable contracts (those not already
+    // committed) in parallel, ahead of CONTRACT_CREATE.
+    void premeter_contracts(std::span<const Contract> contracts);
+
+    // Sizes the block's deploy address claims for the deployments
+    // recent blocks made (at most one per transaction).
+    // Call before the block executes.
+    void prepare_for_block(uint64_t max_txs);
+
     void commit(uint32_t timestamp);
 
     void rewind();
 
     Hash hash();
+
+    /**
+     * Reinstalls every contract and deployment persisted
+     * in rounds at or before max_round
+     * (instead of install_genesis_contracts()).
+     * Deletes any persisted rounds after max_round, so that
+     * the next commit continues from max_round.
+     * Returns false if nothing was persisted.
+     */
+    bool restore_from_disk(uint32_t max_round);
+
+    // Blocks until every committed round is durable.
+    void wait_for_persistence()
+    {
+        persistence.wait_for_async_task();
+    }
 };
 
 } // namespace scs
@@ -70,10 +70,27 @@ ContractDeployClosure::ContractDeployClosure(
     , contract_db(contract_db)
 {}
 
+ContractDeployClosure::ContractDeployClosure(ContractDeployClosure&& other)
+    : deploy_address(other.deploy_address)
+    , contract_hash(other.contract_hash)
+    , contract_db(other.contract_db)
+    , do_release(other.do_release)
+{
+    other.do_release = false;
+}
+
 void
 ContractDeployClosure::commit()
 {
     contract_db.deploy_contract_to_address(deploy_address, contract_hash);
+    do_release = false;
+}
+
+ContractDeployClosure::~ContractDeployClosure()
+{
+    if (do_release) {
+        contract_db.release_deploy_address(deploy_address);
+    }
 }
 
 bool
@@ -98,6 +115,9 @@ ContractDBProxy::deploy_contract(const Address& sender_address,
     if (new_deployments.find(deploy_address) != new_deployments.end()) {
         return std::nullopt;
     }
+    if (!contract_db.check_address_open_for_deployment(deploy_address)) {
+        return std::nullopt;
+    }
 
     new_deployments[deploy_address] = contract_hash;
     return {deploy_address};
@@ -131,7 +151,22 @@ ContractDBProxy::create_contract(std::shared_ptr<const Contract> contract)
     // This is where gas metering, or verification, or whatever other checks
     // on new contracts should take place
     Hash h = hash_xdr(*contract);
-    new_contracts[h] = std::make_pair(std::make_shared<const MeteredContract>(contract), contract);
+    if (!check_contract_exists(h)) {
+        auto entry = contract_db.metered_cache.get_or_meter(h, contract);
+        new_contracts[h] = std::make_pair(entry.metered, entry.unmetered);
+    }
+    return h;
+}
+
+Hash
+ContractDBProxy::create_contract(Contract const& contract)
+{
+    Hash h = hash_xdr(contract);
+    if (!check_contract_exists(h)) {
+        // only copies the contract if no other tx created it this block
+        auto entry = contract_db.metered_cache.get_or_meter(h, contract);
+        new_contracts[h] = std::make_pair(entry.metered, entry.unmetered);
+    }
     return h;
 }
 
@@ -142,19 +177,24 @@ ContractDBProxy::push_create_contract(
     return ContractCreateClosure(h, contract.first, contract.second, contract_db);
 }
 
-void
+bool
 ContractDBProxy::push_updates_to_db(TransactionRewind& rewind)
 {
     assert_not_committed();
     is_committed = true;
     
     for (auto const& [addr, hash] : new_deployments) {
+        if (!contract_db.try_claim_deploy_address(addr)) {
+            // claims already taken are released with the rewind
+            return false;
+        }
         rewind.add(push_deploy_contract(addr, hash));
     }
 
     for (auto const& [hash, script] : new_contracts) {
         rewind.add(push_create_contract(hash, script));
     }
+    return true;
 }
 
 RunnableScriptView
@@ -53,18 +53,25 @@ class ContractCreateClosure : public utils::NonCopyable
     ~ContractCreateClosure();
 };
 
-class ContractDeployClosure
+// Holds the claim on deploy_address until commit (or release).
+class ContractDeployClosure : public utils::NonCopyable
 {
     const Address& deploy_address;
     const Hash& contract_hash;
     ContractDB& contract_db;
 
+    bool do_release = true;
+
   public:
     ContractDeployClosure(const Address& deploy_address,
                           const Hash& contract_hash,
                           ContractDB& contract_db);
 
+    ContractDeployClosure(ContractDeployClosure&& other);
+
     void commit();
+
+    ~ContractDeployClosure();
 };
 
 class ContractDBProxy
@@ -110,9 +117,13 @@ class ContractDBProxy
     deploy_contract_at_specific_address(const Address& deploy_address,
       const Hash& contract_hash);
 
+    // Already existing contracts are not created again.
     Hash create_contract(std::shared_ptr<const Contract> contract);
+    Hash create_contract(Contract const& contract);
 
-    void push_updates_to_db(TransactionRewind& rewind);
+    // false if another tx this block deploys to one of the same addresses
+    bool __attribute__((warn_unused_result))
+    push_updates_to_db(TransactionRewind& rewind);
 
     RunnableScriptView
     get_script(const Address& address) const;
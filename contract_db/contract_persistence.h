@@ -4,18 +4,13 @@
 
 #include <utils/async_worker.h>
 
+#include <array>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <optional>
 
-#include "utils/save_load_xdr.h"
-
-#include "debug/debug_utils.h"
-
-#include <utils/mkdir.h>
-
-#include <utils/threadlocal_cache.h>
-
-#include <fcntl.h>
+#include "contract_db/contract_store.h"
 
 #include "config/static_constants.h"
 
@@ -23,6 +18,11 @@
 
 namespace scs {
 
+/**
+ * Writes each round's new contracts and deployments
+ * to a ContractStore (one group commit per round),
+ * off of the commit path.
+ */
 class AsyncPersistContracts : public utils::AsyncWorker
 {
     const std::string folder;
@@ -45,30 +45,17 @@ class AsyncPersistContracts : public utils::AsyncWorker
         std::vector<ContractDeploy> deployments;
     };
 
-    std::string get_contract_filename(Hash const& h)
-    {
-        return folder + "contracts/" + debug::array_to_str(h);
-    }
-
-    std::string get_deploy_filename(uint32_t round)
-    {
-        return folder + std::to_string(round);
-    }
-
-    void make_folder()
-    {
-        utils::mkdir_safe(folder);
-        utils::mkdir_safe(folder + "contracts/");
-    }
-
     std::array<ContractRoundPersistence, TLCACHE_SIZE> work_item;
     utils::ThreadlocalCache<ContractRoundPersistence, TLCACHE_SIZE> cache;
 
+    std::optional<ContractStoreWriter> store;
+
     bool work_done = true;
     uint32_t work_ts = 0;
 
     bool exists_work_to_do() override final { return !work_done; }
 
+    // caller holds mtx, and the worker is idle
     void swap_data()
     {
         auto& objs = cache.get_objects();
@@ -83,56 +70,30 @@ class AsyncPersistContracts : public utils::AsyncWorker
         }
     }
 
-    void save_contract(ContractRoundPersistence::ContractCreate const& create)
+    void clear_cache()
     {
-        auto filename = get_contract_filename(create.h);
-
-        FILE* f = std::fopen(filename.c_str(), "w");
-
-        if (f == nullptr) {
-            throw std::runtime_error("failed to open deployfile");
+        for (auto& obj : cache.get_objects()) {
+            if (obj) {
+                obj->creations.clear();
+                obj->deployments.clear();
+            }
         }
-
-        std::fwrite(create.unmetered_contract->data(),
-                    sizeof(uint8_t),
-                    create.unmetered_contract->size(),
-                    f);
-        std::fflush(f);
-        fsync(fileno(f));
-        std::fclose(f);
     }
 
     void save_data()
     {
-        auto filename = get_deploy_filename(work_ts);
-
-        FILE* f = std::fopen(filename.c_str(), "w");
-
-        if (f == nullptr) {
-            throw std::runtime_error("failed to open deployfile");
+        for (auto const& obj : work_item) {
+            for (auto const& create : obj.creations) {
+                store->add_contract(create.h, *create.unmetered_contract);
+            }
         }
-
         for (auto const& obj : work_item) {
             for (auto const& deploy : obj.deployments) {
-                std::fwrite(deploy.contract_addr.data(),
-                            sizeof(uint8_t),
-                            deploy.contract_addr.size(),
-                            f);
-                std::fwrite(deploy.contract_hash.data(),
-                            sizeof(uint8_t),
-                            deploy.contract_hash.size(),
-                            f);
-            }
-            for (auto const& create : obj.creations) {
-                save_contract(create);
+                store->add_deployment(deploy.contract_addr,
+                                      deploy.contract_hash);
             }
         }
-
-        std::fflush(f);
-
-        fsync(fileno(f));
-
-        std::fclose(f);
+        store->commit_round(work_ts);
     }
 
     void run()
@@ -148,9 +109,10 @@ class AsyncPersistContracts : public utils::AsyncWorker
                 return;
             }
 
+            lock.unlock();
             save_data();
+            lock.lock();
 
-            swap_data();
             work_done = true;
             cv.notify_all();
         }
@@ -163,7 +125,7 @@ class AsyncPersistContracts : public utils::AsyncWorker
         , work_item()
     {
         if constexpr (PERSISTENT_STORAGE_ENABLED) {
-            make_folder();
+            store.emplace(folder);
             start_async_thread([this] { run(); });
         }
     }
@@ -190,33 +152,51 @@ class AsyncPersistContracts : public utils::AsyncWorker
             cache.get().creations.emplace_back(hash, contract);
         }
     }
+
+    // Hands this round's logs to the worker
+    // (after the previous round is durable).
     void write(uint32_t timestamp)
     {
         if constexpr (PERSISTENT_STORAGE_ENABLED) {
-            std::lock_guard lock(mtx);
+            std::unique_lock lock(mtx);
+            cv.wait(lock, [this]() { return work_done; });
+            swap_data();
             work_done = false;
             work_ts = timestamp;
             cv.notify_all();
         }
     }
+
+    // Drops this round's logs.
     void nowrite()
     {
         if constexpr (PERSISTENT_STORAGE_ENABLED) {
-            std::lock_guard lock(mtx);
-            work_done = true;
-            swap_data();
-            cv.notify_all();
+            clear_cache();
         }
     }
 
     void clear_folder()
     {
         if constexpr (PERSISTENT_STORAGE_ENABLED) {
-            utils::clear_directory(folder);
-            make_folder();
+            wait_for_async_task();
+            store->clear();
         }
     }
 
+    // Drops every stored round after max_round.
+    void truncate_after(uint32_t max_round)
+    {
+        if constexpr (PERSISTENT_STORAGE_ENABLED) {
+            wait_for_async_task();
+            store->truncate_after(max_round);
+        }
+    }
+
+    std::string const& get_folder() const
+    {
+        return folder;
+    }
+
     using AsyncWorker::wait_for_async_task;
 };
 
@@ -0,0 +1,386 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "contract_db/contract_store.h"
+
+#include "utils/crc32c.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <utils/mkdir.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace scs
+{
+
+namespace
+{
+
+const std::string BLOB_FILENAME = "contracts";
+const std::string INDEX_FILENAME = "contract_index";
+const std::string DEPLOY_FILENAME = "deploys";
+
+template<typename entry_t>
+uint32_t
+entry_crc(entry_t const& entry)
+{
+    return crc32c::compute(reinterpret_cast<const uint8_t*>(&entry),
+                           offsetof(entry_t, entry_crc));
+}
+
+void
+sync_directory(std::string const& folder)
+{
+    int dfd = ::open(folder.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dfd < 0) {
+        throw std::runtime_error("failed to open contract store directory");
+    }
+    ::fsync(dfd);
+    ::close(dfd);
+}
+
+// nullptr (and bytes = 0) if the file is missing or empty
+const uint8_t*
+map_file(std::string const& filename, uint64_t& bytes)
+{
+    bytes = 0;
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("failed to stat contract store file");
+    }
+    if (st.st_size == 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    void* mapped = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping outlives the fd
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("failed to map contract store file");
+    }
+    bytes = st.st_size;
+    return static_cast<const uint8_t*>(mapped);
+}
+
+void
+unmap_file(const uint8_t* base, uint64_t bytes)
+{
+    if (base) {
+        ::munmap(const_cast<uint8_t*>(base), bytes);
+    }
+}
+
+int
+open_append(std::string const& filename)
+{
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open contract store file");
+    }
+    return fd;
+}
+
+} // namespace
+
+ContractStoreReader::ContractStoreReader(std::string const& folder,
+                                         uint32_t max_round)
+{
+    blob = map_file(folder + BLOB_FILENAME, blob_bytes);
+
+    uint64_t index_bytes, deploy_bytes;
+    const uint8_t* index = map_file(folder + INDEX_FILENAME, index_bytes);
+    const uint8_t* deploys = map_file(folder + DEPLOY_FILENAME, deploy_bytes);
+
+    const uint64_t num_index = index_bytes / sizeof(ContractIndexEntry);
+    for (uint64_t i = 0; i < num_index; i++) {
+        ContractIndexEntry entry;
+        std::memcpy(&entry, index + i * sizeof(entry), sizeof(entry));
+
+        if (entry.entry_crc != entry_crc(entry)
+            || entry.round > max_round
+            || entry.offset > blob_bytes
+            || entry.len > blob_bytes - entry.offset
+            || crc32c::compute(blob + entry.offset, entry.len)
+                   != entry.body_crc) {
+            break;
+        }
+
+        Hash h;
+        std::memcpy(h.data(), entry.hash, sizeof(entry.hash));
+        contracts.emplace(
+            h, Location{ .offset = entry.offset, .len = entry.len, .round = entry.round });
+
+        valid_index_entries = i + 1;
+        valid_blob_bytes = std::max(valid_blob_bytes, entry.offset + entry.len);
+    }
+
+    const uint64_t num_deploys = deploy_bytes / sizeof(ContractDeployEntry);
+    for (uint64_t i = 0; i < num_deploys; i++) {
+        ContractDeployEntry entry;
+        std::memcpy(&entry, deploys + i * sizeof(entry), sizeof(entry));
+
+        if (entry.entry_crc != entry_crc(entry)
+            || entry.round > max_round) {
+            break;
+        }
+
+        auto& d = deployments.emplace_back();
+        std::memcpy(d.address.data(), entry.address, sizeof(entry.address));
+        std::memcpy(d.hash.data(), entry.hash, sizeof(entry.hash));
+        d.round = entry.round;
+
+        // only possible if the contract's index entry was torn,
+        // which the write order rules out
+        if (contracts.find(d.hash) == contracts.end()) {
+            deployments.pop_back();
+            break;
+        }
+        valid_deploy_entries = i + 1;
+    }
+
+    unmap_file(index, index_bytes);
+    unmap_file(deploys, deploy_bytes);
+}
+
+ContractStoreReader::~ContractStoreReader()
+{
+    unmap_file(blob, blob_bytes);
+}
+
+std::optional<std::span<const uint8_t>>
+ContractStoreReader::get_contract(Hash const& h) const
+{
+    auto it = contracts.find(h);
+    if (it == contracts.end()) {
+        return std::nullopt;
+    }
+    return std::span<const uint8_t>(blob + it->second.offset, it->second.len);
+}
+
+void
+ContractStoreReader::for_each_contract(
+    uint32_t max_round,
+    std::function<void(Hash const&, std::span<const uint8_t>)> fn) const
+{
+    for (auto const& [h, loc] : contracts) {
+        if (loc.round <= max_round) {
+            fn(h, std::span<const uint8_t>(blob + loc.offset, loc.len));
+        }
+    }
+}
+
+void
+ContractStoreReader::for_each_deployment(
+    uint32_t max_round,
+    std::function<void(ContractStoreDeployment const&)> fn) const
+{
+    for (auto const& d : deployments) {
+        if (d.round <= max_round) {
+            fn(d);
+        }
+    }
+}
+
+ContractStoreWriter::ContractStoreWriter(std::string folder)
+    : folder(folder)
+{
+    utils::mkdir_safe(folder);
+    open_files();
+}
+
+ContractStoreWriter::~ContractStoreWriter()
+{
+    close_files();
+}
+
+void
+ContractStoreWriter::open_files(uint32_t max_round)
+{
+    {
+        ContractStoreReader reader(folder, max_round);
+        blob_offset = reader.valid_blob_bytes;
+        index_offset = reader.valid_index_entries * sizeof(ContractIndexEntry);
+        deploy_offset
+            = reader.valid_deploy_entries * sizeof(ContractDeployEntry);
+        for (auto const& [h, _] : reader.contracts) {
+            stored_hashes.insert(h);
+        }
+    }
+
+    blob_fd = open_append(folder + BLOB_FILENAME);
+    index_fd = open_append(folder + INDEX_FILENAME);
+    deploy_fd = open_append(folder + DEPLOY_FILENAME);
+
+    // drop torn tails (and rounds after max_round),
+    // and persist the (possibly new) directory entries.
+    // Deployments go first, so they never outlive their contracts.
+    if (::ftruncate(deploy_fd, deploy_offset) != 0
+        || ::fsync(deploy_fd) != 0
+        || ::ftruncate(index_fd, index_offset) != 0
+        || ::ftruncate(blob_fd, blob_offset) != 0) {
+        close_files();
+        throw std::runtime_error("failed to truncate contract store");
+    }
+    ::fsync(index_fd);
+    ::fsync(blob_fd);
+    sync_directory(folder);
+}
+
+void
+ContractStoreWriter::close_files()
+{
+    for (int* fd : { &blob_fd, &index_fd, &deploy_fd }) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+void
+ContractStoreWriter::add_contract(Hash const& h, Contract const& contract)
+{
+    if (!stored_hashes.insert(h).second) {
+        return;
+    }
+
+    ContractIndexEntry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    std::memcpy(entry.hash, h.data(), sizeof(entry.hash));
+    entry.offset = blob_offset + blob_buf.size();
+    entry.len = contract.size();
+    entry.body_crc = crc32c::compute(contract.data(), contract.size());
+    index_buf.push_back(entry);
+
+    blob_buf.insert(blob_buf.end(), contract.begin(), contract.end());
+}
+
+void
+ContractStoreWriter::add_deployment(Address const& addr, Hash const& h)
+{
+    ContractDeployEntry entry;
+    std::memset(&entry, 0, sizeof(entry));
+    std::memcpy(entry.address, addr.data(), sizeof(entry.address));
+    std::memcpy(entry.hash, h.data(), sizeof(entry.hash));
+    deploy_buf.push_back(entry);
+}
+
+void
+ContractStoreWriter::commit_round(uint32_t round)
+{
+    if (!index_buf.empty()) {
+        for (auto& entry : index_buf) {
+            entry.round = round;
+            entry.entry_crc = entry_crc(entry);
+        }
+
+        const uint64_t index_len = index_buf.size() * sizeof(ContractIndexEntry);
+
+        std::vector<IORequest> reqs;
+        if (blob_buf.size() > 0) {
+            reqs.push_back(IORequest{ .fd = blob_fd,
+                                      .buf = blob_buf.data(),
+                                      .len = blob_buf.size(),
+                                      .offset = blob_offset });
+        }
+        reqs.push_back(
+            IORequest{ .fd = index_fd,
+                       .buf = reinterpret_cast<uint8_t*>(index_buf.data()),
+                       .len = index_len,
+                       .offset = index_offset });
+        io.write_all(reqs);
+
+        std::atomic<bool> ok = true;
+        const int fds[2] = { blob_fd, index_fd };
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, 2, 1), [&](auto r) {
+            for (size_t i = r.begin(); i < r.end(); i++) {
+                if (::fdatasync(fds[i]) != 0) {
+                    ok = false;
+                }
+            }
+        });
+        if (!ok) {
+            throw std::runtime_error("contract store fdatasync failed");
+        }
+
+        blob_offset += blob_buf.size();
+        index_offset += index_len;
+        blob_buf.clear();
+        index_buf.clear();
+    }
+
+    if (!deploy_buf.empty()) {
+        for (auto& entry : deploy_buf) {
+            entry.round = round;
+            entry.entry_crc = entry_crc(entry);
+        }
+
+        const uint64_t deploy_len
+            = deploy_buf.size() * sizeof(ContractDeployEntry);
+
+        io.write_all(
+            { IORequest{ .fd = deploy_fd,
+                         .buf = reinterpret_cast<uint8_t*>(deploy_buf.data()),
+                         .len = deploy_len,
+                         .offset = deploy_offset } });
+        if (::fdatasync(deploy_fd) != 0) {
+            throw std::runtime_error("contract store fdatasync failed");
+        }
+
+        deploy_offset += deploy_len;
+        deploy_buf.clear();
+    }
+}
+
+void
+ContractStoreWriter::clear()
+{
+    close_files();
+    utils::clear_directory(folder);
+    stored_hashes.clear();
+    blob_buf.clear();
+    index_buf.clear();
+    deploy_buf.clear();
+    open_files();
+}
+
+void
+ContractStoreWriter::truncate_after(uint32_t max_round)
+{
+    if (!index_buf.empty() || !deploy_buf.empty()) {
+        throw std::runtime_error("contract store truncated mid-round");
+    }
+    close_files();
+    stored_hashes.clear();
+    open_files(max_round);
+}
+
+} // namespace scs
@@ -0,0 +1,198 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "xdr/types.h"
+
+#include "persistence/async_io.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <set>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace scs
+{
+
+/**
+ * Durable storage for the contract db.
+ *
+ * Three append-only files in one folder:
+ *  - contracts: every contract's (unmetered) bytes, concatenated
+ *  - index: one ContractIndexEntry per contract, locating it in contracts
+ *  - deploys: one ContractDeployEntry per deployment
+ *
+ * A round (one contract db commit) is written with one write and one
+ * fdatasync per file.  The contracts and the index are synced before
+ * any of the round's deployments are written, so a durable deployment
+ * never refers to a contract that is not durable.
+ *
+ * Entries are checksummed.  A crash can only leave a torn tail,
+ * so the valid part of each file is everything before
+ * its first invalid entry.
+ *
+ * Rounds are appended in increasing order.  A store can also hold
+ * rounds that the rest of the node never made durable (it persists
+ * contracts before the key log); a restart drops them with
+ * ContractStoreWriter::truncate_after() before appending.
+ */
+struct ContractIndexEntry
+{
+    uint8_t hash[32];
+    uint64_t offset;
+    uint32_t len;
+    uint32_t body_crc;
+    uint32_t round;
+    // over the bytes before this field
+    uint32_t entry_crc;
+};
+static_assert(sizeof(ContractIndexEntry) == 56, "unexpected padding");
+
+struct ContractDeployEntry
+{
+    uint8_t address[32];
+    uint8_t hash[32];
+    uint32_t round;
+    uint32_t entry_crc;
+};
+static_assert(sizeof(ContractDeployEntry) == 72, "unexpected padding");
+
+struct ContractStoreDeployment
+{
+    Address address;
+    Hash hash;
+    uint32_t round;
+};
+
+/**
+ * Read-only view of a contract store.
+ * Maps the contract file, so contracts are read
+ * in place instead of copied.
+ */
+class ContractStoreReader
+{
+    struct Location
+    {
+        uint64_t offset;
+        uint32_t len;
+        uint32_t round;
+    };
+
+    const uint8_t* blob = nullptr;
+    uint64_t blob_bytes = 0;
+
+    std::map<Hash, Location> contracts;
+    std::vector<ContractStoreDeployment> deployments;
+
+    // lengths of the valid prefixes of each file
+    uint64_t valid_blob_bytes = 0;
+    uint64_t valid_index_entries = 0;
+    uint64_t valid_deploy_entries = 0;
+
+    friend class ContractStoreWriter;
+
+  public:
+    // A missing folder (or missing files) reads as an empty store.
+    // Reads only up to the first entry of a round after max_round.
+    ContractStoreReader(std::string const& folder,
+                        uint32_t max_round = UINT32_MAX);
+    ~ContractStoreReader();
+
+    ContractStoreReader(const ContractStoreReader&) = delete;
+    ContractStoreReader& operator=(const ContractStoreReader&) = delete;
+
+    size_t num_contracts() const { return contracts.size(); }
+    size_t num_deployments() const { return deployments.size(); }
+
+    bool empty() const { return contracts.empty() && deployments.empty(); }
+
+    // Valid until the reader is destroyed.
+    std::optional<std::span<const uint8_t>> get_contract(Hash const& h) const;
+
+    // Contracts stored in rounds at or before max_round
+    void for_each_contract(
+        uint32_t max_round,
+        std::function<void(Hash const&, std::span<const uint8_t>)> fn) const;
+
+    // In log order, so a later deployment to an address overrides
+    // an earlier one.
+    void for_each_deployment(
+        uint32_t max_round,
+        std::function<void(ContractStoreDeployment const&)> fn) const;
+};
+
+/**
+ * Appends rounds to a contract store.
+ *
+ * Reopening an existing store truncates any torn tail,
+ * and continues after the valid entries.
+ * Contracts already in the store are not written again.
+ *
+ * Not threadsafe.
+ */
+class ContractStoreWriter
+{
+    const std::string folder;
+
+    int blob_fd = -1;
+    int index_fd = -1;
+    int deploy_fd = -1;
+
+    uint64_t blob_offset = 0;
+    uint64_t index_offset = 0;
+    uint64_t deploy_offset = 0;
+
+    std::set<Hash> stored_hashes;
+
+    // the round being built
+    std::vector<uint8_t> blob_buf;
+    std::vector<ContractIndexEntry> index_buf;
+    std::vector<ContractDeployEntry> deploy_buf;
+
+    AsyncIO io;
+
+    void open_files(uint32_t max_round = UINT32_MAX);
+    void close_files();
+
+  public:
+    ContractStoreWriter(std::string folder);
+    ~ContractStoreWriter();
+
+    ContractStoreWriter(const ContractStoreWriter&) = delete;
+    ContractStoreWriter& operator=(const ContractStoreWriter&) = delete;
+
+    void add_contract(Hash const& h, Contract const& contract);
+    void add_deployment(Address const& addr, Hash const& h);
+
+    // Writes out everything added since the last commit_round(),
+    // durably.  Does nothing if nothing was added.
+    void commit_round(uint32_t round);
+
+    // Removes everything, and starts a new empty store.
+    void clear();
+
+    // Removes every entry from the first one of a round after
+    // max_round onwards, durably, so that later rounds continue
+    // from max_round.  Must not be called with a round in progress.
+    void truncate_after(uint32_t max_round);
+};
+
+} // namespace scs
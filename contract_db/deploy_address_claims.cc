@@ -0,0 +1,185 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "contract_db/deploy_address_claims.h"
+
+#include "utils/seeded_hash.h"
+
+#include <utils/compat.h>
+
+#include <sodium.h>
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace scs {
+
+DeployAddressClaims::DeployAddressClaims()
+    : table()
+    , table_size(0)
+    , used_slots()
+    , num_slots_used(0)
+    , expected_claims(0)
+    , overflow_mtx()
+    , overflow()
+{
+    reset_table(MIN_TABLE_SIZE);
+    randombytes_buf(&seed, sizeof(seed));
+}
+
+uint64_t
+DeployAddressClaims::hash(Address const& addr) const
+{
+    return seeded_hash(addr, seed);
+}
+
+uint32_t
+DeployAddressClaims::table_size_for(uint64_t num_claims)
+{
+    // 1/4 load
+    num_claims = std::min<uint64_t>(num_claims, MAX_TABLE_SIZE);
+    return std::clamp<uint64_t>(std::bit_ceil(4 * num_claims),
+                                MIN_TABLE_SIZE,
+                                MAX_TABLE_SIZE);
+}
+
+void
+DeployAddressClaims::reset_table(uint32_t new_size)
+{
+    if (new_size != table_size) {
+        // value-initialized, so every slot is EMPTY
+        table.reset(new Slot[new_size]());
+        used_slots.reset(new uint32_t[new_size]);
+        table_size = new_size;
+    } else {
+        const uint32_t used = num_slots_used.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < used; i++) {
+            table[used_slots[i]].state.store(EMPTY, std::memory_order_relaxed);
+        }
+    }
+    num_slots_used.store(0, std::memory_order_relaxed);
+}
+
+bool
+DeployAddressClaims::try_claim(Address const& addr)
+{
+    const uint32_t mask = table_size - 1;
+    uint32_t pos = hash(addr) & mask;
+
+    for (uint32_t i = 0; i < MAX_PROBES; i++, pos = (pos + 1) & mask) {
+        auto& slot = table[pos];
+        uint32_t state = slot.state.load(std::memory_order_acquire);
+
+        if (state == EMPTY) {
+            if (slot.state.compare_exchange_strong(
+                    state, BUSY, std::memory_order_acquire)) {
+                slot.addr = addr;
+                slot.state.store(CLAIMED, std::memory_order_release);
+                used_slots[num_slots_used.fetch_add(1, std::memory_order_relaxed)] = pos;
+                return true;
+            }
+            // state holds whatever beat us to the slot
+        }
+
+        while (state == BUSY) {
+            SPINLOCK_PAUSE();
+            state = slot.state.load(std::memory_order_acquire);
+        }
+
+        if (slot.addr != addr) {
+            continue;
+        }
+
+        while (state == RELEASED) {
+            if (slot.state.compare_exchange_weak(
+                    state, CLAIMED, std::memory_order_acquire)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::lock_guard lock(overflow_mtx);
+    auto [it, inserted] = overflow.emplace(addr, true);
+    if (inserted) {
+        return true;
+    }
+    if (it->second) {
+        return false;
+    }
+    it->second = true;
+    return true;
+}
+
+void
+DeployAddressClaims::release(Address const& addr)
+{
+    const uint32_t mask = table_size - 1;
+    uint32_t pos = hash(addr) & mask;
+
+    for (uint32_t i = 0; i < MAX_PROBES; i++, pos = (pos + 1) & mask) {
+        auto& slot = table[pos];
+        uint32_t state = slot.state.load(std::memory_order_acquire);
+
+        while (state == BUSY) {
+            SPINLOCK_PAUSE();
+            state = slot.state.load(std::memory_order_acquire);
+        }
+
+        if (state == EMPTY) {
+            break;
+        }
+        if (slot.addr == addr) {
+            slot.state.store(RELEASED, std::memory_order_release);
+            return;
+        }
+    }
+
+    std::lock_guard lock(overflow_mtx);
+    auto it = overflow.find(addr);
+    if (it == overflow.end() || !it->second) {
+        throw std::runtime_error("release of unclaimed deploy address");
+    }
+    it->second = false;
+}
+
+void
+DeployAddressClaims::reserve(uint64_t max_claims)
+{
+    if (num_slots_used.load(std::memory_order_relaxed) != 0 || !overflow.empty()) {
+        throw std::runtime_error("deploy claims reserved mid-block");
+    }
+    reset_table(table_size_for(std::min(max_claims, expected_claims)));
+}
+
+void
+DeployAddressClaims::clear()
+{
+    const uint64_t used = num_slots_used.load(std::memory_order_relaxed)
+                          + overflow.size();
+
+    // decays, so that one burst of deployments doesn't
+    // size the table for every block after it
+    expected_claims = std::max(used, expected_claims / 2);
+
+    // reallocates only if the size changes
+    reset_table(table_size_for(expected_claims));
+    overflow.clear();
+    randombytes_buf(&seed, sizeof(seed));
+}
+
+} // namespace scs
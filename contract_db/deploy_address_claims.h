@@ -0,0 +1,110 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "xdr/types.h"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace scs {
+
+/**
+ * Addresses that transactions in the current block deploy to,
+ * so that two transactions cannot both deploy to one address.
+ *
+ * Open-addressed (linear probing) table, sized between blocks
+ * to (roughly) 4x the number of addresses recent blocks claimed
+ * (capped by the next block's reserve() hint).  clear() only
+ * empties the slots the block used, so a block that deploys
+ * nothing costs nothing to clear.
+ * A claim takes an empty slot by CAS and then publishes the address,
+ * or retakes a slot released (by a failed transaction) for the same address.
+ * Released slots keep their address, so probes never stop early.
+ *
+ * If every slot in an address's probe window is taken by other addresses,
+ * the address goes to a mutex-protected overflow map instead.
+ *
+ * Addresses are hashed with seeded_hash(), reseeded per block.
+ *
+ * try_claim() and release() are threadsafe; reserve() and clear() are not.
+ */
+class DeployAddressClaims
+{
+    enum SlotState : uint32_t
+    {
+        EMPTY = 0,
+        // address being written
+        BUSY = 1,
+        CLAIMED = 2,
+        RELEASED = 3
+    };
+
+    struct Slot
+    {
+        std::atomic<uint32_t> state;
+        Address addr;
+    };
+
+    constexpr static uint32_t MIN_TABLE_SIZE = 1 << 12;
+    constexpr static uint32_t MAX_TABLE_SIZE = 1 << 24;
+    constexpr static uint32_t MAX_PROBES = 64;
+
+    std::unique_ptr<Slot[]> table;
+    uint32_t table_size;
+
+    // indices of the slots used this block, [0, num_slots_used)
+    // (a slot leaves EMPTY at most once per block)
+    std::unique_ptr<uint32_t[]> used_slots;
+    std::atomic<uint32_t> num_slots_used;
+
+    // claims per block: the previous block's, or half the
+    // previous estimate, whichever is more
+    uint64_t expected_claims;
+
+    std::mutex overflow_mtx;
+    // address -> currently claimed
+    std::map<Address, bool> overflow;
+
+    uint64_t seed;
+
+    uint64_t hash(Address const& addr) const;
+
+    void reset_table(uint32_t new_size);
+
+    static uint32_t table_size_for(uint64_t num_claims);
+
+  public:
+    DeployAddressClaims();
+
+    // sizes the table for the expected number of claims, but for
+    // no more than max_claims, before the block's first claim
+    void reserve(uint64_t max_claims);
+
+    // false if some other transaction holds the claim
+    bool try_claim(Address const& addr);
+
+    // caller must hold the claim
+    void release(Address const& addr);
+
+    void clear();
+};
+
+} // namespace scs
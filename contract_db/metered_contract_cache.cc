@@ -0,0 +1,66 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "contract_db/metered_contract_cache.h"
+
+#include <mutex>
+
+namespace scs {
+
+MeteredContractCache::entry_t
+MeteredContractCache::get_or_meter(Hash const& h, Contract const& contract)
+{
+    {
+        auto& shard = get_shard(h);
+        std::shared_lock lock(shard.mtx);
+        auto it = shard.entries.find(h);
+        if (it != shard.entries.end()) {
+            return it->second;
+        }
+    }
+    return get_or_meter(h, std::make_shared<const Contract>(contract));
+}
+
+MeteredContractCache::entry_t
+MeteredContractCache::get_or_meter(Hash const& h,
+                                   std::shared_ptr<const Contract> contract)
+{
+    auto& shard = get_shard(h);
+    {
+        std::shared_lock lock(shard.mtx);
+        auto it = shard.entries.find(h);
+        if (it != shard.entries.end()) {
+            return it->second;
+        }
+    }
+
+    // metering is slow, so not under the lock
+    entry_t entry{ .metered = std::make_shared<const MeteredContract>(contract),
+                   .unmetered = contract };
+
+    std::lock_guard lock(shard.mtx);
+    return shard.entries.emplace(h, std::move(entry)).first->second;
+}
+
+void
+MeteredContractCache::clear()
+{
+    for (auto& shard : shards) {
+        shard.entries.clear();
+    }
+}
+
+} // namespace scs
@@ -0,0 +1,76 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "metering_ffi/metered_contract.h"
+
+#include "xdr/types.h"
+
+#include <array>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+
+#include <utils/non_movable.h>
+
+namespace scs {
+
+/**
+ * Contracts created (but not yet committed) in the current block,
+ * by content hash, so that a contract is metered once per block
+ * no matter how many transactions create it.
+ *
+ * Threadsafe, except for clear().
+ */
+class MeteredContractCache : public utils::NonMovableOrCopyable
+{
+  public:
+    struct entry_t
+    {
+        metered_contract_ptr_t metered;
+        std::shared_ptr<const Contract> unmetered;
+    };
+
+  private:
+    constexpr static size_t NUM_SHARDS = 16;
+
+    struct Shard
+    {
+        std::shared_mutex mtx;
+        std::map<Hash, entry_t> entries;
+    };
+
+    std::array<Shard, NUM_SHARDS> shards;
+
+    Shard& get_shard(Hash const& h) { return shards[h[0] % NUM_SHARDS]; }
+
+  public:
+    /**
+     * h must be hash_xdr(contract).
+     * Copies and meters the contract on a miss.
+     * Two threads that miss at once both meter,
+     * but all callers get the same entry.
+     */
+    entry_t get_or_meter(Hash const& h, Contract const& contract);
+
+    entry_t get_or_meter(Hash const& h,
+                         std::shared_ptr<const Contract> contract);
+
+    void clear();
+};
+
+} // namespace scs
@@ -0,0 +1,106 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "contract_db/contract_address_index.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+namespace scs {
+
+namespace test {
+
+Address
+address_index_addr(uint64_t i)
+{
+    Address out;
+    out.fill(0);
+    std::memcpy(out.data(), &i, sizeof(i));
+    return out;
+}
+
+// never dereferenced
+RunnableScriptView
+address_index_script(uint64_t i)
+{
+    return RunnableScriptView{ .data = reinterpret_cast<const uint8_t*>(
+                                   static_cast<uintptr_t>(i + 1)),
+                               .len = static_cast<uint32_t>(i) };
+}
+
+} // namespace test
+
+using namespace test;
+
+TEST_CASE("contract address index", "[contract_db]")
+{
+    ContractAddressIndex index;
+
+    // well past several resizes
+    const uint64_t n = 100'000;
+    for (uint64_t i = 0; i < n; i++) {
+        index.insert(address_index_addr(i), address_index_script(i));
+    }
+    REQUIRE(index.size() == n);
+
+    SECTION("find")
+    {
+        for (uint64_t i = 0; i < n; i++) {
+            auto res = index.find(address_index_addr(i));
+            REQUIRE(res);
+            REQUIRE(res->data == address_index_script(i).data);
+            REQUIRE(res->len == i);
+        }
+        REQUIRE(!index.find(address_index_addr(n)));
+    }
+
+    SECTION("double insert")
+    {
+        REQUIRE_THROWS(index.insert(address_index_addr(5), address_index_script(6)));
+        REQUIRE(index.find(address_index_addr(5))->len == 5);
+        REQUIRE(index.size() == n);
+    }
+
+    SECTION("null script is still present")
+    {
+        index.insert(address_index_addr(n), null_script);
+        auto res = index.find(address_index_addr(n));
+        REQUIRE(res);
+        REQUIRE(res->data == nullptr);
+    }
+
+    SECTION("concurrent finds")
+    {
+        std::atomic<uint64_t> errors = 0;
+        tbb::parallel_for(tbb::blocked_range<uint64_t>(0, 2 * n), [&](auto r) {
+            for (uint64_t i = r.begin(); i < r.end(); i++) {
+                auto res = index.find(address_index_addr(i));
+                if ((i < n) != res.has_value()) {
+                    errors++;
+                }
+            }
+        });
+        REQUIRE(errors == 0);
+    }
+}
+
+} // namespace scs
@@ -0,0 +1,266 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "contract_db/contract_store.h"
+
+#include <utils/mkdir.h>
+
+#include <filesystem>
+#include <map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace scs {
+
+namespace test {
+
+Hash
+contract_store_hash(uint8_t seed)
+{
+    Hash out;
+    out.fill(seed);
+    return out;
+}
+
+Address
+contract_store_addr(uint8_t seed)
+{
+    Address out;
+    out.fill(0);
+    out[0] = seed;
+    return out;
+}
+
+Contract
+contract_store_contract(uint8_t seed, size_t len)
+{
+    Contract out;
+    out.resize(len, seed);
+    return out;
+}
+
+bool
+contract_store_matches(ContractStoreReader const& reader,
+                       Hash const& h,
+                       Contract const& expect)
+{
+    auto res = reader.get_contract(h);
+    if (!res) {
+        return false;
+    }
+    return std::equal(res->begin(), res->end(), expect.begin(), expect.end());
+}
+
+std::map<Address, Hash>
+contract_store_deploys(ContractStoreReader const& reader, uint32_t max_round)
+{
+    std::map<Address, Hash> out;
+    reader.for_each_deployment(max_round, [&](ContractStoreDeployment const& d) {
+        out[d.address] = d.hash;
+    });
+    return out;
+}
+
+void
+contract_store_chop(std::string const& filename, uint64_t bytes)
+{
+    auto size = std::filesystem::file_size(filename);
+    std::filesystem::resize_file(filename, size - bytes);
+}
+
+} // namespace test
+
+using namespace test;
+
+TEST_CASE("contract store roundtrip", "[contract_db]")
+{
+    const std::string folder = "test_contract_store/";
+    utils::mkdir_safe(folder);
+    utils::clear_directory(folder);
+
+    {
+        ContractStoreWriter writer(folder);
+        writer.add_contract(contract_store_hash(1), contract_store_contract(1, 100));
+        writer.add_contract(contract_store_hash(2), contract_store_contract(2, 0));
+        writer.add_deployment(contract_store_addr(1), contract_store_hash(1));
+        writer.commit_round(0);
+
+        // nothing to write
+        writer.commit_round(1);
+
+        writer.add_contract(contract_store_hash(3), contract_store_contract(3, 5000));
+        // already stored
+        writer.add_contract(contract_store_hash(1), contract_store_contract(1, 100));
+        writer.add_deployment(contract_store_addr(2), contract_store_hash(3));
+        writer.add_deployment(contract_store_addr(3), contract_store_hash(2));
+        writer.commit_round(2);
+    }
+
+    SECTION("read back")
+    {
+        ContractStoreReader reader(folder);
+        REQUIRE(reader.num_contracts() == 3);
+        REQUIRE(reader.num_deployments() == 3);
+
+        REQUIRE(contract_store_matches(reader, contract_store_hash(1), contract_store_contract(1, 100)));
+        REQUIRE(contract_store_matches(reader, contract_store_hash(2), contract_store_contract(2, 0)));
+        REQUIRE(contract_store_matches(reader, contract_store_hash(3), contract_store_contract(3, 5000)));
+        REQUIRE(!reader.get_contract(contract_store_hash(4)));
+
+        auto deploys = contract_store_deploys(reader, UINT32_MAX);
+        REQUIRE(deploys.size() == 3);
+        REQUIRE(deploys[contract_store_addr(2)] == contract_store_hash(3));
+    }
+
+    SECTION("filter by round")
+    {
+        ContractStoreReader reader(folder);
+        size_t count = 0;
+        reader.for_each_contract(1, [&](Hash const&, std::span<const uint8_t>) {
+            count++;
+        });
+        REQUIRE(count == 2);
+        REQUIRE(contract_store_deploys(reader, 1).size() == 1);
+    }
+
+    SECTION("reopen appends")
+    {
+        {
+            ContractStoreWriter writer(folder);
+            writer.add_contract(contract_store_hash(1), contract_store_contract(1, 100));
+            writer.add_contract(contract_store_hash(4), contract_store_contract(4, 10));
+            writer.add_deployment(contract_store_addr(1), contract_store_hash(4));
+            writer.commit_round(3);
+        }
+        ContractStoreReader reader(folder);
+        REQUIRE(reader.num_contracts() == 4);
+        REQUIRE(contract_store_matches(reader, contract_store_hash(4), contract_store_contract(4, 10)));
+        REQUIRE(std::filesystem::file_size(folder + "contracts") == 100 + 5000 + 10);
+
+        // later deployment wins
+        REQUIRE(contract_store_deploys(reader, UINT32_MAX)[contract_store_addr(1)] == contract_store_hash(4));
+    }
+
+    SECTION("torn deploy log")
+    {
+        contract_store_chop(folder + "deploys", 10);
+        {
+            ContractStoreReader reader(folder);
+            REQUIRE(reader.num_deployments() == 2);
+        }
+        {
+            ContractStoreWriter writer(folder);
+            writer.add_deployment(contract_store_addr(5), contract_store_hash(2));
+            writer.commit_round(3);
+        }
+        ContractStoreReader reader(folder);
+        REQUIRE(reader.num_deployments() == 3);
+        REQUIRE(contract_store_deploys(reader, UINT32_MAX).count(contract_store_addr(5)) == 1);
+    }
+
+    SECTION("torn contract")
+    {
+        contract_store_chop(folder + "contracts", 1);
+        {
+            ContractStoreReader reader(folder);
+            REQUIRE(reader.num_contracts() == 2);
+            REQUIRE(!reader.get_contract(contract_store_hash(3)));
+            // round 2's deployments start with the lost contract
+            REQUIRE(reader.num_deployments() == 1);
+        }
+        {
+            // rewritten after the truncation
+            ContractStoreWriter writer(folder);
+            writer.add_contract(contract_store_hash(3), contract_store_contract(3, 5000));
+            writer.commit_round(2);
+        }
+        ContractStoreReader reader(folder);
+        REQUIRE(contract_store_matches(reader, contract_store_hash(3), contract_store_contract(3, 5000)));
+    }
+
+    SECTION("corrupt index entry")
+    {
+        int fd = ::open((folder + "contract_index").c_str(), O_WRONLY);
+        REQUIRE(fd >= 0);
+        uint8_t byte = 0xFF;
+        // in the second entry's hash
+        REQUIRE(::pwrite(fd, &byte, 1, sizeof(ContractIndexEntry) + 3) == 1);
+        ::close(fd);
+
+        ContractStoreReader reader(folder);
+        REQUIRE(reader.num_contracts() == 1);
+        REQUIRE(reader.get_contract(contract_store_hash(1)));
+    }
+
+    SECTION("truncate after round")
+    {
+        {
+            ContractStoreWriter writer(folder);
+            // round 2 was durable here, but the chain restarts from round 1
+            writer.truncate_after(1);
+
+            writer.add_contract(contract_store_hash(4), contract_store_contract(4, 10));
+            writer.add_deployment(contract_store_addr(2), contract_store_hash(4));
+            writer.commit_round(2);
+        }
+        ContractStoreReader reader(folder);
+        REQUIRE(reader.num_contracts() == 3);
+        REQUIRE(!reader.get_contract(contract_store_hash(3)));
+        REQUIRE(contract_store_matches(reader, contract_store_hash(4), contract_store_contract(4, 10)));
+        REQUIRE(std::filesystem::file_size(folder + "contracts") == 100 + 10);
+
+        auto deploys = contract_store_deploys(reader, UINT32_MAX);
+        REQUIRE(reader.num_deployments() == 2);
+        REQUIRE(deploys[contract_store_addr(1)] == contract_store_hash(1));
+        REQUIRE(deploys[contract_store_addr(2)] == contract_store_hash(4));
+        REQUIRE(deploys.count(contract_store_addr(3)) == 0);
+    }
+
+    SECTION("truncate keeps contracts for rewritten rounds")
+    {
+        {
+            ContractStoreWriter writer(folder);
+            writer.truncate_after(0);
+            // dropped with round 2, so written again
+            writer.add_contract(contract_store_hash(3), contract_store_contract(3, 5000));
+            writer.commit_round(1);
+        }
+        ContractStoreReader reader(folder);
+        REQUIRE(reader.num_contracts() == 3);
+        REQUIRE(reader.num_deployments() == 1);
+        REQUIRE(contract_store_matches(reader, contract_store_hash(3), contract_store_contract(3, 5000)));
+    }
+
+    SECTION("clear")
+    {
+        ContractStoreWriter writer(folder);
+        writer.clear();
+        ContractStoreReader reader(folder);
+        REQUIRE(reader.empty());
+    }
+}
+
+TEST_CASE("contract store missing folder", "[contract_db]")
+{
+    std::filesystem::remove_all("test_contract_store_missing/");
+    ContractStoreReader reader("test_contract_store_missing/");
+    REQUIRE(reader.empty());
+}
+
+} // namespace scs
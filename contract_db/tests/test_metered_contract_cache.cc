@@ -0,0 +1,126 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "contract_db/contract_db.h"
+#include "contract_db/contract_db_proxy.h"
+#include "contract_db/metered_contract_cache.h"
+
+#include "crypto/hash.h"
+
+#include "storage_proxy/transaction_rewind.h"
+
+#include "test_utils/deploy_and_commit_contractdb.h"
+
+#include "utils/load_wasm.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <atomic>
+
+namespace scs {
+
+TEST_CASE("metered contract cache", "[contract_db]")
+{
+    MeteredContractCache cache;
+
+    auto c = load_wasm_from_file("cpp_contracts/test_log.wasm");
+    auto h = hash_xdr(*c);
+
+    auto first = cache.get_or_meter(h, *c);
+    REQUIRE(first.metered);
+    REQUIRE(*first.metered);
+    // copied, not aliased
+    REQUIRE(first.unmetered.get() != c.get());
+    REQUIRE(*first.unmetered == *c);
+
+    SECTION("hit")
+    {
+        auto second = cache.get_or_meter(h, c);
+        REQUIRE(second.metered.get() == first.metered.get());
+        REQUIRE(second.unmetered.get() == first.unmetered.get());
+    }
+
+    SECTION("parallel hits")
+    {
+        std::atomic<size_t> mismatches = 0;
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, 1000), [&](auto r) {
+            for (size_t i = r.begin(); i < r.end(); i++) {
+                if (cache.get_or_meter(h, *c).metered.get()
+                    != first.metered.get()) {
+                    mismatches++;
+                }
+            }
+        });
+        REQUIRE(mismatches == 0);
+    }
+
+    SECTION("clear")
+    {
+        cache.clear();
+        auto second = cache.get_or_meter(h, c);
+        REQUIRE(second.metered.get() != first.metered.get());
+        REQUIRE(second.unmetered.get() == c.get());
+    }
+}
+
+TEST_CASE("create committed contract again", "[contract_db]")
+{
+    ContractDB db;
+
+    auto c = load_wasm_from_file("cpp_contracts/test_log.wasm");
+    auto h = hash_xdr(*c);
+
+    Address addr;
+    addr.fill(1);
+    test::deploy_and_commit_contractdb(db, addr, c);
+
+    {
+        ContractDBProxy proxy(db);
+        REQUIRE(proxy.create_contract(*c) == h);
+
+        TransactionRewind rewind;
+        REQUIRE(proxy.push_updates_to_db(rewind));
+        rewind.commit();
+    }
+
+    REQUIRE_NOTHROW(db.commit(1));
+    REQUIRE(db.check_committed_contract_exists(h));
+}
+
+TEST_CASE("premeter deployable contracts", "[contract_db]")
+{
+    ContractDB db;
+
+    xdr::xvector<Contract> contracts;
+    contracts.push_back(*load_wasm_from_file("cpp_contracts/test_log.wasm"));
+    contracts.push_back(*load_wasm_from_file("cpp_contracts/test_redirect_call.wasm"));
+
+    db.premeter_contracts(contracts);
+
+    // both txs get the premetered copy
+    ContractDBProxy proxy1(db), proxy2(db);
+    auto h1 = proxy1.create_contract(contracts[0]);
+    auto h2 = proxy2.create_contract(contracts[0]);
+    REQUIRE(h1 == h2);
+    REQUIRE(h1 == hash_xdr(contracts[0]));
+
+    db.rewind();
+}
+
+} // namespace scs
@@ -0,0 +1,208 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "contract_db/contract_db.h"
+#include "contract_db/contract_db_proxy.h"
+#include "contract_db/contract_utils.h"
+
+#include "crypto/hash.h"
+
+#include "storage_proxy/transaction_rewind.h"
+
+#include "test_utils/deploy_and_commit_contractdb.h"
+
+#include "utils/load_wasm.h"
+
+#include <utils/time.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <atomic>
+#include <cstdio>
+
+namespace scs {
+
+namespace test {
+
+Address
+uncommitted_contracts_sender()
+{
+    Address out;
+    out.fill(0xAA);
+    return out;
+}
+
+/**
+ * One "transaction" per wallet: deploy the wallet at nonce
+ * first_nonce + i, and commit.  Returns the number of failures.
+ */
+uint64_t
+deploy_wallets(ContractDB& db,
+               Hash const& wallet_hash,
+               uint64_t num_wallets,
+               uint64_t first_nonce = 0)
+{
+    std::atomic<uint64_t> failures = 0;
+    tbb::parallel_for(tbb::blocked_range<uint64_t>(0, num_wallets), [&](auto r) {
+        for (uint64_t i = r.begin(); i < r.end(); i++) {
+            ContractDBProxy proxy(db);
+            if (!proxy.deploy_contract(
+                    uncommitted_contracts_sender(), wallet_hash, first_nonce + i)) {
+                failures++;
+                continue;
+            }
+            TransactionRewind rewind;
+            if (!proxy.push_updates_to_db(rewind)) {
+                failures++;
+                continue;
+            }
+            rewind.commit();
+        }
+    });
+    return failures;
+}
+
+} // namespace test
+
+using namespace test;
+
+TEST_CASE("conflicting deployments", "[contract_db]")
+{
+    ContractDB db;
+
+    auto c = load_wasm_from_file("cpp_contracts/test_log.wasm");
+    auto h = hash_xdr(*c);
+
+    Address genesis_addr;
+    genesis_addr.fill(1);
+    test::deploy_and_commit_contractdb(db, genesis_addr, c);
+
+    auto sender = uncommitted_contracts_sender();
+    auto addr = compute_contract_deploy_address(sender, h, 0);
+
+    ContractDBProxy proxy1(db), proxy2(db);
+    REQUIRE(proxy1.deploy_contract(sender, h, 0) == addr);
+    REQUIRE(proxy2.deploy_contract(sender, h, 0) == addr);
+
+    SECTION("first claim wins")
+    {
+        TransactionRewind rewind1;
+        REQUIRE(proxy1.push_updates_to_db(rewind1));
+
+        TransactionRewind rewind2;
+        REQUIRE(!proxy2.push_updates_to_db(rewind2));
+
+        rewind1.commit();
+        db.commit(1);
+
+        ContractDBProxy proxy3(db);
+        REQUIRE(proxy3.get_script(addr).data != nullptr);
+        // already deployed
+        REQUIRE(!proxy3.deploy_contract(sender, h, 0));
+    }
+
+    SECTION("failed tx releases its claim")
+    {
+        {
+            TransactionRewind rewind1;
+            REQUIRE(proxy1.push_updates_to_db(rewind1));
+            // not committed
+        }
+
+        TransactionRewind rewind2;
+        REQUIRE(proxy2.push_updates_to_db(rewind2));
+        rewind2.commit();
+
+        REQUIRE_NOTHROW(db.commit(1));
+        REQUIRE(!db.check_address_open_for_deployment(addr));
+    }
+
+    SECTION("rewind releases every claim")
+    {
+        TransactionRewind rewind1;
+        REQUIRE(proxy1.push_updates_to_db(rewind1));
+        rewind1.commit();
+
+        db.rewind();
+
+        TransactionRewind rewind2;
+        REQUIRE(proxy2.push_updates_to_db(rewind2));
+        rewind2.commit();
+        db.commit(1);
+        REQUIRE(!db.check_address_open_for_deployment(addr));
+    }
+}
+
+TEST_CASE("parallel deployments", "[contract_db]")
+{
+    ContractDB db;
+
+    auto c = load_wasm_from_file("cpp_contracts/test_log.wasm");
+    auto h = hash_xdr(*c);
+
+    Address genesis_addr;
+    genesis_addr.fill(1);
+    test::deploy_and_commit_contractdb(db, genesis_addr, c);
+
+    const uint64_t n = 10'000;
+
+    db.prepare_for_block(n);
+    REQUIRE(deploy_wallets(db, h, n) == 0);
+    db.commit(1);
+
+    for (uint64_t i = 0; i < n; i++) {
+        auto addr = compute_contract_deploy_address(uncommitted_contracts_sender(), h, i);
+        REQUIRE(!db.check_address_open_for_deployment(addr));
+    }
+
+    // every address is now taken
+    REQUIRE(deploy_wallets(db, h, n) == n);
+    db.rewind();
+}
+
+TEST_CASE("deploy 100k wallets", "[.][contract_db][bench]")
+{
+    ContractDB db;
+
+    auto c = load_wasm_from_file("cpp_contracts/test_log.wasm");
+    auto h = hash_xdr(*c);
+
+    Address genesis_addr;
+    genesis_addr.fill(1);
+    test::deploy_and_commit_contractdb(db, genesis_addr, c);
+
+    const uint64_t n = 100'000;
+
+    for (uint32_t block = 1; block <= 2; block++) {
+        auto ts = utils::init_time_measurement();
+
+        db.prepare_for_block(n);
+        auto failures = deploy_wallets(db, h, n, block * n);
+        double exec_time = utils::measure_time(ts);
+
+        db.commit(block);
+        double commit_time = utils::measure_time(ts);
+
+        REQUIRE(failures == 0);
+        std::printf("block %u: deployed %lu wallets in %lf, commit %lf\n",
+                    block, n, exec_time, commit_time);
+    }
+}
+
+} // namespace scs
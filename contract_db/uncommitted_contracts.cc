@@ -26,18 +26,7 @@ UncommittedContracts::deploy_contract_to_address(
     Address const& addr,
     Hash const& script_hash)
 {
-    std::lock_guard lock(mtx);
-
-    new_deployments.emplace(addr, script_hash);
-}
-
-void
-UncommittedContracts::undo_deploy_contract_to_address(
-    Address const& addr)
-{
-    std::lock_guard lock(mtx);
-
-    new_deployments.erase(addr);
+    logs.get().new_deployments.emplace_back(addr, script_hash);
 }
 
 void
@@ -45,32 +34,45 @@ UncommittedContracts::add_new_contract(
     Hash const& h,
     metered_contract_ptr_t new_contract)
 {
-    std::lock_guard lock(mtx);
-
-    auto [_, inserted] = new_contracts.emplace(h, new_contract);
-
-    if (!inserted)
-    {
-        throw std::runtime_error("invalid add_new_contract (already existed)");
-    }
+    logs.get().new_contracts.emplace_back(h, new_contract);
 }
 
 void
 UncommittedContracts::clear()
 {
-	new_contracts.clear();
-	new_deployments.clear();
+    for (auto& log : logs.get_objects()) {
+        if (log) {
+            log->new_contracts.clear();
+            log->new_deployments.clear();
+        }
+    }
+    claims.clear();
 }
 
 void
 UncommittedContracts::commit(ContractDB& contract_db)
 {
-    for (auto const& [hash, script] : new_contracts) {
-        contract_db.commit_contract_to_db(hash, script);
+    auto& objs = logs.get_objects();
+
+    for (auto const& log : objs) {
+        if (!log) {
+            continue;
+        }
+        for (auto const& [hash, script] : log->new_contracts) {
+            if (!contract_db.check_committed_contract_exists(hash)) {
+                contract_db.commit_contract_to_db(hash, script);
+            }
+        }
     }
 
-    for (auto const& [addr, hash] : new_deployments) {
-        contract_db.commit_registration(addr, hash);
+    // claims make addresses unique
+    for (auto const& log : objs) {
+        if (!log) {
+            continue;
+        }
+        for (auto const& [addr, hash] : log->new_deployments) {
+            contract_db.commit_registration(addr, hash);
+        }
     }
     clear();
 }
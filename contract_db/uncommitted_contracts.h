@@ -18,40 +18,69 @@
 
 #include "metering_ffi/metered_contract.h"
 
+#include "contract_db/deploy_address_claims.h"
+
+#include "config/static_constants.h"
+
 #include "xdr/storage.h"
 #include "xdr/storage_delta.h"
 #include "xdr/types.h"
 
 #include <cstdint>
-#include <map>
-#include <memory>
-#include <mutex>
+#include <utility>
 #include <vector>
 
 #include <utils/non_movable.h>
+#include <utils/threadlocal_cache.h>
 
 namespace scs {
 
 class ContractDB;
 
+/**
+ * Contracts and deployments of the current block's committed
+ * transactions.  Each thread appends to its own log;
+ * the logs are merged in commit().
+ *
+ * Two transactions deploying to one address are caught
+ * before either commits, through the address claims.
+ */
 class UncommittedContracts : public utils::NonMovableOrCopyable
 {
-    // map contract hash to contract
-    std::map<Hash, metered_contract_ptr_t> new_contracts;
+    struct ThreadLog
+    {
+        std::vector<std::pair<Hash, metered_contract_ptr_t>> new_contracts;
+        std::vector<std::pair<Address, Hash>> new_deployments;
+    };
 
-    // map address to contract hash
-    std::map<Address, Hash> new_deployments;
+    utils::ThreadlocalCache<ThreadLog, TLCACHE_SIZE> logs;
 
-    // temporary bad solution
-    std::mutex mtx;
+    DeployAddressClaims claims;
 
   public:
-    // caller must ensure script_hash exists
+    // before the block's first claim
+    void reserve_deploy_claims(uint64_t max_claims)
+    {
+        claims.reserve(max_claims);
+    }
+
+    // false if another transaction this block holds addr
+    bool try_claim_address(Address const& addr)
+    {
+        return claims.try_claim(addr);
+    }
+
+    // caller must hold the claim on addr
+    void release_address(Address const& addr)
+    {
+        claims.release(addr);
+    }
+
+    // caller must hold the claim on addr, and ensure script_hash exists
     void deploy_contract_to_address(Address const& addr,
                                     Hash const& script_hash);
 
-    void undo_deploy_contract_to_address(Address const& addr);
-
+    // the same contract can be added by several transactions
     void add_new_contract(Hash const& h, metered_contract_ptr_t new_contract);
 
     void commit(ContractDB& contract_db);
@@ -0,0 +1,146 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "sdk/calldata.h"
+#include "sdk/log.h"
+
+#include <string.h>
+
+/**
+ * Stresses the host implementations of env.{memcpy,memset,memcmp,strnlen}.
+ * Each method runs `reps` calls on buffers of `len` bytes
+ * and logs a value derived from the results (so the calls cannot be elided).
+ * The asm barriers keep clang from hoisting the (readonly) libc calls
+ * out of the loops.
+ */
+
+#define BENCH_BUF_SIZE 16384
+
+static uint8_t buf_a[BENCH_BUF_SIZE];
+static uint8_t buf_b[BENCH_BUF_SIZE];
+
+struct bench_calldata {
+	uint32_t len;
+	uint32_t reps;
+};
+
+static uint32_t
+clamp_len(uint32_t len)
+{
+	// leave room for a terminator in the strnlen bench
+	if (len >= BENCH_BUF_SIZE)
+	{
+		return BENCH_BUF_SIZE - 1;
+	}
+	return len;
+}
+
+static void
+fill_pattern(uint8_t* buf, uint32_t len)
+{
+	for (uint32_t i = 0; i < len; i++)
+	{
+		// never zero
+		buf[i] = (i % 255) + 1;
+	}
+}
+
+#define BARRIER() asm volatile("" ::: "memory")
+
+EXPORT("pub00000000")
+bench_memcpy()
+{
+	auto calldata = sdk::get_calldata<bench_calldata>();
+	uint32_t len = clamp_len(calldata.len);
+
+	fill_pattern(buf_b, len);
+
+	for (uint32_t i = 0; i < calldata.reps; i++)
+	{
+		memcpy(buf_a, buf_b, len);
+		BARRIER();
+	}
+
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < len; i++)
+	{
+		sum += buf_a[i];
+	}
+	sdk::log(sum);
+}
+
+EXPORT("pub01000000")
+bench_memset()
+{
+	auto calldata = sdk::get_calldata<bench_calldata>();
+	uint32_t len = clamp_len(calldata.len);
+
+	for (uint32_t i = 0; i < calldata.reps; i++)
+	{
+		memset(buf_a, i & 0xFF, len);
+		BARRIER();
+	}
+
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < len; i++)
+	{
+		sum += buf_a[i];
+	}
+	sdk::log(sum);
+}
+
+EXPORT("pub02000000")
+bench_memcmp()
+{
+	auto calldata = sdk::get_calldata<bench_calldata>();
+	uint32_t len = clamp_len(calldata.len);
+
+	fill_pattern(buf_a, len);
+	fill_pattern(buf_b, len);
+
+	// differ only in the last byte, so every call scans the whole range
+	if (len > 0)
+	{
+		buf_b[len - 1] ++;
+	}
+
+	int32_t res = 0;
+	for (uint32_t i = 0; i < calldata.reps; i++)
+	{
+		res = memcmp(buf_a, buf_b, len);
+		BARRIER();
+	}
+	sdk::log(res);
+}
+
+EXPORT("pub03000000")
+bench_strnlen()
+{
+	auto calldata = sdk::get_calldata<bench_calldata>();
+	uint32_t len = clamp_len(calldata.len);
+
+	fill_pattern(buf_a, len);
+	buf_a[len] = 0;
+
+	uint32_t res = 0;
+	for (uint32_t i = 0; i < calldata.reps; i++)
+	{
+		res = strnlen(reinterpret_cast<const char*>(buf_a), BENCH_BUF_SIZE);
+		BARRIER();
+	}
+	sdk::log(res);
+}
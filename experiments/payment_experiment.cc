@@ -26,6 +26,10 @@
 #include "crypto/crypto_utils.h"
 #include "crypto/hash.h"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+
 namespace scs {
 
 
@@ -194,6 +198,7 @@ PaymentExperiment::make_accounts_and_mints(const char* erc20_contract)
 
     Address token_addr = compute_contract_deploy_address(
         DEPLOYER_ADDRESS, token_contract_hash, UINT64_MAX);
+    token_address = token_addr;
 
     accounts_out.resize(num_accounts);
     mints_out.resize(num_accounts);
@@ -210,6 +215,56 @@ PaymentExperiment::make_accounts_and_mints(const char* erc20_contract)
     return { accounts_out, mints_out };
 }
 
+static AddressAndKey
+make_addrkey(Address const& addr, InvariantKey const& key)
+{
+    AddressAndKey out;
+    std::memcpy(out.data(), addr.data(), addr.size());
+    std::memcpy(out.data() + addr.size(), key.data(), key.size());
+    return out;
+}
+
+static InvariantKey
+make_balance_key(Hash const& account)
+{
+    xdr::opaque_vec<MAX_HASH_LEN> key;
+    key.insert(key.end(),
+        account.begin(),
+        account.end());
+    return hash_xdr(key);
+}
+
+static InvariantKey
+make_allowance_key(Hash const& owner, Hash const& auth)
+{
+    xdr::opaque_vec<MAX_HASH_LEN> key;
+    key.insert(key.end(),
+        owner.begin(),
+        owner.end());
+    key.insert(key.end(),
+        auth.begin(),
+        auth.end());
+    return hash_xdr(key);
+}
+
+// the wallet's pk, replay cache, and token address,
+// and its balance and allowance in the token
+static std::array<AddressAndKey, 5>
+make_account_keys(Address const& account, Address const& token_deploy_addr)
+{
+    const InvariantKey pkaddr = make_static_key(1);
+    const InvariantKey replayaddr = make_static_key(0);
+    const InvariantKey token_addr = make_static_key(0, 2);
+
+    return {
+        make_addrkey(account, pkaddr),
+        make_addrkey(account, replayaddr),
+        make_addrkey(account, token_addr),
+        make_addrkey(token_deploy_addr, make_balance_key(account)),
+        make_addrkey(token_deploy_addr, make_allowance_key(account, account))
+    };
+}
+
 std::vector<AddressAndKey> 
 PaymentExperiment::get_active_key_set()
 {
@@ -218,10 +273,6 @@ PaymentExperiment::get_active_key_set()
     Hash wallet_contract_hash = hash_xdr(
         *load_wasm_from_file(payment_contract));
 
-    InvariantKey pkaddr = make_static_key(1);
-    InvariantKey replayaddr = make_static_key(0);
-    InvariantKey token_addr = make_static_key(0, 2);
-
     const char* erc20_contract = (SisyphusStateDB::USE_ASSETS == 1) ? "cpp_contracts/sisyphus_erc20.wasm" : "cpp_contracts/erc20.wasm"; 
 
     Hash token_contract_hash
@@ -230,48 +281,14 @@ PaymentExperiment::get_active_key_set()
     Address token_deploy_addr = compute_contract_deploy_address(
         DEPLOYER_ADDRESS, token_contract_hash, UINT64_MAX);
 
-    auto make_balance_key = [&] (Hash const& account) -> InvariantKey {
-        xdr::opaque_vec<MAX_HASH_LEN> key;
-        key.insert(key.end(),
-            account.begin(),
-            account.end());
-        return hash_xdr(key);
-    };
-
-    auto make_allowance_key = [&] (Hash const& owner, Hash const& auth) -> InvariantKey 
-    {
-        xdr::opaque_vec<MAX_HASH_LEN> key;
-        key.insert(key.end(),
-            owner.begin(),
-            owner.end());
-        key.insert(key.end(),
-            auth.begin(),
-            auth.end());
-        return hash_xdr(key);
-    };
-
-
     tbb::parallel_for(tbb::blocked_range<size_t>(0, num_accounts),
      [&](auto r) {
         for (auto i = r.begin(); i < r.end(); i++) {
             auto account = compute_contract_deploy_address(
                     DEPLOYER_ADDRESS, wallet_contract_hash, i);
 
-            AddressAndKey addrkey;
-            std::memcpy(addrkey.data(), account.data(), account.size());
-            std::memcpy(addrkey.data() + account.size(), pkaddr.data(), pkaddr.size());
-            keys[5*i] = addrkey;
-            std::memcpy(addrkey.data() + account.size(), replayaddr.data(), replayaddr.size());
-            keys[5*i + 1] = addrkey;
-            std::memcpy(addrkey.data() + account.size(), token_addr.data(), token_addr.size());
-            keys[5*i + 2] = addrkey;
-            std::memcpy(addrkey.data(), token_deploy_addr.data(), token_deploy_addr.size());
-            auto bk = make_balance_key(account);
-            std::memcpy(addrkey.data() + token_deploy_addr.size(),bk.data(), bk.size());
-            keys[5*i + 3] = addrkey;
-            auto ak = make_allowance_key(account, account);
-            std::memcpy(addrkey.data() + token_deploy_addr.size(), ak.data(), ak.size());
-            keys[5*i + 4] = addrkey;
+            auto account_keys = make_account_keys(account, token_deploy_addr);
+            std::copy(account_keys.begin(), account_keys.end(), keys.begin() + 5*i);
         }
     });
 
@@ -323,6 +340,13 @@ PaymentExperiment::make_random_payment(uint64_t expiration_time,
     stx.tx.invocation = invocation;
     stx.tx.gas_limit = gas_limit;
 
+    // what the transfer touches: the sender's wallet and token keys,
+    // and the recipient's balance
+    auto src_keys = make_account_keys(src.wallet_address, token_address);
+    stx.tx.access_list.insert(stx.tx.access_list.end(), src_keys.begin(), src_keys.end());
+    stx.tx.access_list.push_back(
+        make_addrkey(token_address, make_balance_key(dst.wallet_address)));
+
     Hash msg = hash_xdr(stx.tx);
     Signature sig = sign_ed25519(src.sk, msg);
 
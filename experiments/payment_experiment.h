@@ -44,6 +44,9 @@ class PaymentExperiment
 
     std::map<uint64_t, account_entry> account_map;
 
+    // set by make_accounts_and_mints()
+    Address token_address;
+
     TxSetEntry make_deploy_wallet_transaction(
         size_t idx,
         Hash const& wallet_contract_hash,
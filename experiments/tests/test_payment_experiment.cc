@@ -98,11 +98,12 @@ TEST_CASE("payment experiment assemble block", "[experiment][payments]")
 
 		AssemblyLimits limits(10, INT64_MAX);
 
-		Block blk;
+		SerializedBlock blk;
 
 		auto header = vm -> propose_tx_block(limits, 1000, 10, blk);
 
-		REQUIRE(blk.transactions.size() == 10);
+		REQUIRE(blk.num_transactions() == 10);
+		REQUIRE(blk.to_block().transactions.size() == 10);
 	}
 
 	SECTION("prepare several small blocks")
@@ -110,14 +111,14 @@ TEST_CASE("payment experiment assemble block", "[experiment][payments]")
 		auto& mp = vm -> get_mempool();
 		REQUIRE(mp.add_txs(e.gen_transaction_batch(10000)) == 10000);
 
-		Block blk;
+		SerializedBlock blk;
 
 		for (size_t i = 0; i < 10; i++)
 		{
 			AssemblyLimits limits(100, INT64_MAX);
 			std::printf("============= start block ===============\n");
 			auto header = vm -> propose_tx_block(limits, 1000, 10, blk);
-			REQUIRE(blk.transactions.size() == 100);
+			REQUIRE(blk.num_transactions() == 100);
 		}
 	} 
 }
@@ -20,14 +20,159 @@
 
 #include "threadlocal/threadlocal_context.h"
 
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 using xdr::operator==;
 
 namespace scs {
 
+namespace {
+
+constexpr uint32_t TOMBSTONE_ALLOC = 0xFFFF'FFFF;
+
+uint32_t
+fingerprint(const HashSetEntry& h)
+{
+    // the group is chosen by shorthash() over the whole hash,
+    // so take the fingerprint from different bits.
+    // Collisions only cost an extra comparison.
+    uint64_t word;
+    std::memcpy(&word, h.hash.data() + 8, sizeof(uint64_t));
+    word = (word ^ h.index) * 0x9E37'79B9'7F4A'7C15ull;
+    return static_cast<uint32_t>(word >> 40);
+}
+
+// tag is the upper half of a slot
+uint32_t
+make_tag(uint32_t fp, uint8_t epoch)
+{
+    return (fp << 8) | epoch;
+}
+
+uint64_t
+make_slot(uint32_t tag, uint32_t alloc)
+{
+    return (static_cast<uint64_t>(tag) << 32) | alloc;
+}
+
+uint32_t
+slot_tag(uint64_t slot)
+{
+    return slot >> 32;
+}
+
+uint8_t
+slot_epoch(uint64_t slot)
+{
+    return static_cast<uint8_t>(slot >> 32);
+}
+
+uint32_t
+slot_alloc(uint64_t slot)
+{
+    return static_cast<uint32_t>(slot);
+}
+
+/**
+ * Returns (slots whose tag matches, slots that are empty in this epoch),
+ * as bitmasks with bit i for slot i.
+ *
+ * The vector loads are not atomic as a whole, but each aligned
+ * 8-byte lane is read without tearing, and the masks are
+ * only hints: candidates are reloaded atomically before use.
+ */
+std::pair<uint32_t, uint32_t>
+scan_group(const std::atomic<uint64_t>* slots, uint32_t tag, uint8_t epoch)
+{
+#if defined(__AVX2__)
+    const __m256i* ptr = reinterpret_cast<const __m256i*>(slots);
+    __m256i lo = _mm256_load_si256(ptr);
+    __m256i hi = _mm256_load_si256(ptr + 1);
+    __m256i tags = _mm256_set1_epi32(tag);
+    __m256i epoch_mask = _mm256_set1_epi64x(0xFFull << 32);
+    __m256i epochs = _mm256_set1_epi64x(static_cast<uint64_t>(epoch) << 32);
+
+    // movemask_pd reads bit 63 of each slot, which is set
+    // iff the upper half compared equal
+    auto upper_eq = [](__m256i a, __m256i b) -> uint32_t {
+        return _mm256_movemask_pd(
+            _mm256_castsi256_pd(_mm256_cmpeq_epi32(a, b)));
+    };
+
+    uint32_t match = upper_eq(lo, tags) | (upper_eq(hi, tags) << 4);
+    uint32_t live = upper_eq(_mm256_and_si256(lo, epoch_mask), epochs)
+                    | (upper_eq(_mm256_and_si256(hi, epoch_mask), epochs)
+                       << 4);
+    return { match, (~live) & 0xFF };
+#elif defined(__SSE2__)
+    const __m128i* ptr = reinterpret_cast<const __m128i*>(slots);
+    __m128i tags = _mm_set1_epi32(tag);
+    __m128i epoch_mask = _mm_set1_epi64x(0xFFull << 32);
+    __m128i epochs = _mm_set1_epi64x(static_cast<uint64_t>(epoch) << 32);
+
+    auto upper_eq = [](__m128i a, __m128i b) -> uint32_t {
+        return _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi32(a, b)));
+    };
+
+    uint32_t match = 0, live = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+        __m128i v = _mm_load_si128(ptr + i);
+        match |= upper_eq(v, tags) << (2 * i);
+        live |= upper_eq(_mm_and_si128(v, epoch_mask), epochs) << (2 * i);
+    }
+    return { match, (~live) & 0xFF };
+#else
+    uint32_t match = 0, empty = 0;
+    for (uint32_t i = 0; i < 8; i++) {
+        uint64_t local = slots[i].load(std::memory_order_relaxed);
+        match |= static_cast<uint32_t>(slot_tag(local) == tag) << i;
+        empty |= static_cast<uint32_t>(slot_epoch(local) != epoch) << i;
+    }
+    return { match, empty };
+#endif
+}
+
+} // namespace
+
+void
+AtomicSet::set_capacity(uint32_t new_capacity)
+{
+    capacity = new_capacity;
+    num_groups = (capacity + SLOTS_PER_GROUP - 1) / SLOTS_PER_GROUP;
+
+    if (num_groups <= allocated_groups) {
+        return;
+    }
+
+    // Sets only grow by (up to) doubling their max size
+    // per block, so grow geometrically to avoid reallocating
+    // every block, but not past what MAX_HASH_SET_SIZE needs.
+    constexpr uint32_t max_useful_groups
+        = (static_cast<uint32_t>(MAX_HASH_SET_SIZE * extra_buffer)
+           + SLOTS_PER_GROUP - 1)
+          / SLOTS_PER_GROUP;
+
+    uint32_t new_alloc = std::max(
+        num_groups, std::min(2 * allocated_groups, max_useful_groups));
+
+    if (groups != nullptr) {
+        delete[] groups;
+    }
+    groups = new group_t[new_alloc] {};
+    allocated_groups = new_alloc;
+    epoch = 1;
+}
+
 AtomicSet::~AtomicSet()
 {
-    if (array != nullptr) {
-        delete[] array;
+    if (groups != nullptr) {
+        delete[] groups;
     }
 }
 
@@ -39,20 +184,23 @@ AtomicSet::resize(uint32_t new_capacity)
         return;
     }
 
-    if (array != nullptr) {
-        delete[] array;
-    }
-    capacity = new_alloc_size;
-    array = new std::atomic<uint32_t>[capacity] {};
-
-    num_filled_slots = 0;
+    clear();
+    set_capacity(new_alloc_size);
 }
 
 void
 AtomicSet::clear()
 {
-    for (auto i = 0u; i < capacity; i++) {
-        array[i] = 0;
+    epoch++;
+    if (epoch == 0) {
+        // every slot not written in this cycle of epochs is zero,
+        // so every slot has an epoch in [1, 255]
+        for (auto i = 0u; i < allocated_groups; i++) {
+            for (auto& slot : groups[i].slots) {
+                slot.store(0, std::memory_order_relaxed);
+            }
+        }
+        epoch = 1;
     }
     num_filled_slots = 0;
 }
@@ -60,12 +208,6 @@ AtomicSet::clear()
 bool
 AtomicSet::try_insert(const HashSetEntry& h)
 {
-    const uint32_t start_idx
-        = shorthash(h.hash.data(), h.hash.size(), capacity);
-    uint32_t idx = start_idx;
-
-    uint32_t alloc = ThreadlocalContextStore::allocate_hash(HashSetEntry(h));
-
     const uint32_t cur_filled_slots
         = num_filled_slots.load(std::memory_order_relaxed);
 
@@ -73,79 +215,137 @@ AtomicSet::try_insert(const HashSetEntry& h)
         return false;
     }
 
+    const uint8_t cur_epoch = epoch;
+    const uint32_t tag = make_tag(fingerprint(h), cur_epoch);
+    const uint64_t tombstone
+        = make_slot(make_tag(0, cur_epoch), TOMBSTONE_ALLOC);
+
+    const uint32_t start_group
+        = shorthash(h.hash.data(), h.hash.size(), num_groups);
+    uint32_t g = start_group;
+
+    // allocated on first attempt to fill a slot
+    uint32_t alloc = 0;
+
     do {
+        auto* slots = groups[g].slots;
+
+        // slots below this are known not to hold h
+        uint32_t checked = 0;
+
         while (true) {
-            uint32_t local = array[idx].load(std::memory_order_relaxed);
+            auto [match, empty] = scan_group(slots, tag, cur_epoch);
 
-            // insert can be allowed to overwrite tombstones
-            if (local == 0) {
-                if (array[idx].compare_exchange_strong(
-                        local, alloc, std::memory_order_relaxed)) {
+            const uint32_t unchecked = ~((1u << checked) - 1);
+            match &= unchecked;
+            empty &= unchecked;
 
-                    num_filled_slots.fetch_add(1, std::memory_order_relaxed);
+            const uint32_t first_empty
+                = empty ? __builtin_ctz(empty) : SLOTS_PER_GROUP;
 
-                    return true;
-                } else {
-                    continue;
-                }
-            }
+            uint32_t candidates = match & ((1u << first_empty) - 1);
+            while (candidates) {
+                uint32_t i = __builtin_ctz(candidates);
+                candidates &= candidates - 1;
 
-            if (local != TOMBSTONE) {
-                if (ThreadlocalContextStore::get_hash(local) == h) {
+                uint64_t local = slots[i].load(std::memory_order_acquire);
+                if (local != tombstone && slot_tag(local) == tag
+                    && ThreadlocalContextStore::get_hash(slot_alloc(local))
+                           == h) {
                     return false;
-                } else {
-                    break;
                 }
-            } else {
+            }
+
+            if (first_empty == SLOTS_PER_GROUP) {
                 break;
             }
+
+            if (alloc == 0) {
+                alloc = ThreadlocalContextStore::allocate_hash(
+                    HashSetEntry(h));
+            }
+
+            // an empty slot may hold a stale value from an old epoch
+            uint64_t expect
+                = slots[first_empty].load(std::memory_order_relaxed);
+            if (slot_epoch(expect) != cur_epoch
+                && slots[first_empty].compare_exchange_strong(
+                    expect,
+                    make_slot(tag, alloc),
+                    std::memory_order_release,
+                    std::memory_order_relaxed)) {
+
+                num_filled_slots.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            // someone else filled first_empty (maybe with h),
+            // so rescan from there
+            checked = first_empty;
         }
 
-        idx++;
-        if (idx == capacity) {
-            idx = 0;
+        g++;
+        if (g == num_groups) {
+            g = 0;
         }
 
-    } while (idx != start_idx);
+    } while (g != start_group);
     return false;
 }
 
 void
 AtomicSet::erase(const HashSetEntry& h)
 {
-    const uint32_t start_idx
-        = shorthash(h.hash.data(), h.hash.size(), capacity);
-    uint32_t idx = start_idx;
+    if (num_groups == 0) {
+        throw std::runtime_error("deletion from empty set");
+    }
+
+    const uint8_t cur_epoch = epoch;
+    const uint32_t tag = make_tag(fingerprint(h), cur_epoch);
+    const uint64_t tombstone
+        = make_slot(make_tag(0, cur_epoch), TOMBSTONE_ALLOC);
+
+    const uint32_t start_group
+        = shorthash(h.hash.data(), h.hash.size(), num_groups);
+    uint32_t g = start_group;
 
     do {
-        while (true) {
-            uint32_t local = array[idx].load(std::memory_order_relaxed);
-
-            if (local != 0 && local != TOMBSTONE) {
-                if (ThreadlocalContextStore::get_hash(local) == h) {
-
-                    if (array[idx].compare_exchange_strong(
-                            local, TOMBSTONE, std::memory_order_relaxed)) {
-                        num_filled_slots.fetch_sub(1, std::memory_order_relaxed);
-                        return;
-                    } else {
-                        continue;
-                    }
+        auto* slots = groups[g].slots;
+
+        auto [match, empty] = scan_group(slots, tag, cur_epoch);
+
+        const uint32_t first_empty
+            = empty ? __builtin_ctz(empty) : SLOTS_PER_GROUP;
+
+        uint32_t candidates = match & ((1u << first_empty) - 1);
+        while (candidates) {
+            uint32_t i = __builtin_ctz(candidates);
+            candidates &= candidates - 1;
+
+            uint64_t local = slots[i].load(std::memory_order_acquire);
+            if (local != tombstone && slot_tag(local) == tag
+                && ThreadlocalContextStore::get_hash(slot_alloc(local)) == h) {
+
+                // an occupied slot can only change to a tombstone,
+                // so failure means a concurrent erase got here first
+                if (slots[i].compare_exchange_strong(
+                        local, tombstone, std::memory_order_relaxed)) {
+                    num_filled_slots.fetch_sub(1, std::memory_order_relaxed);
+                    return;
                 }
             }
+        }
 
-            if (local == 0) {
-                throw std::runtime_error("deletion failed to find elt");
-            }
-            break;
+        if (first_empty != SLOTS_PER_GROUP) {
+            throw std::runtime_error("deletion failed to find elt");
         }
 
-        idx++;
-        if (idx == capacity) {
-            idx = 0;
+        g++;
+        if (g == num_groups) {
+            g = 0;
         }
 
-    } while (idx != start_idx);
+    } while (g != start_group);
 
     throw std::runtime_error("deletion failed after complete scan");
 }
@@ -155,10 +355,18 @@ AtomicSet::get_hashes() const
 {
     std::vector<HashSetEntry> out;
 
-    for (uint32_t i = 0; i < capacity; i++) {
-        uint32_t idx = array[i].load(std::memory_order_relaxed);
-        if (idx != 0 && idx != TOMBSTONE) {
-            out.push_back(ThreadlocalContextStore::get_hash(idx));
+    if (empty()) {
+        return out;
+    }
+
+    for (uint32_t i = 0; i < num_groups; i++) {
+        for (auto const& slot : groups[i].slots) {
+            uint64_t local = slot.load(std::memory_order_relaxed);
+            if (slot_epoch(local) == epoch
+                && slot_alloc(local) != TOMBSTONE_ALLOC) {
+                out.push_back(
+                    ThreadlocalContextStore::get_hash(slot_alloc(local)));
+            }
         }
     }
     return out;
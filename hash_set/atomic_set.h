@@ -27,35 +27,83 @@
 
 namespace scs {
 
+/**
+ * Fixed-capacity concurrent set of HashSetEntries.
+ *
+ * Each slot is a 64-bit word packing a 24-bit fingerprint of the entry
+ * and an 8-bit epoch (upper half) with its index in the threadlocal
+ * hash allocator (lower half).  Slots are probed a cache-line group
+ * (8 slots) at a time; the tags of a group are compared with one SIMD
+ * op, so full entries (which live in another thread's allocator buffer)
+ * are only dereferenced on a fingerprint match.
+ *
+ * A slot is only occupied if its epoch matches the set's current epoch,
+ * so clear() is an epoch bump instead of a pass over every slot
+ * (the allocator indices in old slots are stale after
+ * ThreadlocalContextStore::post_block_clear() anyways).
+ * The array is zeroed only when the 8-bit epoch wraps.
+ *
+ * Within the probe sequence, a new entry always goes into the first
+ * empty slot, and slots never go back to empty within an epoch
+ * (erase leaves a tombstone), so a lookup can stop at the first empty slot.
+ */
 class AtomicSet : public utils::NonMovableOrCopyable
 {
     constexpr static float extra_buffer = 1.2;
 
+    constexpr static uint32_t SLOTS_PER_GROUP = 8;
+
+    struct alignas(64) group_t
+    {
+        std::atomic<uint64_t> slots[SLOTS_PER_GROUP];
+    };
+
+    static_assert(sizeof(group_t) == 64, "group should be one cache line");
+
+    // max number of entries in the set
     uint32_t capacity = 0;
 
-    std::atomic<uint32_t>* array = nullptr;
+    // groups in use for the current capacity
+    uint32_t num_groups = 0;
+
+    // groups in the array; resize() within this doesn't reallocate
+    uint32_t allocated_groups = 0;
+
+    group_t* groups = nullptr;
 
     std::atomic<uint32_t> num_filled_slots = 0;
 
-    constexpr static uint32_t TOMBSTONE = 0xFFFF'FFFF;
+    // 0 is never used, so a zeroed slot is always empty
+    uint8_t epoch = 1;
+
+    void set_capacity(uint32_t new_capacity);
 
   public:
     AtomicSet(uint32_t max_capacity)
-        : capacity(max_capacity * extra_buffer)
-        , array(nullptr)
     {
-        if (capacity > 0)
-        {
-           array = new std::atomic<uint32_t>[capacity] {};
-        }
+        set_capacity(max_capacity * extra_buffer);
     }
 
     ~AtomicSet();
 
+    // Never shrinks.  Clears the set unless new_capacity
+    // is smaller than the current capacity.
     void resize(uint32_t new_capacity);
 
     void clear();
 
+    // True if the set is no bigger than one sized for max_capacity
+    // (get_hashes() walks the whole capacity, however few entries).
+    bool sized_within(uint32_t max_capacity) const
+    {
+        return capacity <= static_cast<uint32_t>(max_capacity * extra_buffer);
+    }
+
+    bool empty() const
+    {
+        return num_filled_slots.load(std::memory_order_relaxed) == 0;
+    }
+
     bool try_insert(const HashSetEntry& h);
 
     // throws if nexist
@@ -0,0 +1,88 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "crypto/hash.h"
+#include "hash_set/atomic_set.h"
+
+#include "threadlocal/threadlocal_context.h"
+
+#include "test_utils/paired_workers.h"
+
+#include "xdr/storage.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+
+namespace scs {
+
+namespace {
+
+// Every entry is raced on by two inserters.
+// Exactly one insert of each entry should succeed.
+void
+run_concurrent_inserts(uint32_t num_threads, uint32_t per_thread)
+{
+    test::DeferredContextClear defer;
+
+    const uint32_t num_entries = num_threads * per_thread;
+
+    std::vector<HashSetEntry> entries;
+    entries.reserve(num_entries);
+    for (uint32_t i = 0; i < num_entries; i++) {
+        entries.emplace_back(hash_xdr<uint64_t>(i), i % 4);
+    }
+
+    AtomicSet set(num_entries);
+
+    auto res = test::run_paired_workers(
+        num_threads, per_thread, [&](uint32_t i) {
+            return set.try_insert(entries[i]);
+        });
+    const uint64_t elapsed = res.elapsed_ns;
+
+    std::printf("atomic set: %" PRIu32 " threads, %" PRIu32
+                " inserts in %.3f ms (%.1f ns/insert)\n",
+                num_threads,
+                2 * num_entries,
+                elapsed / 1'000'000.0,
+                static_cast<double>(elapsed) / (2 * num_entries));
+
+    REQUIRE(res.successes == num_entries);
+
+    auto hashes = set.get_hashes();
+    REQUIRE(hashes.size() == num_entries);
+
+    for (uint32_t i = 0; i < num_entries; i += 997) {
+        REQUIRE(!set.try_insert(entries[i]));
+    }
+}
+
+} // namespace
+
+TEST_CASE("atomic set concurrent inserts", "[hashset]")
+{
+    run_concurrent_inserts(4, 10'000);
+}
+
+TEST_CASE("atomic set 96 inserters", "[.][hashset][bench]")
+{
+    run_concurrent_inserts(96, 20'000);
+}
+
+} // namespace scs
@@ -159,4 +159,71 @@ TEST_CASE("insert and delete", "[hashset]")
     }
 }
 
+TEST_CASE("clear and resize across epochs", "[hashset]")
+{
+    AtomicSet set(10);
+
+    auto good_insert
+        = [&](uint64_t i) { REQUIRE(set.try_insert(HashSetEntry(hash_xdr(i), 0))); };
+
+    auto bad_insert
+        = [&](uint64_t i) { REQUIRE(!set.try_insert(HashSetEntry(hash_xdr(i), 0))); };
+
+    SECTION("clear many times")
+    {
+        // enough to wrap the epoch counter more than once
+        for (uint64_t round = 0; round < 600; round++) {
+            good_insert(0);
+            good_insert(round + 1);
+            bad_insert(0);
+
+            REQUIRE(set.get_hashes().size() == 2);
+            set.clear();
+            REQUIRE(set.get_hashes().size() == 0);
+        }
+    }
+
+    SECTION("erase then clear")
+    {
+        for (uint64_t round = 0; round < 300; round++) {
+            good_insert(1);
+            good_insert(2);
+            set.erase(HashSetEntry(hash_xdr<uint64_t>(1), 0));
+            good_insert(1);
+            set.clear();
+        }
+        good_insert(1);
+        good_insert(2);
+        REQUIRE(set.get_hashes().size() == 2);
+    }
+
+    SECTION("grow and shrink")
+    {
+        for (uint64_t i = 0; i < 10; i++) {
+            good_insert(i);
+        }
+
+        set.resize(100);
+        REQUIRE(set.get_hashes().size() == 0);
+
+        for (uint64_t i = 0; i < 100; i++) {
+            good_insert(i);
+        }
+
+        // no-op
+        set.resize(50);
+        REQUIRE(set.get_hashes().size() == 100);
+        bad_insert(0);
+        REQUIRE(set.sized_within(100));
+        REQUIRE(!set.sized_within(50));
+
+        set.clear();
+        set.resize(200);
+        for (uint64_t i = 0; i < 200; i++) {
+            good_insert(i);
+        }
+        REQUIRE(set.get_hashes().size() == 200);
+    }
+}
+
 } // namespace scs
\ No newline at end of file
@@ -17,6 +17,7 @@
  */
 
 #include <algorithm>
+#include <optional>
 #include "xdr/storage.h"
 #include "object/comparators.h"
 
@@ -30,6 +31,38 @@ static void normalize_hashset(HashSet& hs)
 	std::sort(h_list.begin(), h_list.end(), std::greater<HashSetEntry>());
 }
 
+[[maybe_unused]]
+static bool is_normalized_hashset(HashSet const& hs)
+{
+	auto const& h_list = hs.hashes;
+	return std::is_sorted(h_list.begin(), h_list.end(), std::greater<HashSetEntry>());
+}
+
+// requires hs to be normalized
+[[maybe_unused]]
+static bool hashset_contains(HashSet const& hs, HashSetEntry const& entry)
+{
+	auto const& h_list = hs.hashes;
+	return std::binary_search(h_list.begin(), h_list.end(), entry, std::greater<HashSetEntry>());
+}
+
+// requires hs to be normalized.
+// Returns the offset of the first entry with the given index, if any.
+[[maybe_unused]]
+static std::optional<uint32_t> hashset_find_index(HashSet const& hs, uint64_t index)
+{
+	auto const& h_list = hs.hashes;
+	auto it = std::lower_bound(h_list.begin(), h_list.end(), index,
+		[] (HashSetEntry const& entry, uint64_t idx) {
+			return entry.index > idx;
+		});
+	if (it == h_list.end() || it -> index != index)
+	{
+		return std::nullopt;
+	}
+	return it - h_list.begin();
+}
+
 [[maybe_unused]]
 static void clear_hashset(HashSet& hs, uint64_t threshold)
 {
@@ -48,7 +48,7 @@ run_experiment(uint32_t num_accounts,
 
     auto ts = utils::init_time_measurement();
 
-    Block block_buffer;
+    SerializedBlock block_buffer;
     // std::vector<std::unique_ptr<Block>> gc;
 
     for (size_t i = 0; i < num_blocks; i++) {
@@ -60,7 +60,7 @@ run_experiment(uint32_t num_accounts,
                 = vm->propose_tx_block(limits, 100'000, num_threads, block_buffer);
         std::printf("local measurement %lf\n", utils::measure_time(ts_local));
 
-        uint64_t blk_size = block_buffer.transactions.size();
+        uint64_t blk_size = block_buffer.num_transactions();
         double duration = utils::measure_time(ts);
 
         std::printf("duration: %lf size %lu rate %lf remaining_mempool %lu \n",
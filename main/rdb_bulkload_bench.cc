@@ -0,0 +1,184 @@
+#include "persistence/rdb_bulk_load.h"
+#include "persistence/rocksdb_wrapper.h"
+#include "persistence/segment_log.h"
+
+#include "config/static_constants.h"
+
+#include <utils/time.h>
+
+#include <tbb/global_control.h>
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace scs;
+
+/**
+ * Compares ways of making a block's trie values durable:
+ *  - bulk: rdb_bulk_load() (sorted SST files, ingested)
+ *  - put: one rocksdb Put() per value (as DirectWriteRocksDBIface does)
+ *  - log: one key log record per block, as AsyncKeysToDisk writes
+ *    SerializeDiskInterface's buffers
+ */
+
+// same shape as the trie's durable keys (timestamp, node pointer)
+struct BenchKey
+{
+    uint32_t timestamp;
+    uint32_t pad;
+    uint64_t id;
+};
+
+struct BenchBlock
+{
+    std::vector<BenchKey> keys;
+    std::vector<std::vector<uint8_t>> values;
+};
+
+BenchBlock
+make_block(uint32_t timestamp, uint64_t num_keys, uint32_t value_bytes, std::mt19937_64& gen)
+{
+    BenchBlock out;
+    out.keys.resize(num_keys);
+    out.values.resize(num_keys);
+    for (uint64_t i = 0; i < num_keys; i++) {
+        out.keys[i] = BenchKey{ .timestamp = timestamp, .pad = 0, .id = gen() };
+        out.values[i].resize(value_bytes);
+        std::memcpy(out.values[i].data(), &out.keys[i].id, std::min<size_t>(value_bytes, 8));
+    }
+    return out;
+}
+
+std::vector<rdb_kv_t>
+make_kvs(BenchBlock const& block)
+{
+    std::vector<rdb_kv_t> kvs;
+    kvs.reserve(block.keys.size());
+    for (size_t i = 0; i < block.keys.size(); i++) {
+        kvs.emplace_back(
+            rocksdb::Slice(reinterpret_cast<const char*>(&block.keys[i]), sizeof(BenchKey)),
+            rocksdb::Slice(reinterpret_cast<const char*>(block.values[i].data()), block.values[i].size()));
+    }
+    return kvs;
+}
+
+double
+run_bulk(std::vector<BenchBlock> const& blocks)
+{
+    RocksdbWrapper rdb("bench_rdb_bulk");
+    rdb.clear_previous();
+    rdb.open();
+
+    double total = 0;
+    uint64_t count = 0;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        auto kvs = make_kvs(blocks[i]);
+        auto ts = utils::init_time_measurement();
+        rdb_bulk_load(rdb, kvs, "bench_rdb_staging/", i);
+        total += utils::measure_time(ts);
+        count += kvs.size();
+    }
+
+    // spot check
+    std::string value;
+    auto const& key = blocks.back().keys.back();
+    rdb.get(rocksdb::Slice(reinterpret_cast<const char*>(&key), sizeof(key)), value);
+    if (value.size() != blocks.back().values.back().size()) {
+        throw std::runtime_error("bulk load lost a value");
+    }
+    return count / total;
+}
+
+double
+run_put(std::vector<BenchBlock> const& blocks)
+{
+    RocksdbWrapper rdb("bench_rdb_put");
+    rdb.clear_previous();
+    rdb.open();
+
+    double total = 0;
+    uint64_t count = 0;
+    for (auto const& block : blocks) {
+        auto kvs = make_kvs(block);
+        auto ts = utils::init_time_measurement();
+        for (auto const& [k, v] : kvs) {
+            rdb.put(k, v);
+        }
+        total += utils::measure_time(ts);
+        count += kvs.size();
+    }
+    return count / total;
+}
+
+double
+run_log(std::vector<BenchBlock> const& blocks)
+{
+    SegmentLog log("bench_segment_log/");
+    log.clear();
+
+    double total = 0;
+    uint64_t count = 0;
+    std::vector<std::vector<uint8_t>> bufs(TLCACHE_SIZE);
+    for (auto const& block : blocks) {
+        // the trie fills one buffer per thread
+        for (auto& buf : bufs) {
+            buf.clear();
+        }
+        for (size_t i = 0; i < block.keys.size(); i++) {
+            auto& buf = bufs[i % TLCACHE_SIZE];
+            auto const* k = reinterpret_cast<const uint8_t*>(&block.keys[i]);
+            buf.insert(buf.end(), k, k + sizeof(BenchKey));
+            buf.insert(buf.end(), block.values[i].begin(), block.values[i].end());
+        }
+
+        auto ts = utils::init_time_measurement();
+        log.append(block.keys.front().timestamp, bufs);
+        log.sync();
+        total += utils::measure_time(ts);
+        count += block.keys.size();
+    }
+    log.clear();
+    return count / total;
+}
+
+int
+main(int argc, const char** argv)
+{
+    std::vector<uint64_t> block_sizes = { 10'000, 100'000, 1'000'000 };
+    std::vector<uint32_t> value_sizes = { 32, 256 };
+    std::vector<uint32_t> nthreads = { 1, 8, 32 };
+    const uint32_t num_blocks = 10;
+
+    std::mt19937_64 gen(0);
+
+    for (auto block_size : block_sizes) {
+        for (auto value_size : value_sizes) {
+            std::vector<BenchBlock> blocks;
+            for (uint32_t i = 0; i < num_blocks; i++) {
+                blocks.push_back(make_block(i + 1, block_size, value_size, gen));
+            }
+
+            for (auto n : nthreads) {
+                tbb::global_control control(
+                    tbb::global_control::max_allowed_parallelism, n);
+
+                double bulk_rate = run_bulk(blocks);
+                double put_rate = run_put(blocks);
+                double log_rate = run_log(blocks);
+
+                std::printf("result: keys/block %" PRIu64 " value %" PRIu32
+                            " nthread %" PRIu32
+                            " bulk %lf put %lf log %lf (keys/s)\n",
+                            block_size,
+                            value_size,
+                            n,
+                            bulk_rate,
+                            put_rate,
+                            log_rate);
+            }
+        }
+    }
+}
@@ -14,7 +14,7 @@
 
 using namespace scs;
 
-AsyncPersistXDR<Block> block_persist("block_logs/");
+AsyncPersistXDR<SerializedBlock> block_persist("block_logs/");
 
 AsyncPersistXDR<ModIndexLog> log_persist("modlog_logs/");
 
@@ -53,7 +53,7 @@ run_experiment(uint32_t num_accounts,
 
     auto ts = utils::init_time_measurement();
 
-    Block block_buffer;
+    SerializedBlock block_buffer;
     ModIndexLog log_buffer;
 
     block_persist.clear_folder();
@@ -71,7 +71,7 @@ run_experiment(uint32_t num_accounts,
                 = vm->propose_tx_block(limits, 100'000, num_threads, block_buffer, log_buffer);
         std::printf("local measurement %lf\n", utils::measure_time(ts_local));
 
-        uint64_t blk_size = block_buffer.transactions.size();
+        uint64_t blk_size = block_buffer.num_transactions();
         double duration = utils::measure_time(ts);
 
         block_persist.log(block_buffer, blk_number);
@@ -10,11 +10,17 @@
 
 #include "persistence/persist_xdr.h"
 
+#include "state_db/proof_batch.h"
+
+#include "debug/debug_utils.h"
+
+#include <algorithm>
+
 #include <tbb/global_control.h>
 
 using namespace scs;
 
-AsyncPersistXDR<Block> block_persist("block_logs/");
+AsyncPersistXDR<SerializedBlock> block_persist("block_logs/");
 
 AsyncPersistXDR<ModIndexLog> log_persist("modlog_logs/");
 
@@ -45,7 +51,7 @@ run_experiment(uint32_t num_accounts,
 
     auto ts = utils::init_time_measurement();
 
-    Block block_buffer;
+    SerializedBlock block_buffer;
     ModIndexLog log_buffer;
 
     block_persist.clear_folder();
@@ -70,7 +76,7 @@ run_experiment(uint32_t num_accounts,
     	auto header
                 = vm->propose_tx_block(limits, 100'000, 96, block_buffer, log_buffer, &blk_context);
 
-        uint64_t blk_size = block_buffer.transactions.size();
+        uint64_t blk_size = block_buffer.num_transactions();
         double duration = utils::measure_time(ts);
 
         block_persist.log(block_buffer, blk_number);
@@ -81,11 +87,14 @@ run_experiment(uint32_t num_accounts,
 
         std::map<DeltaType, std::vector<uint32_t>> stats;
 
+        std::vector<TypedModificationIndex::trie_prefix_t> index_keys;
+
         for (auto const& il : log_buffer)
         {
             auto key = make_index_key(il.addr, il.delta, il.tx_hash);
             auto pf = index.get_keys().make_proof(key, key.len());
             stats[il.delta.type()].push_back(pf.serialize().size());
+            index_keys.push_back(key);
         }
 
         std::vector<uint32_t> statedb_sizes;
@@ -98,6 +107,32 @@ run_experiment(uint32_t num_accounts,
             statedb_sizes.push_back(pf.serialize().size());
         }
 
+        std::sort(index_keys.begin(), index_keys.end(), [] (auto const& a, auto const& b) {
+            return a.get_bytes_array() < b.get_bytes_array();
+        });
+        std::vector<AddressAndKey> sorted_keys = keys;
+        std::sort(sorted_keys.begin(), sorted_keys.end());
+
+        auto ts_batch = utils::init_time_measurement();
+        auto index_batch = make_proof_batch(index_keys, [&] (auto const& key) {
+            return index.get_keys().make_proof(key, key.len()).serialize();
+        });
+        auto statedb_batch = make_proof_batch(sorted_keys, [&] (auto const& addr) {
+            auto prefix = prefix_t(addr);
+            return sdb.get_trie().make_proof(prefix, prefix.len()).serialize();
+        });
+        double batch_time = utils::measure_time(ts_batch);
+
+        std::printf("trial %u proof batch nacc %lu batch %lu modlog keys %lu size %lu sdb keys %lu size %lu time %lf\n",
+            i,
+            num_accounts,
+            batch_size,
+            index_keys.size(),
+            index_batch.size(),
+            sorted_keys.size(),
+            statedb_batch.size(),
+            batch_time);
+
         for (auto it = stats.begin(); it != stats.end(); it++)
         {
             uint32_t max = 0, min = UINT32_MAX;
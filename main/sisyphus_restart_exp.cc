@@ -0,0 +1,81 @@
+#include "experiments/payment_experiment.h"
+
+#include <utils/mkdir.h>
+#include <utils/time.h>
+
+#include "sisyphus_vm/vm.h"
+
+#include "config/static_constants.h"
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <tbb/global_control.h>
+
+using namespace scs;
+
+/**
+ * Times a restart of the sisyphus vm (SisyphusVirtualMachine::try_restore_from_disk())
+ * after creating num_accounts accounts.  SisyphusStateDB::restore() prints
+ * the time to build the trie and to check its root hash.
+ */
+void
+run_experiment(uint32_t num_accounts, uint32_t num_threads)
+{
+    // a restart reads whatever earlier runs left behind
+    for (auto const* folder : { "sisyphusdb_logs/", "contract_log/" }) {
+        utils::mkdir_safe(folder);
+        utils::clear_directory(folder);
+    }
+
+    {
+        PaymentExperiment e(num_accounts, 0);
+
+        auto vm = e.prepare_sisyphus_vm();
+
+        if (!vm) {
+            throw std::runtime_error("failed to initialize virtual machine!");
+        }
+        std::printf("prepared %lu accounts, blk num = %lu\n",
+                    num_accounts,
+                    vm->get_current_block_number());
+    }
+
+    tbb::global_control control(tbb::global_control::max_allowed_parallelism,
+                                num_threads);
+
+    auto ts = utils::init_time_measurement();
+
+    SisyphusVirtualMachine vm;
+    if (!vm.try_restore_from_disk()) {
+        throw std::runtime_error("nothing to restore");
+    }
+
+    double duration = utils::measure_time(ts);
+
+    std::printf("result: restart nacc %lu nthread %lu blk num %lu time %lf\n",
+                num_accounts,
+                num_threads,
+                vm.get_current_block_number(),
+                duration);
+}
+
+int
+main(int argc, const char** argv)
+{
+    if constexpr (!PERSISTENT_STORAGE_ENABLED) {
+        std::printf("needs PERSISTENT_STORAGE_ENABLED\n");
+        return 1;
+    }
+
+    uint32_t num_accounts = 10'000'000;
+    uint32_t num_threads = 96;
+    if (argc > 1) {
+        num_accounts = std::strtoul(argv[1], nullptr, 10);
+    }
+    if (argc > 2) {
+        num_threads = std::strtoul(argv[2], nullptr, 10);
+    }
+
+    run_experiment(num_accounts, num_threads);
+}
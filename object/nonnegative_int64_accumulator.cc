@@ -0,0 +1,246 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "object/nonnegative_int64_accumulator.h"
+
+#include <utils/compat.h>
+#include <utils/threadlocal_cache.h>
+
+namespace scs {
+
+NonnegativeInt64Accumulator::NonnegativeInt64Accumulator()
+    : central_budget(UNINITIALIZED)
+    , base(0)
+    , central_added()
+    , num_deltas(0)
+    , stripes(nullptr)
+    , draining()
+    , refills_in_flight(0)
+{
+    central_added.clear();
+}
+
+NonnegativeInt64Accumulator::~NonnegativeInt64Accumulator()
+{
+    delete stripes.load(std::memory_order_relaxed);
+}
+
+void
+NonnegativeInt64Accumulator::count_delta()
+{
+    // exactly one thread sees the threshold
+    if (num_deltas.fetch_add(1, std::memory_order_relaxed) + 1
+        == NN_INT64_HOT_THRESHOLD) {
+        stripes.store(new stripes_t{}, std::memory_order_release);
+    }
+}
+
+NonnegativeInt64Accumulator::stripe_t&
+NonnegativeInt64Accumulator::get_stripe(stripes_t* s)
+{
+    return s->stripes[utils::ThreadlocalIdentifier::get() % NN_INT64_STRIPES];
+}
+
+bool
+NonnegativeInt64Accumulator::try_take(std::atomic<int64_t>& budget,
+                                      uint64_t amount)
+{
+    int64_t cur = budget.load(std::memory_order_relaxed);
+    while (true) {
+        if (static_cast<uint64_t>(cur) < amount) {
+            return false;
+        }
+        if (budget.compare_exchange_weak(
+                cur, cur - amount, std::memory_order_relaxed)) {
+            return true;
+        }
+        SPINLOCK_PAUSE();
+    }
+}
+
+bool
+NonnegativeInt64Accumulator::drain_and_take(stripes_t* s, uint64_t amount)
+{
+    while (draining.test_and_set(std::memory_order_seq_cst)) {
+        SPINLOCK_PAUSE();
+    }
+
+    // Refills that started before the drain could move budget
+    // into a stripe after it is drained, hiding it from try_take() below.
+    // Refills that start after see draining and wait for this drain instead.
+    while (refills_in_flight.load(std::memory_order_seq_cst) != 0) {
+        SPINLOCK_PAUSE();
+    }
+
+    for (auto& stripe : s->stripes) {
+        int64_t v = stripe.budget.exchange(0, std::memory_order_relaxed);
+        central_budget.fetch_add(v, std::memory_order_relaxed);
+    }
+
+    bool res = try_take(central_budget, amount);
+
+    draining.clear(std::memory_order_release);
+    return res;
+}
+
+bool
+NonnegativeInt64Accumulator::try_debit(int64_t base_value, int64_t d)
+{
+    if (base_value < 0) {
+        return false;
+    }
+
+    if (central_budget.load(std::memory_order_relaxed) == UNINITIALIZED) {
+        // racing initializers all write the same base
+        base.store(base_value, std::memory_order_relaxed);
+        int64_t expect = UNINITIALIZED;
+        central_budget.compare_exchange_strong(
+            expect, base_value, std::memory_order_relaxed);
+    }
+
+    // well-defined for d = INT64_MIN
+    const uint64_t amount = -static_cast<uint64_t>(d);
+
+    stripes_t* s = stripes.load(std::memory_order_acquire);
+
+    if (s == nullptr) {
+        count_delta();
+        if (try_take(central_budget, amount)) {
+            return true;
+        }
+        // stripes may have been enabled (and taken budget) concurrently
+        s = stripes.load(std::memory_order_acquire);
+        if (s == nullptr) {
+            return false;
+        }
+        return drain_and_take(s, amount);
+    }
+
+    auto& stripe = get_stripe(s);
+    if (try_take(stripe.budget, amount)) {
+        return true;
+    }
+
+    // refill the stripe with a share of the central budget,
+    // unless a drain is moving budget the other way
+    refills_in_flight.fetch_add(1, std::memory_order_seq_cst);
+    if (!draining.test(std::memory_order_seq_cst)) {
+        int64_t avail = central_budget.load(std::memory_order_relaxed);
+        while (static_cast<uint64_t>(avail) >= amount) {
+            uint64_t take
+                = std::max<uint64_t>(amount, avail / NN_INT64_STRIPES);
+            if (central_budget.compare_exchange_weak(
+                    avail, avail - take, std::memory_order_relaxed)) {
+                stripe.budget.fetch_add(take - amount,
+                                        std::memory_order_relaxed);
+                refills_in_flight.fetch_sub(1, std::memory_order_release);
+                return true;
+            }
+            SPINLOCK_PAUSE();
+        }
+    }
+    refills_in_flight.fetch_sub(1, std::memory_order_release);
+
+    return drain_and_take(s, amount);
+}
+
+void
+NonnegativeInt64Accumulator::revert_debit(int64_t d)
+{
+    const uint64_t amount = -static_cast<uint64_t>(d);
+
+    stripes_t* s = stripes.load(std::memory_order_acquire);
+    if (s == nullptr) {
+        central_budget.fetch_add(amount, std::memory_order_relaxed);
+        return;
+    }
+    get_stripe(s).budget.fetch_add(amount, std::memory_order_relaxed);
+}
+
+void
+NonnegativeInt64Accumulator::credit(int64_t d)
+{
+    stripes_t* s = stripes.load(std::memory_order_acquire);
+    if (s == nullptr) {
+        count_delta();
+        central_added.add(d);
+        return;
+    }
+    get_stripe(s).added.add(d);
+}
+
+void
+NonnegativeInt64Accumulator::revert_credit(int64_t d)
+{
+    // may not land in the accumulator that the credit went to,
+    // hence fetch_signed() in fold_added()
+    stripes_t* s = stripes.load(std::memory_order_acquire);
+    if (s == nullptr) {
+        central_added.sub(d);
+        return;
+    }
+    get_stripe(s).added.sub(d);
+}
+
+int64_t
+NonnegativeInt64Accumulator::fold_subtracted()
+{
+    int64_t remaining = central_budget.load(std::memory_order_relaxed);
+    if (remaining == UNINITIALIZED) {
+        return 0;
+    }
+
+    stripes_t* s = stripes.load(std::memory_order_relaxed);
+    if (s != nullptr) {
+        for (auto& stripe : s->stripes) {
+            remaining += stripe.budget.load(std::memory_order_relaxed);
+        }
+    }
+    return remaining - base.load(std::memory_order_relaxed);
+}
+
+uint64_t
+NonnegativeInt64Accumulator::fold_added()
+{
+    __int128 total = central_added.fetch_signed();
+
+    stripes_t* s = stripes.load(std::memory_order_relaxed);
+    if (s != nullptr) {
+        for (auto& stripe : s->stripes) {
+            total += stripe.added.fetch_signed();
+        }
+    }
+
+    if (total <= 0) {
+        return 0;
+    }
+    if (total > static_cast<__int128>(UINT64_MAX)) {
+        return UINT64_MAX;
+    }
+    return static_cast<uint64_t>(total);
+}
+
+void
+NonnegativeInt64Accumulator::clear()
+{
+    central_budget.store(UNINITIALIZED, std::memory_order_relaxed);
+    base.store(0, std::memory_order_relaxed);
+    central_added.clear();
+    num_deltas.store(0, std::memory_order_relaxed);
+    delete stripes.exchange(nullptr, std::memory_order_relaxed);
+}
+
+} // namespace scs
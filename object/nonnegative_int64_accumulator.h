@@ -0,0 +1,115 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config/static_constants.h"
+
+#include "utils/atomic_uint128.h"
+
+#include <utils/non_movable.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace scs {
+
+/**
+ * Uncommitted credits and debits to one nonnegative int64 object
+ * within a block.
+ *
+ * A debit is admitted only if the base value covers it plus every other
+ * in-flight debit.  This is tracked as a budget (base value minus in-flight
+ * debits) that starts out in one central word.
+ *
+ * Once an object sees NN_INT64_HOT_THRESHOLD deltas in a block,
+ * it switches to striped mode: each thread credits (and debits from)
+ * one of NN_INT64_STRIPES cache-line sized stripes,
+ * and stripes take budget from the central word in chunks.
+ *
+ * Budget is only ever moved, never copied, so the central budget
+ * plus all stripe budgets is exactly the base value minus in-flight debits,
+ * and no debit can take that below 0.  When neither its stripe nor the
+ * central word can cover a debit, the stripes are drained back to the
+ * central word (one thread at a time) before the debit fails.
+ * Stripes do not refill while a drain is running, so a drain sees
+ * all budget not held by in-flight debits.
+ *
+ * fold_*() and clear() must not be called concurrently with anything else.
+ */
+class NonnegativeInt64Accumulator : public utils::NonMovableOrCopyable
+{
+    struct alignas(64) stripe_t
+    {
+        std::atomic<int64_t> budget;
+        AtomicUint128 added;
+    };
+
+    struct stripes_t
+    {
+        stripe_t stripes[NN_INT64_STRIPES];
+    };
+
+    // budget is always >= 0 once initialized
+    constexpr static int64_t UNINITIALIZED = -1;
+
+    std::atomic<int64_t> central_budget;
+    std::atomic<int64_t> base;
+    AtomicUint128 central_added;
+
+    std::atomic<uint32_t> num_deltas;
+    std::atomic<stripes_t*> stripes;
+
+    std::atomic_flag draining;
+    std::atomic<uint32_t> refills_in_flight;
+
+    void count_delta();
+
+    stripe_t& get_stripe(stripes_t* s);
+
+    bool try_take(std::atomic<int64_t>& budget, uint64_t amount);
+
+    bool drain_and_take(stripes_t* s, uint64_t amount);
+
+  public:
+    NonnegativeInt64Accumulator();
+
+    // base is the value the delta set (identical for every delta in a block).
+    // d < 0
+    bool try_debit(int64_t base_value, int64_t d);
+    void revert_debit(int64_t d);
+
+    // d >= 0
+    void credit(int64_t d);
+    void revert_credit(int64_t d);
+
+    // change in value from debits (<= 0)
+    int64_t fold_subtracted();
+
+    // credits, capped at UINT64_MAX
+    uint64_t fold_added();
+
+    bool is_striped() const
+    {
+        return stripes.load(std::memory_order_relaxed) != nullptr;
+    }
+
+    void clear();
+
+    ~NonnegativeInt64Accumulator();
+};
+
+} // namespace scs
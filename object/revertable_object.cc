@@ -23,8 +23,13 @@
 
 #include "debug/debug_utils.h"
 
+#include "hash_set/atomic_set.h"
 #include "hash_set/utils.h"
 
+#include "object/nonnegative_int64_accumulator.h"
+
+#include "utils/object_pool.h"
+
 #include <utils/assert.h>
 #include <utils/compat.h>
 
@@ -280,6 +285,140 @@ bool try_add_uint64(int64_t delta, std::atomic<uint64_t>& base)
     }
 }
 
+struct RevertableObject::ModificationState
+{
+    // for nn_int64
+    NonnegativeInt64Accumulator nn_int64;
+
+    // for hash_set
+    std::atomic<uint64_t> size_increase;
+    AtomicSet new_hashes;
+    std::atomic<uint32_t> num_new_elts;
+
+    // For a new key, new_hashes is sized by the first insert,
+    // so that new keys of other types never allocate its array.
+    enum : uint32_t
+    {
+        HASHES_UNSIZED = 0,
+        HASHES_SIZING = 1,
+        HASHES_SIZED = 2
+    };
+    std::atomic<uint32_t> new_hashes_state;
+
+    std::atomic<bool> hashset_clear_committed;
+    std::atomic<uint64_t> max_committed_clear_threshold;
+
+    // for asset obj
+    // ensure value >=0 and value <= UINT64_MAX
+    // asset is amount if all pending subs are applied,
+    // upperbound is if all pending adds are applied
+    std::atomic<uint64_t> available_asset;
+    std::atomic<uint64_t> available_asset_upperbound;
+
+    ModificationState()
+        : nn_int64()
+        , size_increase(0)
+        , new_hashes(0)
+        , num_new_elts(0)
+        , new_hashes_state(HASHES_UNSIZED)
+        , hashset_clear_committed(false)
+        , max_committed_clear_threshold(0)
+        , available_asset(0)
+        , available_asset_upperbound(0)
+    {}
+
+    // Not threadsafe, called before the state is published
+    void reset(std::optional<StorageObject> const& committed_base)
+    {
+        nn_int64.clear();
+
+        size_increase.store(0, std::memory_order_relaxed);
+        num_new_elts.store(0, std::memory_order_relaxed);
+        hashset_clear_committed.store(false, std::memory_order_relaxed);
+        max_committed_clear_threshold.store(0, std::memory_order_relaxed);
+
+        available_asset.store(0, std::memory_order_relaxed);
+        available_asset_upperbound.store(0, std::memory_order_relaxed);
+
+        // O(1) (see AtomicSet).  Pooled states never hold a set
+        // bigger than START_HASH_SET_SIZE (see recycle())
+        new_hashes.clear();
+        new_hashes_state.store(HASHES_UNSIZED, std::memory_order_relaxed);
+
+        if (!committed_base) {
+            // type of a new key isn't fixed until the first committed delta
+            return;
+        }
+
+        switch (committed_base->body.type()) {
+            case ObjectType::HASH_SET:
+                new_hashes.resize(committed_base->body.hash_set().max_size);
+                new_hashes_state.store(HASHES_SIZED, std::memory_order_relaxed);
+                break;
+            case ObjectType::KNOWN_SUPPLY_ASSET:
+                available_asset.store(committed_base->body.asset().amount,
+                                      std::memory_order_relaxed);
+                available_asset_upperbound.store(
+                    committed_base->body.asset().amount,
+                    std::memory_order_relaxed);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Returns m to the pool.  reset() can't shrink the hash set, and
+    // committing walks all of its capacity, so a state whose set grew
+    // past START_HASH_SET_SIZE is freed instead.
+    static void recycle(ModificationState* m)
+    {
+        if (m->new_hashes.sized_within(START_HASH_SET_SIZE)) {
+            ObjectPool<ModificationState>::release(m);
+        } else {
+            delete m;
+        }
+    }
+
+    // Threadsafe.  Concurrent callers wait for the first to size the set.
+    void size_new_hashes_for_new_key()
+    {
+        uint32_t state = new_hashes_state.load(std::memory_order_acquire);
+        if (state == HASHES_SIZED) {
+            return;
+        }
+        if (state == HASHES_UNSIZED
+            && new_hashes_state.compare_exchange_strong(
+                state, HASHES_SIZING, std::memory_order_acquire)) {
+            new_hashes.resize(START_HASH_SET_SIZE);
+            new_hashes_state.store(HASHES_SIZED, std::memory_order_release);
+            return;
+        }
+        while (new_hashes_state.load(std::memory_order_acquire) != HASHES_SIZED) {
+            SPINLOCK_PAUSE();
+        }
+    }
+};
+
+RevertableObject::ModificationState&
+RevertableObject::get_mods()
+{
+    auto* m = mods.load(std::memory_order_acquire);
+    if (m != nullptr) {
+        return *m;
+    }
+
+    auto* candidate = ObjectPool<ModificationState>::acquire();
+    candidate->reset(committed_base);
+
+    if (mods.compare_exchange_strong(
+            m, candidate, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        return *candidate;
+    }
+    // lost the race, m is the winner
+    ModificationState::recycle(candidate);
+    return *m;
+}
+
 std::optional<RevertableObject::DeltaRewind>
 RevertableObject::try_add_delta(const StorageDelta& delta)
 {
@@ -300,33 +439,18 @@ RevertableObject::try_add_delta(const StorageDelta& delta)
                 return std::nullopt;
             }
 
+            auto& m = get_mods();
+
             int64_t d = delta.set_add_nonnegative_int64().delta;
             if (d < 0) {
-                while (true) {
-                    int64_t cur_value
-                        = total_subtracted.load(std::memory_order_relaxed);
-                    if (__builtin_add_overflow_p(
-                            cur_value, d, static_cast<int64_t>(0))) {
-                        return std::nullopt;
-                    }
-
-                    int64_t new_value = cur_value + d;
-                    int64_t base = delta.set_add_nonnegative_int64().set_value;
-
-                    if (base < 0 || base + new_value < 0) {
-                        return std::nullopt;
-                    }
-
-                    if (total_subtracted.compare_exchange_weak(
-                            cur_value, new_value, std::memory_order_relaxed)) {
-                        return DeltaRewind(std::move(*res), delta, this);
-                    }
+                if (!m.nn_int64.try_debit(
+                        delta.set_add_nonnegative_int64().set_value, d)) {
+                    return std::nullopt;
                 }
             } else {
-                total_added.add(d);
-                return DeltaRewind(std::move(*res), delta, this);
+                m.nn_int64.credit(d);
             }
-            throw std::runtime_error("assert unreachable");
+            return DeltaRewind(std::move(*res), delta, this);
         }
         case DeltaType::RAW_MEMORY_WRITE: {
             StorageDeltaClass obj;
@@ -351,8 +475,8 @@ RevertableObject::try_add_delta(const StorageDelta& delta)
                 return std::nullopt;
             }
 
-            size_increase.fetch_add(delta.limit_increase(),
-                                    std::memory_order_relaxed);
+            get_mods().size_increase.fetch_add(delta.limit_increase(),
+                                               std::memory_order_relaxed);
 
             return DeltaRewind(std::move(*res), delta, this);
         }
@@ -365,6 +489,8 @@ RevertableObject::try_add_delta(const StorageDelta& delta)
                 return std::nullopt;
             }
 
+            auto& m = get_mods();
+
             size_t cur_size = 0;
             size_t max_size = START_HASH_SET_SIZE;
 
@@ -372,25 +498,24 @@ RevertableObject::try_add_delta(const StorageDelta& delta)
                 cur_size = committed_base->body.hash_set().hashes.size();
                 max_size = committed_base->body.hash_set().max_size;
 
-                for (auto const& h : committed_base->body.hash_set().hashes) {
-                    // TODO these will be sorted (unless we pick a homomorphic
-                    // hash fn)? bin search might be faster
-                    if (h == delta.hash()) {
-                        return std::nullopt;
-                    }
+                // committed hashes are kept normalized (sorted)
+                if (hashset_contains(committed_base->body.hash_set(), delta.hash())) {
+                    return std::nullopt;
                 }
+            } else {
+                m.size_new_hashes_for_new_key();
             }
 
             cur_size
-                += num_new_elts.fetch_add(1, std::memory_order_relaxed) + 1;
+                += m.num_new_elts.fetch_add(1, std::memory_order_relaxed) + 1;
 
             if (cur_size > max_size) {
-                num_new_elts.fetch_sub(1, std::memory_order_relaxed);
+                m.num_new_elts.fetch_sub(1, std::memory_order_relaxed);
                 return std::nullopt;
             }
 
-            if (!new_hashes.try_insert(delta.hash())) {
-                num_new_elts.fetch_sub(1, std::memory_order_relaxed);
+            if (!m.new_hashes.try_insert(delta.hash())) {
+                m.num_new_elts.fetch_sub(1, std::memory_order_relaxed);
                 return std::nullopt;
             }
 
@@ -418,17 +543,19 @@ RevertableObject::try_add_delta(const StorageDelta& delta)
                 return std::nullopt;
             }
 
+            auto& m = get_mods();
+
             int64_t d = delta.asset_delta();
 
             if (d < 0)
             {
-                if (!try_add_uint64(d, available_asset))
+                if (!try_add_uint64(d, m.available_asset))
                 {
                     return std::nullopt;
                 }
             } else
             {
-                if (!try_add_uint64(d, available_asset_upperbound))
+                if (!try_add_uint64(d, m.available_asset_upperbound))
                 {
                     return std::nullopt;
                 }
@@ -473,15 +600,16 @@ RevertableObject::commit_delta(const StorageDelta& delta)
         }
         case DeltaType::HASH_SET_CLEAR:
         {
-            hashset_clear_committed.store(true, std::memory_order_relaxed);
+            auto& m = get_mods();
+            m.hashset_clear_committed.store(true, std::memory_order_relaxed);
             while(true)
             {
-                uint64_t cur_threshold = max_committed_clear_threshold.load(std::memory_order_relaxed);
+                uint64_t cur_threshold = m.max_committed_clear_threshold.load(std::memory_order_relaxed);
                 if (cur_threshold >= delta.threshold())
                 {
                     return;
                 }
-                if (max_committed_clear_threshold.compare_exchange_strong(
+                if (m.max_committed_clear_threshold.compare_exchange_strong(
                     cur_threshold, delta.threshold(), std::memory_order_relaxed))
                 {
                     return;
@@ -490,14 +618,15 @@ RevertableObject::commit_delta(const StorageDelta& delta)
         }
         case DeltaType::ASSET_OBJECT_ADD:
         {
+            auto& m = get_mods();
             int64_t const& d = delta.asset_delta();
 
             if (d < 0)
             {
-                available_asset_upperbound.fetch_add(d, std::memory_order_relaxed);
+                m.available_asset_upperbound.fetch_add(d, std::memory_order_relaxed);
             } else
             {
-                available_asset.fetch_add(d, std::memory_order_relaxed);
+                m.available_asset.fetch_add(d, std::memory_order_relaxed);
             }
             return;
         }
@@ -514,14 +643,14 @@ RevertableObject::revert_delta(const StorageDelta& delta)
             return;
         }
         case DeltaType::NONNEGATIVE_INT64_SET_ADD: {
+            auto& m = get_mods();
             int64_t d = delta.set_add_nonnegative_int64().delta;
             if (d < 0) {
-                total_subtracted.fetch_sub(d, std::memory_order_relaxed);
+                m.nn_int64.revert_debit(d);
                 return;
             }
 
-            // ok to implicitly cast pos int64 to uint64
-            total_added.sub(d);
+            m.nn_int64.revert_credit(d);
             return;
         }
         case DeltaType::RAW_MEMORY_WRITE: {
@@ -529,13 +658,14 @@ RevertableObject::revert_delta(const StorageDelta& delta)
             return;
         }
         case DeltaType::HASH_SET_INCREASE_LIMIT: {
-            size_increase.fetch_sub(delta.limit_increase(),
-                                    std::memory_order_relaxed);
+            get_mods().size_increase.fetch_sub(delta.limit_increase(),
+                                               std::memory_order_relaxed);
             return;
         }
         case DeltaType::HASH_SET_INSERT: {
-            num_new_elts.fetch_sub(1, std::memory_order_relaxed);
-            new_hashes.erase(delta.hash());
+            auto& m = get_mods();
+            m.num_new_elts.fetch_sub(1, std::memory_order_relaxed);
+            m.new_hashes.erase(delta.hash());
             return;
         }
         case DeltaType::HASH_SET_CLEAR:
@@ -545,14 +675,15 @@ RevertableObject::revert_delta(const StorageDelta& delta)
         }
         case DeltaType::ASSET_OBJECT_ADD:
         {
+            auto& m = get_mods();
             int64_t const& d = delta.asset_delta();
 
             if (d < 0)
             {
-                available_asset.fetch_sub(d, std::memory_order_relaxed);
+                m.available_asset.fetch_sub(d, std::memory_order_relaxed);
             } else
             {
-                available_asset_upperbound.fetch_sub(d, std::memory_order_relaxed);
+                m.available_asset_upperbound.fetch_sub(d, std::memory_order_relaxed);
             }
             return;
         }
@@ -647,28 +778,12 @@ RevertableBaseObject::rewind_round()
 void
 RevertableObject::clear_mods()
 {
-    total_subtracted.store(0, std::memory_order_relaxed);
-    total_added.clear();
-
-    size_increase.store(0, std::memory_order_relaxed);
-    new_hashes.clear();
-    num_new_elts.store(0, std::memory_order_relaxed);
-
-    hashset_clear_committed.store(false, std::memory_order_relaxed);
-    max_committed_clear_threshold.store(0, std::memory_order_relaxed);
+    auto* m = mods.exchange(nullptr, std::memory_order_relaxed);
+    if (m != nullptr) {
+        ModificationState::recycle(m);
+    }
 
     delete_last_committed.store(false, std::memory_order_relaxed);
-
-    if (committed_base.has_value() && (committed_base->body.type() == ObjectType::KNOWN_SUPPLY_ASSET))
-    {
-        available_asset.store(committed_base->body.asset().amount, std::memory_order_relaxed);
-        available_asset_upperbound.store(committed_base->body.asset().amount, std::memory_order_relaxed);
-    } 
-    else
-    {
-        available_asset.store(0, std::memory_order_relaxed);
-        available_asset_upperbound.store(0, std::memory_order_relaxed);
-    }
 }
 
 void
@@ -695,12 +810,21 @@ RevertableObject::commit_round()
         return;
     }
 
+    auto* m = mods.load(std::memory_order_relaxed);
+
+    if (m == nullptr) {
+        // no deltas that modify counters/sets were applied, so
+        // the committed object is whatever commit_round_and_reset() produced
+        clear_mods();
+        return;
+    }
+
     switch (committed_base->body.type()) {
         case ObjectType::NONNEGATIVE_INT64: {
-            int64_t sub = total_subtracted.load(std::memory_order_relaxed);
+            int64_t sub = m->nn_int64.fold_subtracted();
             committed_base->body.nonnegative_int64() += sub;
 
-            uint64_t add = total_added.fetch_cap();
+            uint64_t add = m->nn_int64.fold_added();
 
             if (__builtin_add_overflow_p(
                     committed_base->body.nonnegative_int64(),
@@ -716,19 +840,16 @@ RevertableObject::commit_round()
             // no op
             break;
         case ObjectType::HASH_SET: {
-	    uint64_t size_inc = size_increase.load(std::memory_order_relaxed);
+	    uint64_t size_inc = m->size_increase.load(std::memory_order_relaxed);
             uint64_t new_size = size_inc
                                 + committed_base->body.hash_set().max_size;
 
             committed_base->body.hash_set().max_size
                 = std::min((uint64_t)MAX_HASH_SET_SIZE, new_size);
 
-            auto new_hashes_list = new_hashes.get_hashes();
-
-	    if (size_inc >0)
-	    {
-		    new_hashes.resize(new_size);
-	    }
+            // next block's modification state is sized
+            // from the new max_size in ModificationState::reset()
+            auto new_hashes_list = m->new_hashes.get_hashes();
 
             auto& h_list = committed_base->body.hash_set().hashes;
 
@@ -738,9 +859,9 @@ RevertableObject::commit_round()
 
             normalize_hashset(committed_base -> body.hash_set());
 
-            if (hashset_clear_committed.load(std::memory_order_relaxed))
+            if (m->hashset_clear_committed.load(std::memory_order_relaxed))
             {
-                uint64_t threshold = max_committed_clear_threshold.load(std::memory_order_relaxed);
+                uint64_t threshold = m->max_committed_clear_threshold.load(std::memory_order_relaxed);
 
                 clear_hashset(committed_base -> body.hash_set(), threshold);
             }
@@ -749,10 +870,10 @@ RevertableObject::commit_round()
         }
         case ObjectType::KNOWN_SUPPLY_ASSET:
         {
-            committed_base -> body.asset().amount = available_asset.load(std::memory_order_relaxed);
+            committed_base -> body.asset().amount = m->available_asset.load(std::memory_order_relaxed);
 
             utils::print_assert(
-                committed_base -> body.asset().amount == available_asset_upperbound.load(std::memory_order_relaxed),
+                committed_base -> body.asset().amount == m->available_asset_upperbound.load(std::memory_order_relaxed),
                 "asset value vs. upperbound mismatch in commit");
         }
         break;
@@ -773,40 +894,31 @@ RevertableObject::rewind_round()
 
 RevertableObject::RevertableObject()
     : base_obj()
-    , total_subtracted(0)
-    , total_added()
-    , size_increase(0)
-    , new_hashes(START_HASH_SET_SIZE)
-    , num_new_elts(0)
-    , hashset_clear_committed(false)
-    , max_committed_clear_threshold(0)
+    , mods(nullptr)
     , delete_last_committed(false)
-    , available_asset(0)
-    , available_asset_upperbound(0)
     , committed_base(std::nullopt)
 {}
 
 RevertableObject::RevertableObject(const StorageObject& committed_base_)
     : base_obj(committed_base_)
-    , total_subtracted(0)
-    , total_added()
-    , size_increase(0)
-    , new_hashes(0)
-    , num_new_elts(0)
-    , hashset_clear_committed(false)
-    , max_committed_clear_threshold(0)
+    , mods(nullptr)
     , delete_last_committed(false)
-    , available_asset(0)
-    , available_asset_upperbound(0)
     , committed_base(committed_base_)
 {
     if (committed_base -> body.type() == ObjectType::HASH_SET) {
-        new_hashes.resize(committed_base->body.hash_set().max_size);
-    }
-    else if (committed_base -> body.type() == ObjectType::KNOWN_SUPPLY_ASSET) {
-        available_asset.store(committed_base -> body.asset().amount, std::memory_order_relaxed);
-        available_asset_upperbound.store(committed_base -> body.asset().amount, std::memory_order_relaxed);
+        // try_add_delta relies on this for duplicate detection.
+        // Anything produced by commit_round() is already normalized.
+        if (!is_normalized_hashset(committed_base->body.hash_set())) {
+            normalize_hashset(committed_base->body.hash_set());
+        }
     }
 }
 
+RevertableObject::~RevertableObject()
+{
+    // not returned to the pool: objects can be destroyed
+    // after threadlocal pool state (e.g. during static destruction)
+    delete mods.load(std::memory_order_relaxed);
+}
+
 } // namespace scs
@@ -23,12 +23,8 @@
 #include <optional>
 #include <type_traits>
 
-#include "hash_set/atomic_set.h"
-
 #include <utils/non_movable.h>
 
-#include "utils/atomic_uint128.h"
-
 #include "xdr/storage_delta.h"
 
 namespace scs {
@@ -110,35 +106,23 @@ class RevertableObject : public utils::NonMovableOrCopyable
 {
     RevertableBaseObject base_obj;
 
-    // for raw memory
-    // nothing
-
-    // for nn_int64
-
-    std::atomic<int64_t> total_subtracted;
-    AtomicUint128 total_added;
+    // Type-specific concurrent modification state
+    // (counters, new hashes, etc).
+    // Most objects in the db are not modified in a given block,
+    // so this is allocated (from a pool) on the first delta
+    // that needs it and returned to the pool in commit_round()/rewind_round().
+    struct ModificationState;
 
-    // for hash_set
-    std::atomic<uint64_t> size_increase;
-    AtomicSet new_hashes;
-    std::atomic<uint32_t> num_new_elts;
-
-    std::atomic<bool> hashset_clear_committed;
-    std::atomic<uint64_t> max_committed_clear_threshold;
+    std::atomic<ModificationState*> mods;
 
     // for delete_last
     std::atomic<bool> delete_last_committed;
 
-    // for asset obj
-    // ensure value >=0 and value <= UINT64_MAX
-    // asset is amount if all pending subs are applied,
-    // upperbound is if all pending adds are applied
-    std::atomic<uint64_t> available_asset;
-    std::atomic<uint64_t> available_asset_upperbound;
-
     // base object
     std::optional<StorageObject> committed_base;
 
+    ModificationState& get_mods();
+
   public:
     class DeltaRewind : public utils::NonCopyable
     {
@@ -168,6 +152,8 @@ class RevertableObject : public utils::NonMovableOrCopyable
     RevertableObject();
     RevertableObject(const StorageObject& committed_base_);
 
+    ~RevertableObject();
+
     // TODO make && on input
     std::optional<DeltaRewind> __attribute__((warn_unused_result))
     try_add_delta(const StorageDelta& delta);
@@ -0,0 +1,300 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "object/make_delta.h"
+#include "object/nonnegative_int64_accumulator.h"
+#include "object/revertable_object.h"
+
+#include "threadlocal/threadlocal_context.h"
+
+#include "xdr/storage_delta.h"
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace scs {
+
+namespace {
+
+template<typename F>
+void
+run_threads(uint32_t num_threads, F&& f)
+{
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < num_threads; t++) {
+        threads.emplace_back(f, t);
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+} // namespace
+
+TEST_CASE("nn int64 accumulator central", "[object]")
+{
+    NonnegativeInt64Accumulator acc;
+
+    SECTION("no deltas")
+    {
+        REQUIRE(acc.fold_subtracted() == 0);
+        REQUIRE(acc.fold_added() == 0);
+    }
+
+    SECTION("exact overdraft check")
+    {
+        REQUIRE(acc.try_debit(100, -60));
+        REQUIRE(!acc.try_debit(100, -41));
+        REQUIRE(acc.try_debit(100, -40));
+        REQUIRE(!acc.try_debit(100, -1));
+
+        acc.revert_debit(-40);
+        REQUIRE(acc.try_debit(100, -1));
+
+        REQUIRE(acc.fold_subtracted() == -61);
+    }
+
+    SECTION("credits don't fund debits")
+    {
+        acc.credit(1000);
+        REQUIRE(!acc.try_debit(10, -11));
+        REQUIRE(acc.try_debit(10, -10));
+
+        REQUIRE(acc.fold_added() == 1000);
+        REQUIRE(acc.fold_subtracted() == -10);
+    }
+
+    SECTION("extreme values")
+    {
+        REQUIRE(!acc.try_debit(-1, -1));
+        REQUIRE(!acc.try_debit(INT64_MAX, INT64_MIN));
+        REQUIRE(acc.try_debit(INT64_MAX, -INT64_MAX));
+
+        acc.credit(INT64_MAX);
+        acc.credit(INT64_MAX);
+        acc.credit(INT64_MAX);
+        REQUIRE(acc.fold_added() == UINT64_MAX);
+    }
+
+    SECTION("clear")
+    {
+        REQUIRE(acc.try_debit(100, -100));
+        acc.credit(5);
+        acc.clear();
+
+        REQUIRE(acc.fold_subtracted() == 0);
+        REQUIRE(acc.fold_added() == 0);
+        REQUIRE(acc.try_debit(50, -50));
+    }
+}
+
+TEST_CASE("nn int64 accumulator striped", "[object]")
+{
+    NonnegativeInt64Accumulator acc;
+
+    for (uint32_t i = 0; i < NN_INT64_HOT_THRESHOLD; i++) {
+        acc.credit(1);
+    }
+    REQUIRE(acc.is_striped());
+
+    SECTION("debits admitted exactly up to base")
+    {
+        constexpr int64_t base = 10'000;
+        constexpr uint32_t num_threads = 4;
+
+        std::atomic<int64_t> admitted = 0;
+
+        run_threads(num_threads, [&](uint32_t) {
+            int64_t local = 0;
+            // more attempts than budget; some threads run dry first,
+            // so this relies on draining other stripes
+            for (int64_t i = 0; i < base; i++) {
+                if (acc.try_debit(base, -1)) {
+                    local++;
+                }
+            }
+            admitted += local;
+        });
+
+        REQUIRE(admitted == base);
+        REQUIRE(!acc.try_debit(base, -1));
+        REQUIRE(acc.fold_subtracted() == -base);
+    }
+
+    SECTION("covered debits never fail")
+    {
+        // Debits sum to exactly base, so every one must be admitted.
+        // The large debit needs budget from every stripe, and the
+        // other threads refill their stripes while it drains them.
+        constexpr uint32_t num_threads = 8;
+        constexpr int64_t units_per_thread = 10'000;
+        constexpr int64_t large = 1'000'000;
+        constexpr int64_t base = large + num_threads * units_per_thread;
+
+        std::atomic<uint32_t> halfway = 0;
+        std::atomic<bool> go = false;
+        std::atomic<uint32_t> failures = 0;
+
+        run_threads(num_threads, [&](uint32_t t) {
+            for (int64_t i = 0; i < units_per_thread; i++) {
+                if (i == units_per_thread / 2) {
+                    halfway++;
+                    if (t == 0) {
+                        while (halfway != num_threads) {
+                            std::this_thread::yield();
+                        }
+                        go = true;
+                        failures += !acc.try_debit(base, -large);
+                    } else {
+                        while (!go) {
+                            std::this_thread::yield();
+                        }
+                    }
+                }
+                failures += !acc.try_debit(base, -1);
+            }
+        });
+
+        REQUIRE(failures == 0);
+        REQUIRE(!acc.try_debit(base, -1));
+        REQUIRE(acc.fold_subtracted() == -base);
+    }
+
+    SECTION("reverts on another thread")
+    {
+        REQUIRE(acc.try_debit(100, -70));
+        acc.credit(50);
+
+        bool debit_ok = false;
+        run_threads(1, [&](uint32_t) {
+            acc.revert_debit(-70);
+            acc.revert_credit(50);
+            debit_ok = acc.try_debit(100, -100);
+        });
+        REQUIRE(debit_ok);
+
+        REQUIRE(acc.fold_subtracted() == -100);
+        REQUIRE(acc.fold_added() == NN_INT64_HOT_THRESHOLD);
+    }
+}
+
+namespace {
+
+/**
+ * Payments between num_accounts accounts, where
+ * half of all payments go to account 0.
+ * Checks that money is conserved and no balance goes negative.
+ */
+void
+run_skewed_payments(uint32_t num_threads,
+                    uint32_t num_accounts,
+                    uint32_t payments_per_thread)
+{
+    test::DeferredContextClear defer;
+
+    constexpr int64_t start_balance = 1'000;
+
+    std::vector<std::unique_ptr<RevertableObject>> accounts;
+    for (uint32_t i = 0; i < num_accounts; i++) {
+        StorageObject o;
+        o.body.type(ObjectType::NONNEGATIVE_INT64);
+        o.body.nonnegative_int64() = start_balance;
+        accounts.emplace_back(std::make_unique<RevertableObject>(o));
+    }
+
+    auto balance = [&](uint32_t i) -> int64_t {
+        return accounts[i]->get_committed_object()->body.nonnegative_int64();
+    };
+
+    std::atomic<uint64_t> successes = 0;
+
+    auto payer = [&](uint32_t t) {
+        std::minstd_rand gen(t);
+        std::uniform_int_distribution<uint32_t> account_dist(0, num_accounts - 1);
+        std::uniform_int_distribution<int64_t> amount_dist(1, 100);
+
+        uint64_t local_successes = 0;
+
+        for (uint32_t i = 0; i < payments_per_thread; i++) {
+            uint32_t from = account_dist(gen);
+            uint32_t to = (gen() & 1) ? 0 : account_dist(gen);
+            if (from == to) {
+                continue;
+            }
+            int64_t amount = amount_dist(gen);
+
+            auto debit = accounts[from]->try_add_delta(
+                make_nonnegative_int64_set_add(balance(from), -amount));
+            if (!debit) {
+                continue;
+            }
+            auto credit = accounts[to]->try_add_delta(
+                make_nonnegative_int64_set_add(balance(to), amount));
+            if (!credit) {
+                continue;
+            }
+            debit->commit();
+            credit->commit();
+            local_successes++;
+        }
+        successes += local_successes;
+    };
+
+    auto ts = std::chrono::steady_clock::now();
+    run_threads(num_threads, payer);
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - ts)
+                       .count();
+
+    uint64_t attempts = static_cast<uint64_t>(num_threads) * payments_per_thread;
+    std::printf("skewed payments: %" PRIu32 " threads, %" PRIu64
+                " attempts (%" PRIu64 " ok) in %.3f ms (%.1f ns/payment)\n",
+                num_threads,
+                attempts,
+                successes.load(),
+                elapsed / 1'000'000.0,
+                static_cast<double>(elapsed) / attempts);
+
+    int64_t total = 0;
+    for (uint32_t i = 0; i < num_accounts; i++) {
+        accounts[i]->commit_round();
+        REQUIRE(balance(i) >= 0);
+        total += balance(i);
+    }
+    REQUIRE(total == start_balance * num_accounts);
+    REQUIRE(successes > 0);
+}
+
+} // namespace
+
+TEST_CASE("skewed payments", "[object]")
+{
+    run_skewed_payments(4, 1'000, 20'000);
+}
+
+TEST_CASE("skewed payments 96 threads", "[.][object][bench]")
+{
+    run_skewed_payments(96, 100'000, 100'000);
+}
+
+} // namespace scs
@@ -504,6 +504,46 @@ TEST_CASE("hashset from nonempty", "[object]")
     }
 }
 
+TEST_CASE("hashset duplicate check against large committed set", "[object]")
+{
+    test::DeferredContextClear defer;
+
+    StorageObject base_obj;
+    base_obj.body.type(ObjectType::HASH_SET);
+    base_obj.body.hash_set().max_size = MAX_HASH_SET_SIZE;
+
+    // deliberately not normalized
+    for (uint64_t i = 0; i < 1000; i++) {
+        base_obj.body.hash_set().hashes.push_back(
+            HashSetEntry(hash_xdr<uint64_t>(i), i % 10));
+    }
+
+    RevertableObject object(base_obj);
+
+    auto make_insert = [](uint64_t i, uint64_t threshold) {
+        return make_hash_set_insert(hash_xdr<uint64_t>(i), threshold);
+    };
+
+    for (uint64_t i = 0; i < 1000; i++) {
+        REQUIRE(!object.try_add_delta(make_insert(i, i % 10)));
+    }
+
+    // same hash, different index is a different entry
+    auto res = object.try_add_delta(make_insert(5, 6));
+    REQUIRE(!!res);
+    res->commit();
+
+    res = object.try_add_delta(make_insert(1000, 0));
+    REQUIRE(!!res);
+    res->commit();
+
+    object.commit_round();
+
+    REQUIRE(!object.try_add_delta(make_insert(5, 6)));
+    REQUIRE(!object.try_add_delta(make_insert(1000, 0)));
+    REQUIRE(object.get_committed_object()->body.hash_set().hashes.size() == 1002);
+}
+
 TEST_CASE("hashset from nonempty with thresholds", "[object]")
 {
     test::DeferredContextClear defer;
@@ -0,0 +1,528 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "persistence/async_io.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <set>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace scs
+{
+
+AlignedBuffer::AlignedBuffer(AlignedBuffer&& other)
+    : buf(other.buf)
+    , capacity(other.capacity)
+    , len(other.len)
+{
+    other.buf = nullptr;
+    other.capacity = 0;
+    other.len = 0;
+}
+
+AlignedBuffer&
+AlignedBuffer::operator=(AlignedBuffer&& other)
+{
+    if (this != &other) {
+        std::free(buf);
+        buf = other.buf;
+        capacity = other.capacity;
+        len = other.len;
+        other.buf = nullptr;
+        other.capacity = 0;
+        other.len = 0;
+    }
+    return *this;
+}
+
+AlignedBuffer::~AlignedBuffer()
+{
+    std::free(buf);
+}
+
+void
+AlignedBuffer::reserve(size_t bytes)
+{
+    bytes = round_up_to_alignment(bytes);
+    if (bytes <= capacity) {
+        return;
+    }
+    size_t new_capacity = std::max(bytes, 2 * capacity);
+    void* new_buf = nullptr;
+    if (posix_memalign(&new_buf, DIRECT_IO_ALIGNMENT, new_capacity) != 0) {
+        throw std::bad_alloc();
+    }
+    if (len > 0) {
+        std::memcpy(new_buf, buf, len);
+    }
+    std::free(buf);
+    buf = static_cast<uint8_t*>(new_buf);
+    capacity = new_capacity;
+}
+
+void
+AlignedBuffer::resize(size_t bytes)
+{
+    reserve(bytes);
+    len = bytes;
+}
+
+void
+AlignedBuffer::pad()
+{
+    if (padded_size() > len) {
+        std::memset(buf + len, 0, padded_size() - len);
+    }
+}
+
+namespace
+{
+
+int
+sys_io_uring_setup(uint32_t entries, io_uring_params* p)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int
+sys_io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+    return static_cast<int>(
+        ::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+uint32_t
+load_acquire(uint32_t* p)
+{
+    return std::atomic_ref<uint32_t>(*p).load(std::memory_order_acquire);
+}
+
+void
+store_release(uint32_t* p, uint32_t v)
+{
+    std::atomic_ref<uint32_t>(*p).store(v, std::memory_order_release);
+}
+
+std::vector<IORequest>
+split_requests(std::vector<IORequest> const& reqs)
+{
+    std::vector<IORequest> out;
+    for (auto const& r : reqs) {
+        for (size_t done = 0; done < r.len; done += ASYNC_IO_CHUNK_BYTES) {
+            out.push_back(IORequest{
+                .fd = r.fd,
+                .buf = r.buf + done,
+                .len = std::min<size_t>(ASYNC_IO_CHUNK_BYTES, r.len - done),
+                .offset = r.offset + done });
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+struct AsyncIO::Ring
+{
+    int fd = -1;
+
+    void* sq_ptr = nullptr;
+    size_t sq_bytes = 0;
+    void* cq_ptr = nullptr;
+    size_t cq_bytes = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_bytes = 0;
+
+    uint32_t* sq_head;
+    uint32_t* sq_tail;
+    uint32_t sq_mask;
+    uint32_t* sq_array;
+    uint32_t sq_entries;
+
+    uint32_t* cq_head;
+    uint32_t* cq_tail;
+    uint32_t cq_mask;
+    io_uring_cqe* cqes;
+
+    // nullptr if io_uring is unavailable
+    // (old kernel, or disabled by seccomp/sysctl)
+    static std::unique_ptr<Ring> make(uint32_t queue_depth);
+
+    ~Ring()
+    {
+        if (sqes) {
+            ::munmap(sqes, sqes_bytes);
+        }
+        if (cq_ptr && cq_ptr != sq_ptr) {
+            ::munmap(cq_ptr, cq_bytes);
+        }
+        if (sq_ptr) {
+            ::munmap(sq_ptr, sq_bytes);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+};
+
+std::unique_ptr<AsyncIO::Ring>
+AsyncIO::Ring::make(uint32_t queue_depth)
+{
+    if (queue_depth == 0) {
+        return nullptr;
+    }
+
+    io_uring_params p;
+    std::memset(&p, 0, sizeof(p));
+
+    auto ring = std::make_unique<Ring>();
+    ring->fd = sys_io_uring_setup(queue_depth, &p);
+    if (ring->fd < 0) {
+        return nullptr;
+    }
+    // IORING_OP_READ/WRITE arrived alongside this feature (5.6)
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+        return nullptr;
+    }
+
+    ring->sq_bytes = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    ring->cq_bytes = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        ring->sq_bytes = ring->cq_bytes = std::max(ring->sq_bytes, ring->cq_bytes);
+    }
+
+    void* sq_ptr = ::mmap(nullptr, ring->sq_bytes, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) {
+        return nullptr;
+    }
+    ring->sq_ptr = sq_ptr;
+
+    if (single_mmap) {
+        ring->cq_ptr = sq_ptr;
+    } else {
+        void* cq_ptr = ::mmap(nullptr, ring->cq_bytes, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) {
+            return nullptr;
+        }
+        ring->cq_ptr = cq_ptr;
+    }
+
+    ring->sqes_bytes = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, ring->sqes_bytes, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return nullptr;
+    }
+    ring->sqes = static_cast<io_uring_sqe*>(sqes);
+
+    auto* sq = static_cast<uint8_t*>(ring->sq_ptr);
+    ring->sq_head = reinterpret_cast<uint32_t*>(sq + p.sq_off.head);
+    ring->sq_tail = reinterpret_cast<uint32_t*>(sq + p.sq_off.tail);
+    ring->sq_mask = *reinterpret_cast<uint32_t*>(sq + p.sq_off.ring_mask);
+    ring->sq_array = reinterpret_cast<uint32_t*>(sq + p.sq_off.array);
+    ring->sq_entries = p.sq_entries;
+
+    auto* cq = static_cast<uint8_t*>(ring->cq_ptr);
+    ring->cq_head = reinterpret_cast<uint32_t*>(cq + p.cq_off.head);
+    ring->cq_tail = reinterpret_cast<uint32_t*>(cq + p.cq_off.tail);
+    ring->cq_mask = *reinterpret_cast<uint32_t*>(cq + p.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+    return ring;
+}
+
+AsyncIO::AsyncIO(uint32_t queue_depth)
+    : ring(Ring::make(queue_depth))
+{}
+
+AsyncIO::~AsyncIO() {}
+
+void
+AsyncIO::run_batch(std::vector<IORequest> const& reqs, bool is_write)
+{
+    auto work = split_requests(reqs);
+
+    if (!ring) {
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, work.size(), 1),
+            [&](auto r) {
+                for (size_t i = r.begin(); i < r.end(); i++) {
+                    auto req = work[i];
+                    while (req.len > 0) {
+                        ssize_t res = is_write
+                            ? ::pwrite(req.fd, req.buf, req.len, req.offset)
+                            : ::pread(req.fd, req.buf, req.len, req.offset);
+                        if (res < 0 && errno == EINTR) {
+                            continue;
+                        }
+                        if (res < 0
+                            || (is_write && static_cast<size_t>(res) < req.len)) {
+                            throw std::runtime_error("file io failed");
+                        }
+                        if (res == 0) {
+                            // eof
+                            break;
+                        }
+                        req.buf += res;
+                        req.len -= res;
+                        req.offset += res;
+                    }
+                }
+            });
+        return;
+    }
+
+    std::vector<size_t> todo;
+    for (size_t i = work.size(); i > 0; i--) {
+        todo.push_back(i - 1);
+    }
+    uint32_t in_flight = 0;
+    // on error, stop submitting but wait out what's in flight
+    // (the kernel still holds pointers into the caller's buffers)
+    bool failed = false;
+
+    while (!todo.empty() || in_flight > 0) {
+        uint32_t tail = *ring->sq_tail;
+        while (!todo.empty() && in_flight < ring->sq_entries) {
+            size_t idx = todo.back();
+            todo.pop_back();
+            auto const& req = work[idx];
+
+            uint32_t slot = tail & ring->sq_mask;
+            io_uring_sqe& sqe = ring->sqes[slot];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = is_write ? IORING_OP_WRITE : IORING_OP_READ;
+            sqe.fd = req.fd;
+            sqe.addr = reinterpret_cast<uint64_t>(req.buf);
+            sqe.len = static_cast<uint32_t>(req.len);
+            sqe.off = req.offset;
+            sqe.user_data = idx;
+            ring->sq_array[slot] = slot;
+            tail++;
+            in_flight++;
+        }
+        store_release(ring->sq_tail, tail);
+
+        // includes anything a previous interrupted enter didn't consume
+        uint32_t to_submit = tail - load_acquire(ring->sq_head);
+        int res = sys_io_uring_enter(ring->fd, to_submit, 1, IORING_ENTER_GETEVENTS);
+        if (res < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            // nothing more will complete
+            throw std::runtime_error("io_uring_enter failed");
+        }
+
+        uint32_t head = *ring->cq_head;
+        uint32_t cq_tail = load_acquire(ring->cq_tail);
+        for (; head != cq_tail; head++) {
+            io_uring_cqe const& cqe = ring->cqes[head & ring->cq_mask];
+            size_t idx = cqe.user_data;
+            int32_t n = cqe.res;
+            in_flight--;
+
+            auto& req = work[idx];
+            if (n == -EINTR || n == -EAGAIN) {
+                todo.push_back(idx);
+            } else if (n < 0 || (is_write && static_cast<size_t>(n) < req.len)) {
+                // resuming a short write would misalign an O_DIRECT fd
+                failed = true;
+            } else if (n > 0 && static_cast<size_t>(n) < req.len) {
+                req.buf += n;
+                req.len -= n;
+                req.offset += n;
+                todo.push_back(idx);
+            }
+            // n == 0 on a read is eof
+        }
+        store_release(ring->cq_head, head);
+
+        if (failed) {
+            todo.clear();
+        }
+    }
+
+    if (failed) {
+        throw std::runtime_error("file io failed");
+    }
+}
+
+void
+AsyncIO::write_all(std::vector<IORequest> const& reqs)
+{
+    run_batch(reqs, true);
+}
+
+void
+AsyncIO::read_all(std::vector<IORequest> const& reqs)
+{
+    run_batch(reqs, false);
+}
+
+int
+open_direct(const char* filename, int flags, mode_t mode)
+{
+    int fd = ::open(filename, flags | O_DIRECT, mode);
+    if (fd < 0 && errno == EINVAL) {
+        // e.g. tmpfs
+        fd = ::open(filename, flags, mode);
+    }
+    return fd;
+}
+
+namespace
+{
+
+void
+sync_directory(std::filesystem::path const& dir)
+{
+    int dfd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dfd < 0) {
+        throw std::runtime_error("failed to open directory");
+    }
+    int res = ::fsync(dfd);
+    ::close(dfd);
+    if (res != 0) {
+        throw std::runtime_error("failed to persist directory");
+    }
+}
+
+} // namespace
+
+void
+write_files_durable(AsyncIO& io, std::vector<FileWrite>& files)
+{
+    // stay well clear of the open file limit
+    constexpr size_t FILES_PER_BATCH = 256;
+
+    for (size_t begin = 0; begin < files.size(); begin += FILES_PER_BATCH) {
+        size_t end = std::min(files.size(), begin + FILES_PER_BATCH);
+
+        std::vector<int> fds;
+        std::vector<IORequest> reqs;
+        for (size_t i = begin; i < end; i++) {
+            int fd = open_direct(files[i].filename.c_str(),
+                                 O_WRONLY | O_CREAT | O_TRUNC);
+            if (fd < 0) {
+                for (int f : fds) {
+                    ::close(f);
+                }
+                throw std::runtime_error("failed to open file for writing");
+            }
+            fds.push_back(fd);
+
+            auto& contents = files[i].contents;
+            if (contents.size() > 0) {
+                contents.pad();
+                reqs.push_back(IORequest{ .fd = fd,
+                                          .buf = contents.data(),
+                                          .len = contents.padded_size(),
+                                          .offset = 0 });
+            }
+        }
+
+        try {
+            io.write_all(reqs);
+        } catch (...) {
+            for (int f : fds) {
+                ::close(f);
+            }
+            throw;
+        }
+
+        std::atomic<bool> ok = true;
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, fds.size(), 1),
+            [&](auto r) {
+                for (size_t i = r.begin(); i < r.end(); i++) {
+                    auto const& contents = files[begin + i].contents;
+                    int fd = fds[i];
+                    // drop the alignment padding
+                    if (contents.padded_size() != contents.size()
+                        && ::ftruncate(fd, contents.size()) != 0) {
+                        ok = false;
+                    }
+                    if (::fdatasync(fd) != 0) {
+                        ok = false;
+                    }
+                    ::close(fd);
+                }
+            });
+        if (!ok) {
+            throw std::runtime_error("failed to persist file");
+        }
+    }
+
+    // the files' directory entries (they may have just been created)
+    std::set<std::filesystem::path> dirs;
+    for (auto const& file : files) {
+        dirs.insert(std::filesystem::path(file.filename).parent_path());
+    }
+    for (auto const& dir : dirs) {
+        sync_directory(dir);
+    }
+}
+
+bool
+read_file(AsyncIO& io, const char* filename, AlignedBuffer& buffer)
+{
+    int fd = open_direct(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("fstat failed");
+    }
+
+    buffer.resize(st.st_size);
+    std::vector<IORequest> reqs;
+    if (buffer.size() > 0) {
+        // O_DIRECT reads whole blocks; the last one stops at eof
+        reqs.push_back(IORequest{ .fd = fd,
+                                  .buf = buffer.data(),
+                                  .len = buffer.padded_size(),
+                                  .offset = 0 });
+    }
+
+    try {
+        io.read_all(reqs);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    return true;
+}
+
+} // namespace scs
@@ -0,0 +1,154 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config/static_constants.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace scs
+{
+
+/**
+ * Batched file I/O for the persistence workers.
+ *
+ * A batch of reads or writes is submitted at once, and
+ * the call returns when every request has completed.
+ * Requests longer than ASYNC_IO_CHUNK_BYTES are split,
+ * so one large buffer is still written in parallel.
+ *
+ * Uses io_uring when the kernel allows it, and otherwise
+ * falls back to pread/pwrite on tbb worker threads.
+ *
+ * Files opened with open_direct() bypass the page cache
+ * (when the filesystem supports O_DIRECT).  Buffers, lengths
+ * and offsets of requests on such files must be multiples of
+ * DIRECT_IO_ALIGNMENT -- AlignedBuffer takes care of the first two.
+ *
+ * One instance per thread (the ring is not threadsafe).
+ */
+
+constexpr static size_t DIRECT_IO_ALIGNMENT = 4096;
+
+constexpr inline uint64_t
+round_up_to_alignment(uint64_t len)
+{
+    return (len + DIRECT_IO_ALIGNMENT - 1) & ~(DIRECT_IO_ALIGNMENT - 1);
+}
+
+/**
+ * Growable byte buffer, aligned for O_DIRECT.
+ * Bytes past size() (up to the next alignment boundary)
+ * are zeroed by pad().
+ */
+class AlignedBuffer
+{
+    uint8_t* buf = nullptr;
+    size_t capacity = 0;
+    size_t len = 0;
+
+  public:
+    AlignedBuffer() = default;
+    AlignedBuffer(AlignedBuffer&& other);
+    AlignedBuffer& operator=(AlignedBuffer&& other);
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    ~AlignedBuffer();
+
+    // keeps contents
+    void reserve(size_t bytes);
+    void resize(size_t bytes);
+    void clear() { len = 0; }
+
+    // zeroes the bytes between size() and padded_size()
+    void pad();
+
+    uint8_t* data() { return buf; }
+    const uint8_t* data() const { return buf; }
+    size_t size() const { return len; }
+    size_t padded_size() const { return round_up_to_alignment(len); }
+};
+
+struct IORequest
+{
+    int fd;
+    uint8_t* buf;
+    size_t len;
+    uint64_t offset;
+};
+
+class AsyncIO
+{
+    struct Ring;
+    std::unique_ptr<Ring> ring;
+
+    void run_batch(std::vector<IORequest> const& reqs, bool is_write);
+
+  public:
+    // queue_depth = 0 forces the thread pool fallback
+    AsyncIO(uint32_t queue_depth = ASYNC_IO_QUEUE_DEPTH);
+    ~AsyncIO();
+
+    AsyncIO(const AsyncIO&) = delete;
+    AsyncIO& operator=(const AsyncIO&) = delete;
+
+    bool using_io_uring() const { return ring != nullptr; }
+
+    // Throws on error, including a short write (resuming one
+    // would break O_DIRECT alignment).
+    void write_all(std::vector<IORequest> const& reqs);
+
+    // Throws on error.  A read stops early at the end of its file.
+    void read_all(std::vector<IORequest> const& reqs);
+};
+
+/**
+ * open(2), adding O_DIRECT if the filesystem supports it.
+ * Returns -1 on failure.
+ */
+int
+open_direct(const char* filename, int flags, mode_t mode = 0644);
+
+struct FileWrite
+{
+    std::string filename;
+    AlignedBuffer contents;
+};
+
+/**
+ * Creates (or truncates) each file and writes its contents,
+ * all files in parallel.  Every file, and its directory entry,
+ * is durable on return.
+ */
+void
+write_files_durable(AsyncIO& io, std::vector<FileWrite>& files);
+
+/**
+ * Reads the whole of filename into buffer.
+ * Returns false if the file cannot be opened.
+ */
+bool
+read_file(AsyncIO& io, const char* filename, AlignedBuffer& buffer);
+
+} // namespace scs
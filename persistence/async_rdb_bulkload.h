@@ -1,84 +1,127 @@
-#pragma once
-
-#include <utils/async_worker.h>
-
-#include <mutex>
-#include <condition_variable>
-
-#include "utils/save_load_xdr.h"
-
-#include <utils/mkdir.h>
-
-#include "config/static_constants.h"
-
-#include "persistence/accumulate_kvs_iface.h"
-
-#include "persistence/rocksdb_wrapper.h"
-
-namespace scs {
-
-class AsyncRDBBulkLoad : public utils::AsyncWorker
-{
-
-    using pair_t = std::pair<trie::TimestampPointerPair, trie::DurableValue<sizeof(AddressAndKey)>>;
-
-    std::array<std::vector<pair_t>, TLCACHE_SIZE> work_item;
-    bool work_done = true;
-    uint32_t work_ts = 0;
-
-    RocksdbWrapper& rdb;
-
-    bool exists_work_to_do() override final { return !work_done; }
-
-    void run()
-    {
-        while (true) {
-            std::unique_lock lock(mtx);
-
-            if ((!done_flag) && (!exists_work_to_do())) {
-                cv.wait(lock,
-                        [this]() { return done_flag || exists_work_to_do(); });
-            }
-            if (done_flag) {
-                return;
-            }
-
-            throw std::runtime_error("unimpl");
-
-            //TODO
-
-		    work_done = true;
-            cv.notify_all();
-        }
-    }
-
-  public:
-    AsyncRDBBulkLoad(RocksdbWrapper& rdb)
-        : utils::AsyncWorker()
-        , work_item()
-        , rdb(rdb)
-    {
-        start_async_thread([this] { run(); });
-    }
-
-    ~AsyncRDBBulkLoad() { terminate_worker(); }
-
-    void log_keys(AccumulateKVsInterface<sizeof(AddressAndKey), TLCACHE_SIZE>& storage_iface, uint32_t timestamp)
-    {
-        std::lock_guard lock(mtx);
-        storage_iface.swap_buffers(work_item);
-        work_done = false;
-        work_ts = timestamp;
-        cv.notify_all();
-    }
-
-    void log_keys(DirectWriteRocksDBIface<sizeof(AddressAndKey)> const& rdb, uint32_t timestamp)
-    {}
-
-    void log_keys(trie::NullInterface<sizeof(AddressAndKey)>& iface, uint32_t timestamp)
-    {}
-
-    using AsyncWorker::wait_for_async_task;
-};
-
-} // namespace scs
+#pragma once
+
+#include <utils/async_worker.h>
+
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+
+#include "utils/save_load_xdr.h"
+
+#include <utils/mkdir.h>
+
+#include "config/static_constants.h"
+
+#include "persistence/accumulate_kvs_iface.h"
+
+#include "persistence/rdb_bulk_load.h"
+#include "persistence/rocksdb_wrapper.h"
+
+namespace scs {
+
+/**
+ * Moves each block's values (accumulated per thread by
+ * AccumulateKVsInterface) into rocksdb in the background,
+ * as one bulk load of SST files (see rdb_bulk_load()).
+ */
+class AsyncRDBBulkLoad : public utils::AsyncWorker
+{
+
+    using pair_t = std::pair<trie::TimestampPointerPair, trie::DurableValue<sizeof(AddressAndKey)>>;
+
+    std::array<std::vector<pair_t>, TLCACHE_SIZE> work_item;
+    bool work_done = true;
+    uint32_t work_ts = 0;
+
+    RocksdbWrapper& rdb;
+    const std::string staging_dir;
+
+    std::optional<uint32_t> last_durable_timestamp;
+
+    bool exists_work_to_do() override final { return !work_done; }
+
+    void run()
+    {
+        while (true) {
+            std::unique_lock lock(mtx);
+
+            if ((!done_flag) && (!exists_work_to_do())) {
+                cv.wait(lock,
+                        [this]() { return done_flag || exists_work_to_do(); });
+            }
+            if (done_flag) {
+                return;
+            }
+
+            lock.unlock();
+
+            std::vector<rdb_kv_t> kvs;
+            for (auto const& buf : work_item) {
+                for (auto const& [key, value] : buf) {
+                    auto const& value_buf = value.get_buffer();
+                    kvs.emplace_back(
+                        rocksdb::Slice(reinterpret_cast<const char*>(&key),
+                                       sizeof(trie::TimestampPointerPair)),
+                        rocksdb::Slice(reinterpret_cast<const char*>(value_buf.data()),
+                                       value_buf.size()));
+                }
+            }
+
+            rdb_bulk_load(rdb, kvs, staging_dir, work_ts);
+
+            for (auto& buf : work_item) {
+                buf.clear();
+            }
+
+            lock.lock();
+            last_durable_timestamp = work_ts;
+            work_done = true;
+            cv.notify_all();
+        }
+    }
+
+  public:
+    AsyncRDBBulkLoad(RocksdbWrapper& rdb,
+                     std::string staging_dir = "rdb_sst_staging/")
+        : utils::AsyncWorker()
+        , work_item()
+        , rdb(rdb)
+        , staging_dir(staging_dir)
+    {
+        utils::mkdir_safe(staging_dir);
+        start_async_thread([this] { run(); });
+    }
+
+    ~AsyncRDBBulkLoad() { terminate_worker(); }
+
+    void log_keys(AccumulateKVsInterface<sizeof(AddressAndKey), TLCACHE_SIZE>& storage_iface, uint32_t timestamp)
+    {
+        std::unique_lock lock(mtx);
+        // the worker reads work_item until it's done
+        cv.wait(lock, [this]() { return work_done; });
+        storage_iface.swap_buffers(work_item);
+        work_done = false;
+        work_ts = timestamp;
+        cv.notify_all();
+    }
+
+    void log_keys(DirectWriteRocksDBIface<sizeof(AddressAndKey)> const& rdb, uint32_t timestamp)
+    {}
+
+    void log_keys(trie::NullInterface<sizeof(AddressAndKey)>& iface, uint32_t timestamp)
+    {}
+
+    // Every block before the returned timestamp is in rocksdb.
+    uint32_t get_durable_bound()
+    {
+        std::lock_guard lock(mtx);
+        if (!last_durable_timestamp) {
+            return 0;
+        }
+        return *last_durable_timestamp + 1;
+    }
+
+    using AsyncWorker::wait_for_async_task;
+};
+
+} // namespace scs
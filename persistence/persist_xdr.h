@@ -31,6 +31,7 @@ class AsyncPersistXDR : public utils::AsyncWorker
     }
 
     xdr_type work_item;
+    AsyncIO io;
     bool work_done = true;
     uint32_t work_ts = 0;
 
@@ -51,7 +52,7 @@ class AsyncPersistXDR : public utils::AsyncWorker
 
             std::string filename = get_filename(work_ts);
 
-            if (save_xdr_to_file(work_item, filename.c_str()) != 0)
+            if (save_xdr_to_file_fast(work_item, filename.c_str(), io) != 0)
             {
                 throw std::runtime_error("file save failed");
             }
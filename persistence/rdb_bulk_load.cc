@@ -0,0 +1,144 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "persistence/rdb_bulk_load.h"
+
+#include "config/static_constants.h"
+
+#include "rocksdb/sst_file_writer.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
+
+#include <utils/mkdir.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
+#include <stdexcept>
+
+namespace scs
+{
+
+namespace
+{
+
+std::vector<size_t>
+split_runs(std::vector<rdb_kv_t> const& sorted)
+{
+    const size_t n = sorted.size();
+    const size_t num_files = std::clamp<size_t>(
+        n / RDB_BULK_LOAD_MIN_FILE_ENTRIES, 1, RDB_BULK_LOAD_MAX_FILES);
+
+    std::vector<size_t> starts = { 0 };
+    for (size_t i = 1; i < num_files; i++) {
+        size_t split = std::max(starts.back(), (n * i) / num_files);
+        // equal keys stay in one file
+        while (split > 0 && split < n
+               && sorted[split].first == sorted[split - 1].first) {
+            split++;
+        }
+        if (split > starts.back() && split < n) {
+            starts.push_back(split);
+        }
+    }
+    starts.push_back(n);
+    return starts;
+}
+
+void
+write_sst(RocksdbWrapper const& rdb,
+          std::string const& filename,
+          std::vector<rdb_kv_t> const& sorted,
+          size_t start,
+          size_t end)
+{
+    rocksdb::SstFileWriter writer(rocksdb::EnvOptions(), rdb.get_options());
+
+    if (!writer.Open(filename).ok()) {
+        throw std::runtime_error("failed to open sst file");
+    }
+    for (size_t i = start; i < end; i++) {
+        // last occurrence of a key wins
+        if (i + 1 < end && sorted[i + 1].first == sorted[i].first) {
+            continue;
+        }
+        if (!writer.Put(sorted[i].first, sorted[i].second).ok()) {
+            throw std::runtime_error("failed to write sst entry");
+        }
+    }
+    if (!writer.Finish().ok()) {
+        throw std::runtime_error("failed to finish sst file");
+    }
+}
+
+} // namespace
+
+void
+rdb_bulk_load(RocksdbWrapper& rdb,
+              std::vector<rdb_kv_t>& kvs,
+              std::string const& staging_dir,
+              uint64_t batch_id)
+{
+    if (kvs.empty()) {
+        return;
+    }
+
+    // parallel_sort isn't stable, so ties are broken by position
+    std::vector<uint32_t> order(kvs.size());
+    std::iota(order.begin(), order.end(), 0);
+    tbb::parallel_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        int res = kvs[a].first.compare(kvs[b].first);
+        return res < 0 || (res == 0 && a < b);
+    });
+
+    std::vector<rdb_kv_t> sorted(kvs.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, order.size()),
+                      [&](auto r) {
+                          for (size_t i = r.begin(); i < r.end(); i++) {
+                              sorted[i] = kvs[order[i]];
+                          }
+                      });
+    kvs = std::move(sorted);
+
+    auto starts = split_runs(kvs);
+    const size_t num_files = starts.size() - 1;
+
+    utils::mkdir_safe(staging_dir);
+    std::vector<std::string> filenames(num_files);
+    for (size_t i = 0; i < num_files; i++) {
+        filenames[i] = staging_dir + "bulk_" + std::to_string(batch_id) + "_"
+                       + std::to_string(i) + ".sst";
+    }
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, num_files, 1),
+                      [&](auto r) {
+                          for (size_t i = r.begin(); i < r.end(); i++) {
+                              write_sst(rdb, filenames[i], kvs, starts[i], starts[i + 1]);
+                          }
+                      });
+
+    rdb.ingest(filenames);
+
+    // left behind if rocksdb copied rather than moved them
+    for (auto const& filename : filenames) {
+        std::error_code ec;
+        std::filesystem::remove(filename, ec);
+    }
+}
+
+} // namespace scs
@@ -0,0 +1,49 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "persistence/rocksdb_wrapper.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace scs
+{
+
+// key, value (both borrowed; must outlive the load)
+using rdb_kv_t = std::pair<rocksdb::Slice, rocksdb::Slice>;
+
+/**
+ * Adds kvs to rdb without going through the memtable or the WAL.
+ *
+ * kvs is sorted (in parallel) and split into non-overlapping runs,
+ * each of which one thread writes out as an SST file
+ * (staging_dir/bulk_<batch_id>_<n>.sst); the files are then
+ * ingested in one atomic call.
+ *
+ * If a key appears more than once, its last occurrence in kvs wins.
+ * Reorders kvs.
+ */
+void
+rdb_bulk_load(RocksdbWrapper& rdb,
+              std::vector<rdb_kv_t>& kvs,
+              std::string const& staging_dir,
+              uint64_t batch_id);
+
+} // namespace scs
@@ -1,40 +1,49 @@
-#pragma once
-
-#include "rocksdb/db.h"
-
-#include <string>
-
-namespace scs {
-
-class RocksdbWrapper
-{
-    const std::string dbdir;
-
-    rocksdb::DB* db = nullptr;
-
-    void open_guard() const
-    {
-        if (db == nullptr) {
-            throw std::runtime_error("db not open");
-        }
-    }
-
-    const rocksdb::ReadOptions read_options;
-    const rocksdb::WriteOptions write_options;
-
-  public:
-    RocksdbWrapper(const std::string dbdir)
-        : dbdir(dbdir + "/")
-    {
-    }
-
-    void open();
-    void clear_previous();
-    ~RocksdbWrapper();
-
-    void put(rocksdb::Slice const& key_slice,
-             rocksdb::Slice const& value_slice);
-    void get(rocksdb::Slice const& key_slice, std::string& value_out);
-};
-
-} // namespace scs
+#pragma once
+
+#include "rocksdb/db.h"
+
+#include <string>
+#include <vector>
+
+namespace scs {
+
+class RocksdbWrapper
+{
+    const std::string dbdir;
+
+    rocksdb::DB* db = nullptr;
+
+    void open_guard() const
+    {
+        if (db == nullptr) {
+            throw std::runtime_error("db not open");
+        }
+    }
+
+    const rocksdb::ReadOptions read_options;
+    const rocksdb::WriteOptions write_options;
+
+  public:
+    RocksdbWrapper(const std::string dbdir)
+        : dbdir(dbdir + "/")
+    {
+    }
+
+    void open();
+    void clear_previous();
+    ~RocksdbWrapper();
+
+    void put(rocksdb::Slice const& key_slice,
+             rocksdb::Slice const& value_slice);
+    void get(rocksdb::Slice const& key_slice, std::string& value_out);
+
+    // options the db is opened with (SST files for ingest()
+    // must be written with compatible options)
+    rocksdb::Options get_options() const;
+
+    // Atomically adds the contents of the (finished) SST files.
+    // The files are moved into the db when possible.
+    void ingest(std::vector<std::string> const& sst_filenames);
+};
+
+} // namespace scs
@@ -0,0 +1,409 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "persistence/segment_log.h"
+
+#include "utils/crc32c.h"
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <utils/mkdir.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace scs
+{
+
+namespace
+{
+
+const std::string SEGMENT_PREFIX = "segment_";
+
+// below this, copying a record into the staging buffer
+// isn't worth spreading across threads
+constexpr size_t PARALLEL_COPY_THRESHOLD = 1 << 20;
+
+void
+sync_directory(std::string const& folder)
+{
+    int dfd = ::open(folder.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dfd < 0) {
+        throw std::runtime_error("failed to open log directory");
+    }
+    ::fsync(dfd);
+    ::close(dfd);
+}
+
+bool
+read_all(int fd, uint8_t* buf, size_t len, uint64_t offset)
+{
+    while (len > 0) {
+        ssize_t res = ::pread(fd, buf, len, offset);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            return false;
+        }
+        buf += res;
+        len -= res;
+        offset += res;
+    }
+    return true;
+}
+
+const std::vector<uint8_t> EMPTY_HEAD;
+
+uint32_t
+record_crc(SegmentLog::RecordHeader const& header,
+           std::vector<uint8_t> const& head,
+           std::span<const std::vector<uint8_t>> bufs)
+{
+    auto const* hdr = reinterpret_cast<const uint8_t*>(&header);
+    constexpr size_t skip = offsetof(SegmentLog::RecordHeader, timestamp);
+    uint32_t crc
+        = crc32c::extend(crc32c::INIT, hdr + skip, sizeof(header) - skip);
+    crc = crc32c::extend(crc, head.data(), head.size());
+    for (auto const& buf : bufs) {
+        crc = crc32c::extend(crc, buf.data(), buf.size());
+    }
+    return crc32c::finish(crc);
+}
+
+} // namespace
+
+SegmentLog::SegmentLog(std::string folder, uint64_t segment_bytes)
+    : folder(folder)
+    , segment_bytes(segment_bytes)
+{
+    utils::mkdir_safe(folder);
+    auto segments = list_segments(folder);
+    if (!segments.empty()) {
+        next_segment_index = segments.back() + 1;
+    }
+}
+
+SegmentLog::~SegmentLog()
+{
+    try {
+        close_segment();
+    } catch (...) {
+        std::printf("failed to write out log segment on shutdown\n");
+    }
+}
+
+std::string
+SegmentLog::get_segment_filename(uint64_t index) const
+{
+    return folder + SEGMENT_PREFIX + std::to_string(index);
+}
+
+std::vector<uint64_t>
+SegmentLog::list_segments(std::string const& folder)
+{
+    std::vector<uint64_t> out;
+    std::error_code ec;
+    for (auto const& entry : std::filesystem::directory_iterator(folder, ec)) {
+        std::string name = entry.path().filename().string();
+        if (!name.starts_with(SEGMENT_PREFIX)) {
+            continue;
+        }
+        uint64_t idx;
+        auto const* begin = name.data() + SEGMENT_PREFIX.size();
+        auto const* end = name.data() + name.size();
+        auto [ptr, err] = std::from_chars(begin, end, idx);
+        if (err == std::errc() && ptr == end) {
+            out.push_back(idx);
+        }
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+void
+SegmentLog::flush()
+{
+    if (staging.size() == 0) {
+        return;
+    }
+    io.write_all({ IORequest{ .fd = fd,
+                              .buf = staging.data(),
+                              .len = staging.size(),
+                              .offset = staged_offset } });
+    staging.clear();
+    staged_offset = write_offset;
+}
+
+void
+SegmentLog::close_segment()
+{
+    if (fd >= 0) {
+        flush();
+        ::fdatasync(fd);
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void
+SegmentLog::open_next_segment(uint64_t min_bytes)
+{
+    close_segment();
+
+    std::string filename = get_segment_filename(next_segment_index++);
+
+    fd = open_direct(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open log segment");
+    }
+
+    segment_capacity = round_up_to_alignment(std::max(segment_bytes, min_bytes));
+    if (::posix_fallocate(fd, 0, segment_capacity) != 0) {
+        throw std::runtime_error("failed to preallocate log segment");
+    }
+    // persist the allocation and the directory entry once,
+    // so that appends only ever need fdatasync()
+    ::fsync(fd);
+    sync_directory(folder);
+
+    write_offset = 0;
+    staged_offset = 0;
+}
+
+void
+SegmentLog::append(uint64_t timestamp,
+                   std::span<const std::vector<uint8_t>> bufs)
+{
+    append(timestamp, EMPTY_HEAD, bufs);
+}
+
+void
+SegmentLog::append(uint64_t timestamp,
+                   std::vector<uint8_t> const& head,
+                   std::span<const std::vector<uint8_t>> bufs)
+{
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.timestamp = timestamp;
+    header.payload_len = head.size();
+    for (auto const& buf : bufs) {
+        header.payload_len += buf.size();
+    }
+    header.crc = record_crc(header, head, bufs);
+
+    const uint64_t record_bytes
+        = round_up_to_alignment(sizeof(RecordHeader) + header.payload_len);
+
+    if (fd < 0 || write_offset + record_bytes > segment_capacity) {
+        open_next_segment(record_bytes);
+    }
+
+    const size_t base = staging.size();
+    staging.resize(base + sizeof(RecordHeader) + header.payload_len);
+    uint8_t* out = staging.data() + base;
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    if (head.size() > 0) {
+        std::memcpy(out, head.data(), head.size());
+        out += head.size();
+    }
+
+    if (header.payload_len < PARALLEL_COPY_THRESHOLD) {
+        for (auto const& buf : bufs) {
+            if (buf.size() > 0) {
+                std::memcpy(out, buf.data(), buf.size());
+                out += buf.size();
+            }
+        }
+    } else {
+        std::vector<size_t> starts(bufs.size());
+        size_t acc = 0;
+        for (size_t i = 0; i < bufs.size(); i++) {
+            starts[i] = acc;
+            acc += bufs[i].size();
+        }
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, bufs.size()),
+            [&](auto r) {
+                for (size_t i = r.begin(); i < r.end(); i++) {
+                    if (bufs[i].size() > 0) {
+                        std::memcpy(out + starts[i], bufs[i].data(), bufs[i].size());
+                    }
+                }
+            });
+    }
+
+    // next record starts at an aligned offset
+    staging.pad();
+    staging.resize(staging.padded_size());
+
+    write_offset += record_bytes;
+}
+
+void
+SegmentLog::sync()
+{
+    if (fd < 0) {
+        return;
+    }
+    flush();
+    if (::fdatasync(fd) != 0) {
+        throw std::runtime_error("log fdatasync failed");
+    }
+}
+
+void
+SegmentLog::clear()
+{
+    close_segment();
+    for (auto idx : list_segments(folder)) {
+        std::filesystem::remove(get_segment_filename(idx));
+    }
+    sync_directory(folder);
+    next_segment_index = 0;
+    write_offset = 0;
+    staged_offset = 0;
+    segment_capacity = 0;
+}
+
+uint64_t
+SegmentLog::remove_segments_through(uint64_t max_timestamp)
+{
+    uint64_t removed = 0;
+    for (auto idx : list_segments(folder)) {
+        // the last segment opened is still being appended to
+        if (fd >= 0 && idx + 1 == next_segment_index) {
+            break;
+        }
+        auto filename = get_segment_filename(idx);
+        auto max_ts = max_timestamp_in_segment(filename);
+        if (max_ts && *max_ts > max_timestamp) {
+            break;
+        }
+        std::filesystem::remove(filename);
+        removed++;
+    }
+    if (removed > 0) {
+        sync_directory(folder);
+    }
+    return removed;
+}
+
+std::optional<uint64_t>
+SegmentLog::max_timestamp_in_segment(std::string const& filename)
+{
+    std::optional<uint64_t> out;
+
+    int rfd = ::open(filename.c_str(), O_RDONLY);
+    if (rfd < 0) {
+        throw std::runtime_error("failed to open log segment");
+    }
+    struct stat st;
+    if (::fstat(rfd, &st) != 0) {
+        ::close(rfd);
+        throw std::runtime_error("failed to stat log segment");
+    }
+    const uint64_t file_bytes = st.st_size;
+
+    // only reads headers, so doesn't check payload checksums
+    uint64_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= file_bytes) {
+        RecordHeader header;
+        if (!read_all(rfd,
+                      reinterpret_cast<uint8_t*>(&header),
+                      sizeof(header),
+                      offset)) {
+            break;
+        }
+        if (header.magic != RECORD_MAGIC
+            || header.payload_len > file_bytes - offset - sizeof(RecordHeader)) {
+            break;
+        }
+        out = std::max(out.value_or(0), header.timestamp);
+        offset += round_up_to_alignment(sizeof(RecordHeader) + header.payload_len);
+    }
+    ::close(rfd);
+    return out;
+}
+
+uint64_t
+SegmentLog::replay(
+    std::string const& folder,
+    std::function<void(uint64_t, std::vector<uint8_t> const&)> fn)
+{
+    uint64_t count = 0;
+    std::vector<uint8_t> payload;
+
+    for (auto idx : list_segments(folder)) {
+        std::string filename = folder + SEGMENT_PREFIX + std::to_string(idx);
+        int rfd = ::open(filename.c_str(), O_RDONLY);
+        if (rfd < 0) {
+            throw std::runtime_error("failed to open log segment");
+        }
+
+        struct stat st;
+        if (::fstat(rfd, &st) != 0) {
+            ::close(rfd);
+            throw std::runtime_error("failed to stat log segment");
+        }
+        const uint64_t file_bytes = st.st_size;
+
+        uint64_t offset = 0;
+        while (offset + sizeof(RecordHeader) <= file_bytes) {
+            RecordHeader header;
+            if (!read_all(rfd,
+                          reinterpret_cast<uint8_t*>(&header),
+                          sizeof(header),
+                          offset)) {
+                break;
+            }
+            if (header.magic != RECORD_MAGIC
+                || header.payload_len
+                       > file_bytes - offset - sizeof(RecordHeader)) {
+                break;
+            }
+            payload.resize(header.payload_len);
+            if (!read_all(rfd,
+                          payload.data(),
+                          payload.size(),
+                          offset + sizeof(RecordHeader))) {
+                break;
+            }
+            if (record_crc(header, payload, {}) != header.crc) {
+                break;
+            }
+
+            fn(header.timestamp, payload);
+            count++;
+            offset += round_up_to_alignment(sizeof(RecordHeader) + header.payload_len);
+        }
+        ::close(rfd);
+    }
+    return count;
+}
+
+} // namespace scs
@@ -0,0 +1,137 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config/static_constants.h"
+
+#include "persistence/async_io.h"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace scs
+{
+
+/**
+ * Append-only log of checksummed records, split into
+ * preallocated segment files (folder/segment_<n>).
+ *
+ * Segments are allocated up front, so appending never changes
+ * file size, and sync() only needs fdatasync().
+ * A record never spans two segments.
+ *
+ * Records start at DIRECT_IO_ALIGNMENT boundaries, so that segments
+ * can be written with O_DIRECT: appends are staged in an aligned
+ * buffer, and written out (as one batch of parallel writes)
+ * on sync() or when the segment fills.
+ *
+ * Record format (little endian):
+ *   magic (u32), crc32c (u32), timestamp (u64), payload_len (u64),
+ *   payload[payload_len]
+ * The checksum covers everything after itself.
+ *
+ * A process never appends to a segment written by an earlier process;
+ * it starts a new segment after the highest one on disk.
+ *
+ * Not threadsafe.
+ */
+class SegmentLog
+{
+    const std::string folder;
+    const uint64_t segment_bytes;
+
+    int fd = -1;
+    uint64_t next_segment_index = 0;
+    uint64_t write_offset = 0;
+    uint64_t segment_capacity = 0;
+
+    AsyncIO io;
+    // records appended since the last flush,
+    // to be written at staged_offset in the current segment
+    AlignedBuffer staging;
+    uint64_t staged_offset = 0;
+
+    void flush();
+    void open_next_segment(uint64_t min_bytes);
+    void close_segment();
+
+  public:
+    constexpr static uint32_t RECORD_MAGIC = 0x5C5A'10C5;
+
+    struct RecordHeader
+    {
+        uint32_t magic;
+        uint32_t crc;
+        uint64_t timestamp;
+        uint64_t payload_len;
+    };
+    static_assert(sizeof(RecordHeader) == 24, "unexpected padding");
+
+    SegmentLog(std::string folder,
+               uint64_t segment_bytes = KEY_LOG_SEGMENT_BYTES);
+
+    ~SegmentLog();
+
+    SegmentLog(const SegmentLog&) = delete;
+    SegmentLog& operator=(const SegmentLog&) = delete;
+
+    // Record payload is the concatenation of bufs.
+    // Not written (let alone durable) until the next sync().
+    void append(uint64_t timestamp,
+                std::span<const std::vector<uint8_t>> bufs);
+
+    // Record payload is head, then the concatenation of bufs.
+    void append(uint64_t timestamp,
+                std::vector<uint8_t> const& head,
+                std::span<const std::vector<uint8_t>> bufs);
+
+    void sync();
+
+    // removes every segment (including ones from earlier processes)
+    void clear();
+
+    // Removes the oldest segments, as long as every record in them
+    // has timestamp <= max_timestamp.  Never removes the segment
+    // being appended to.  Returns the number removed.
+    uint64_t remove_segments_through(uint64_t max_timestamp);
+
+    std::string get_segment_filename(uint64_t index) const;
+
+    // segment indices on disk, ascending
+    static std::vector<uint64_t> list_segments(std::string const& folder);
+
+    // largest timestamp of an intact record in the segment,
+    // or nullopt if there are none
+    static std::optional<uint64_t> max_timestamp_in_segment(
+        std::string const& filename);
+
+    /**
+     * Calls fn(timestamp, payload) on every intact record, in log order.
+     * Within a segment, stops at the first record that is missing,
+     * cut short, or fails its checksum (e.g. a write torn by a crash).
+     * Returns the number of records replayed.
+     */
+    static uint64_t replay(
+        std::string const& folder,
+        std::function<void(uint64_t, std::vector<uint8_t> const&)> fn);
+};
+
+} // namespace scs
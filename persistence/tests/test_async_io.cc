@@ -0,0 +1,123 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "persistence/async_io.h"
+
+#include <utils/mkdir.h>
+
+#include <sys/stat.h>
+
+namespace scs {
+
+namespace test {
+
+void
+fill_async_io_buffer(AlignedBuffer& buf, size_t len, uint8_t seed)
+{
+    buf.resize(len);
+    for (size_t i = 0; i < len; i++) {
+        buf.data()[i] = static_cast<uint8_t>(i * 31 + seed);
+    }
+}
+
+void
+async_io_roundtrip(AsyncIO& io)
+{
+    const std::string folder = "test_async_io/";
+    utils::mkdir_safe(folder);
+    utils::clear_directory(folder);
+
+    // empty, sub-block, unaligned, and multi-chunk
+    std::vector<size_t> sizes = { 0, 100, 5000, 3 * ASYNC_IO_CHUNK_BYTES + 17 };
+
+    std::vector<FileWrite> files;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        FileWrite f;
+        f.filename = folder + std::to_string(i);
+        fill_async_io_buffer(f.contents, sizes[i], i);
+        files.push_back(std::move(f));
+    }
+
+    write_files_durable(io, files);
+
+    for (size_t i = 0; i < sizes.size(); i++) {
+        struct stat st;
+        REQUIRE(::stat(files[i].filename.c_str(), &st) == 0);
+        REQUIRE(static_cast<size_t>(st.st_size) == sizes[i]);
+
+        AlignedBuffer read;
+        REQUIRE(read_file(io, files[i].filename.c_str(), read));
+        REQUIRE(read.size() == sizes[i]);
+
+        AlignedBuffer expect;
+        fill_async_io_buffer(expect, sizes[i], i);
+        for (size_t j = 0; j < sizes[i]; j++) {
+            if (read.data()[j] != expect.data()[j]) {
+                FAIL("mismatch at " << j);
+            }
+        }
+    }
+
+    AlignedBuffer none;
+    REQUIRE(!read_file(io, (folder + "missing").c_str(), none));
+
+    utils::clear_directory(folder);
+}
+
+} // namespace test
+
+using namespace test;
+
+TEST_CASE("async io default backend", "[async_io]")
+{
+    AsyncIO io;
+    async_io_roundtrip(io);
+}
+
+TEST_CASE("async io thread pool fallback", "[async_io]")
+{
+    AsyncIO io(0);
+    REQUIRE(!io.using_io_uring());
+    async_io_roundtrip(io);
+}
+
+TEST_CASE("aligned buffer", "[async_io]")
+{
+    AlignedBuffer buf;
+    fill_async_io_buffer(buf, 10, 1);
+    REQUIRE(reinterpret_cast<uintptr_t>(buf.data()) % DIRECT_IO_ALIGNMENT == 0);
+    REQUIRE(buf.padded_size() == DIRECT_IO_ALIGNMENT);
+
+    // growing keeps contents
+    buf.resize(3 * DIRECT_IO_ALIGNMENT + 1);
+    AlignedBuffer expect;
+    fill_async_io_buffer(expect, 10, 1);
+    for (size_t i = 0; i < 10; i++) {
+        REQUIRE(buf.data()[i] == expect.data()[i]);
+    }
+    REQUIRE(buf.padded_size() == 4 * DIRECT_IO_ALIGNMENT);
+
+    buf.pad();
+    REQUIRE(buf.data()[buf.padded_size() - 1] == 0);
+
+    AlignedBuffer moved(std::move(buf));
+    REQUIRE(moved.size() == 3 * DIRECT_IO_ALIGNMENT + 1);
+    REQUIRE(buf.size() == 0);
+}
+
+} // namespace scs
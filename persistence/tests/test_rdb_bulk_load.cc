@@ -0,0 +1,116 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "persistence/rdb_bulk_load.h"
+
+#include "config/static_constants.h"
+
+#include <utils/mkdir.h>
+
+#include <cstring>
+#include <filesystem>
+
+namespace scs {
+
+namespace test {
+
+std::string
+rdb_bulk_key(uint64_t v)
+{
+    std::string out(sizeof(v), '\0');
+    // big endian, so that keys sort in numeric order
+    for (size_t i = 0; i < sizeof(v); i++) {
+        out[sizeof(v) - 1 - i] = (v >> (8 * i)) & 0xFF;
+    }
+    return out;
+}
+
+} // namespace test
+
+using namespace test;
+
+TEST_CASE("rdb bulk load", "[rdb]")
+{
+    const std::string staging = "test_rdb_staging/";
+
+    RocksdbWrapper rdb("test_rdb_bulk");
+    rdb.clear_previous();
+    rdb.open();
+
+    std::vector<std::string> keys, values;
+
+    SECTION("small batch, with duplicates")
+    {
+        // reverse order, and key 5 twice
+        for (uint64_t i = 10; i > 0; i--) {
+            keys.push_back(rdb_bulk_key(i));
+            values.push_back("v" + std::to_string(i));
+        }
+        keys.push_back(rdb_bulk_key(5));
+        values.push_back("newer");
+
+        std::vector<rdb_kv_t> kvs;
+        for (size_t i = 0; i < keys.size(); i++) {
+            kvs.emplace_back(keys[i], values[i]);
+        }
+        rdb_bulk_load(rdb, kvs, staging, 0);
+
+        std::string out;
+        rdb.get(rdb_bulk_key(1), out);
+        REQUIRE(out == "v1");
+        rdb.get(rdb_bulk_key(5), out);
+        REQUIRE(out == "newer");
+        rdb.get(rdb_bulk_key(10), out);
+        REQUIRE(out == "v10");
+    }
+
+    SECTION("large batch splits into files")
+    {
+        const uint64_t n = 3 * RDB_BULK_LOAD_MIN_FILE_ENTRIES + 17;
+        for (uint64_t i = 0; i < n; i++) {
+            // shuffled
+            uint64_t k = (i * 7919) % n;
+            keys.push_back(rdb_bulk_key(k));
+            values.push_back(std::to_string(k));
+        }
+        std::vector<rdb_kv_t> kvs;
+        for (size_t i = 0; i < keys.size(); i++) {
+            kvs.emplace_back(keys[i], values[i]);
+        }
+        rdb_bulk_load(rdb, kvs, staging, 1);
+
+        for (uint64_t k : { (uint64_t)0, (uint64_t)1, n / 2, n - 1 }) {
+            std::string out;
+            rdb.get(rdb_bulk_key(k), out);
+            REQUIRE(out == std::to_string(k));
+        }
+
+        // staging files are gone
+        REQUIRE(std::filesystem::is_empty(staging));
+    }
+
+    SECTION("empty")
+    {
+        std::vector<rdb_kv_t> kvs;
+        rdb_bulk_load(rdb, kvs, staging, 2);
+    }
+
+    rdb.clear_previous();
+}
+
+} // namespace scs
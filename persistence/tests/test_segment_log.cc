@@ -0,0 +1,186 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "persistence/segment_log.h"
+
+#include <utils/mkdir.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace scs {
+
+namespace test {
+
+std::vector<std::vector<uint8_t>>
+segment_log_record(uint8_t seed, size_t num_bufs)
+{
+    std::vector<std::vector<uint8_t>> out(num_bufs);
+    for (size_t i = 0; i < num_bufs; i++) {
+        // some buffers empty, like idle threads' buffers
+        out[i].resize((i % 3 == 0) ? 0 : (i * 7 + seed) % 50, seed + i);
+    }
+    return out;
+}
+
+std::vector<uint8_t>
+flatten(std::vector<std::vector<uint8_t>> const& bufs)
+{
+    std::vector<uint8_t> out;
+    for (auto const& b : bufs) {
+        out.insert(out.end(), b.begin(), b.end());
+    }
+    return out;
+}
+
+std::vector<std::pair<uint64_t, std::vector<uint8_t>>>
+replay_all(std::string const& folder)
+{
+    std::vector<std::pair<uint64_t, std::vector<uint8_t>>> out;
+    SegmentLog::replay(folder, [&](uint64_t ts, std::vector<uint8_t> const& p) {
+        out.emplace_back(ts, p);
+    });
+    return out;
+}
+
+} // namespace test
+
+using namespace test;
+
+TEST_CASE("segment log append and replay", "[segment_log]")
+{
+    const std::string folder = "test_segment_log/";
+    utils::mkdir_safe(folder);
+    utils::clear_directory(folder);
+
+    std::vector<std::vector<uint8_t>> expect;
+
+    {
+        // small segments, to force rollover
+        SegmentLog log(folder, 3 * DIRECT_IO_ALIGNMENT);
+        for (uint8_t i = 0; i < 20; i++) {
+            auto rec = segment_log_record(i, 10 + i);
+            log.append(i, rec);
+            expect.push_back(flatten(rec));
+        }
+        log.sync();
+        REQUIRE(SegmentLog::list_segments(folder).size() > 1);
+    }
+
+    SECTION("replay")
+    {
+        auto res = replay_all(folder);
+        REQUIRE(res.size() == expect.size());
+        for (size_t i = 0; i < res.size(); i++) {
+            REQUIRE(res[i].first == i);
+            REQUIRE(res[i].second == expect[i]);
+        }
+    }
+
+    SECTION("reopen appends to a new segment")
+    {
+        auto before = SegmentLog::list_segments(folder);
+        {
+            SegmentLog log(folder, 3 * DIRECT_IO_ALIGNMENT);
+            auto rec = segment_log_record(100, 4);
+            log.append(100, rec);
+            expect.push_back(flatten(rec));
+            log.sync();
+        }
+        auto after = SegmentLog::list_segments(folder);
+        REQUIRE(after.size() == before.size() + 1);
+        REQUIRE(after.back() == before.back() + 1);
+
+        auto res = replay_all(folder);
+        REQUIRE(res.size() == expect.size());
+        REQUIRE(res.back().first == 100);
+        REQUIRE(res.back().second == expect.back());
+    }
+
+    SECTION("oversized record")
+    {
+        SegmentLog log(folder, 3 * DIRECT_IO_ALIGNMENT);
+        std::vector<std::vector<uint8_t>> big(1, std::vector<uint8_t>(20000, 0xAB));
+        log.append(200, big);
+        log.sync();
+
+        auto res = replay_all(folder);
+        REQUIRE(res.back().first == 200);
+        REQUIRE(res.back().second == big[0]);
+    }
+
+    SECTION("torn tail")
+    {
+        auto segments = SegmentLog::list_segments(folder);
+        std::string last = folder + "segment_" + std::to_string(segments.back());
+
+        auto res = replay_all(folder);
+
+        // flip a payload byte of the first record in the last segment
+        int fd = ::open(last.c_str(), O_RDWR);
+        REQUIRE(fd >= 0);
+        uint8_t byte;
+        off_t off = sizeof(SegmentLog::RecordHeader);
+        REQUIRE(::pread(fd, &byte, 1, off) == 1);
+        byte ^= 1;
+        REQUIRE(::pwrite(fd, &byte, 1, off) == 1);
+        ::close(fd);
+
+        // replay stops there, but keeps everything before it
+        auto torn = replay_all(folder);
+        REQUIRE(torn.size() < res.size());
+        REQUIRE(torn.size() > 0);
+        for (size_t i = 0; i < torn.size(); i++) {
+            REQUIRE(torn[i] == res[i]);
+        }
+    }
+
+    SECTION("remove segments through a timestamp")
+    {
+        SegmentLog log(folder, 3 * DIRECT_IO_ALIGNMENT);
+        auto before = SegmentLog::list_segments(folder);
+
+        // nothing at or before timestamp 0 only
+        REQUIRE(log.remove_segments_through(0) == 0);
+
+        log.remove_segments_through(9);
+        auto res = replay_all(folder);
+        REQUIRE(!res.empty());
+        // everything after 9 is kept, in order
+        REQUIRE(res.back().first == 19);
+        for (size_t i = 0; i < res.size(); i++) {
+            REQUIRE(res[i].first == res.back().first + 1 + i - res.size());
+        }
+        REQUIRE(res.front().first <= 10);
+
+        log.remove_segments_through(100);
+        REQUIRE(replay_all(folder).empty());
+    }
+
+    SECTION("clear")
+    {
+        SegmentLog log(folder, 3 * DIRECT_IO_ALIGNMENT);
+        log.clear();
+        REQUIRE(SegmentLog::list_segments(folder).empty());
+        REQUIRE(replay_all(folder).empty());
+    }
+
+    utils::clear_directory(folder);
+}
+
+} // namespace scs
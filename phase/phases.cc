@@ -39,11 +39,15 @@ void phase_finish_block(GlobalContext& global_structures, BlockContext& block_st
 	g.run([&] () {
 		block_structures.tx_set.finalize();
 	});
+	// contract db is disjoint from the state db and the tx set
+	g.run([&] () {
+		auto contract_ts = utils::init_time_measurement();
+		global_structures.contract_db.commit(block_structures.block_number);
+		std::printf("contract db commit %lf\n", utils::measure_time(contract_ts));
+	});
 	block_structures.modified_keys_list.merge_logs();
 	std::printf("keylist merge %lf\n", utils::measure_time(ts));
-	global_structures.contract_db.commit(block_structures.block_number);
-	std::printf("contract db commit %lf\n", utils::measure_time(ts));
-	global_structures.state_db.commit_modifications(block_structures.modified_keys_list);
+	global_structures.state_db.commit_modifications(block_structures.modified_keys_list, block_structures.block_number);
 	std::printf("commit statedb %lf\n", utils::measure_time(ts));
 	g.wait();
 	std::printf("task group wait %lf\n", utils::measure_time(ts));
@@ -68,11 +72,15 @@ void phase_finish_block(GroundhogGlobalContext& global_structures, GroundhogBloc
 	g.run([&] () {
 		block_structures.tx_set.finalize();
 	});
+	// contract db is disjoint from the state db and the tx set
+	g.run([&] () {
+		auto contract_ts = utils::init_time_measurement();
+		global_structures.contract_db.commit(block_structures.block_number);
+		std::printf("contract db commit %lf\n", utils::measure_time(contract_ts));
+	});
 	block_structures.modified_keys_list.merge_logs();
 	std::printf("keylist merge %lf\n", utils::measure_time(ts));
-	global_structures.contract_db.commit(block_structures.block_number);
-	std::printf("contract db commit %lf\n", utils::measure_time(ts));
-	global_structures.state_db.commit_modifications(block_structures.modified_keys_list);
+	global_structures.state_db.commit_modifications(block_structures.modified_keys_list, block_structures.block_number);
 	std::printf("commit statedb %lf\n", utils::measure_time(ts));
 	g.wait();
 	std::printf("task group wait %lf\n", utils::measure_time(ts));
@@ -98,10 +106,14 @@ void phase_finish_block(SisyphusGlobalContext& global_structures, SisyphusBlockC
 	g.run([&] () {
 		block_structures.tx_set.finalize();
 	});
+	// contract db is disjoint from the state db and the tx set
+	g.run([&] () {
+		auto contract_ts = utils::init_time_measurement();
+		global_structures.contract_db.commit(block_structures.block_number);
+		std::printf("contract db commit %lf\n", utils::measure_time(contract_ts));
+	});
 
 	std::printf("keylist merge %lf\n", utils::measure_time(ts));
-	global_structures.contract_db.commit(block_structures.block_number);
-	std::printf("contract db commit %lf\n", utils::measure_time(ts));
 	global_structures.state_db.commit_modifications(block_structures.modified_keys_list);
 	std::printf("commit statedb %lf\n", utils::measure_time(ts));
 	g.wait();
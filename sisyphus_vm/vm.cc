@@ -237,17 +237,45 @@ SisyphusVirtualMachine::try_exec_tx_block(Block const& block)
     */
 
     auto ts = utils::init_time_measurement();
-    global_context.state_db.log_keys(keys_persist);
+    // a logged block never refers to contracts that are not durable
+    global_context.contract_db.wait_for_persistence();
+    global_context.state_db.log_keys(keys_persist, *out);
+    global_context.state_db.checkpoint_if_due(checkpointer, keys_persist);
     global_context.state_db.set_timestamp(current_block_context -> block_number);
     std::printf("in try_exec wait for statedb log time %lf\n", utils::measure_time(ts));
     return out;
 }
 
+bool
+SisyphusVirtualMachine::try_restore_from_disk()
+{
+    auto restored = load_persisted_state(keys_persist.get_folder());
+    if (!restored) {
+        return false;
+    }
+
+    if (global_context.contract_db.restore_from_disk(restored->header.block_number)) {
+        if (global_context.contract_db.hash() != restored->header.contract_db_hash) {
+            throw std::runtime_error("restored contracts do not match block header");
+        }
+    } else {
+        install_genesis_contracts(global_context.contract_db);
+    }
+    global_context.state_db.restore(*restored, keys_persist);
+
+    prev_block_hash = hash_xdr(restored->header);
+    current_block_context = std::make_unique<SisyphusBlockContext>(
+        restored->header.block_number + 1);
+    global_context.state_db.set_timestamp(current_block_context -> block_number);
+    return true;
+}
+
 BlockHeader
-SisyphusVirtualMachine::propose_tx_block(AssemblyLimits& limits, uint64_t max_time_ms, uint32_t n_threads, Block& block_out, ModIndexLog& out_modlog, 
+SisyphusVirtualMachine::propose_tx_block(AssemblyLimits& limits, uint64_t max_time_ms, uint32_t n_threads, SerializedBlock& block_out, ModIndexLog& out_modlog, 
     std::unique_ptr<SisyphusBlockContext>* extract_block_context)
 {
 	auto ts = utils::init_time_measurement();
+    global_context.contract_db.prepare_for_block(limits.remaining_txs());
     ThreadlocalContextStore::get_rate_limiter().prep_for_notify();
     ThreadlocalContextStore::enable_rpcs();
     ThreadlocalContextStore::get_rate_limiter().start_threads(n_threads);
@@ -292,13 +320,19 @@ SisyphusVirtualMachine::propose_tx_block(AssemblyLimits& limits, uint64_t max_ti
                  current_block_context -> modified_keys_list.save_modifications(out_modlog);
 		    });
 
-	global_context.contract_db.commit(get_current_block_number());
+	// contract db commit (and hash) is disjoint from the state db
+	tbb::task_group contracts;
+	contracts.run([&] ()
+		{
+			global_context.contract_db.commit(get_current_block_number());
+			out.contract_db_hash = global_context.contract_db.hash();
+		});
 	global_context.state_db.commit_modifications(current_block_context->modified_keys_list);
+	contracts.wait();
 	ThreadlocalContextStore::post_block_clear();
 
 	std::printf("done commit mods %lf\n", utils::measure_time(ts));
 	out.state_db_hash = global_context.state_db.hash();
-	out.contract_db_hash = global_context.contract_db.hash();
     
 	std::printf("done statedb hash %lf\n", utils::measure_time(ts));
     txset.wait();
@@ -315,7 +349,9 @@ SisyphusVirtualMachine::propose_tx_block(AssemblyLimits& limits, uint64_t max_ti
     }
     std::printf("done proposal %lf\n", utils::measure_time(ts));
 
-    global_context.state_db.log_keys(keys_persist);
+    global_context.contract_db.wait_for_persistence();
+    global_context.state_db.log_keys(keys_persist, out);
+    global_context.state_db.checkpoint_if_due(checkpointer, keys_persist);
     global_context.state_db.set_timestamp(current_block_context -> block_number);
     std::printf("wait for statedb log time %lf\n", utils::measure_time(ts));
     return out;
@@ -24,11 +24,15 @@
 #include "xdr/transaction.h"
 #include "xdr/block.h"
 
+#include "tx_block/serialized_block.h"
+
 #include <utils/non_movable.h>
 
 #include "mempool/mempool.h"
 
 #include "state_db/async_keys_to_disk.h"
+#include "state_db/state_checkpoint.h"
+#include "state_db/state_restore.h"
 
 #include "block_assembly/assembly_worker.h"
 
@@ -53,17 +57,32 @@ class SisyphusVirtualMachine : public BaseVirtualMachine<SisyphusGlobalContext,
 {
 
     AsyncKeysToDisk keys_persist;
+    StateCheckpointer checkpointer;
 
   public:
     SisyphusVirtualMachine()
       : BaseVirtualMachine()
       , keys_persist()
+      , checkpointer(keys_persist.get_folder(),
+          // keeps the checkpointed block's own record, for its header
+          [this] (uint64_t ts) { keys_persist.release_logs_through(ts - 1); })
       {}
 
+    /**
+     * Restarts from the newest checkpoint and the key logs after it
+     * (instead of init_default_genesis()).
+     * Returns false if nothing was persisted.
+     * Throws if the rebuilt state does not match the last logged
+     * block header.
+     * Contracts are reloaded from the contract store (genesis
+     * contracts are reinstalled if it is empty).
+     */
+    bool try_restore_from_disk();
+
     std::optional<BlockHeader>
     try_exec_tx_block(Block const& txs);
 
-    BlockHeader propose_tx_block(AssemblyLimits& limits, uint64_t max_time_ms, uint32_t n_threads, Block& out, ModIndexLog& out_modlog,
+    BlockHeader propose_tx_block(AssemblyLimits& limits, uint64_t max_time_ms, uint32_t n_threads, SerializedBlock& out, ModIndexLog& out_modlog,
       std::unique_ptr<SisyphusBlockContext>* extract_block_context = nullptr);
 
     const auto& get_global_context() const {
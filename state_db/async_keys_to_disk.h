@@ -2,12 +2,18 @@
 
 #include <utils/async_worker.h>
 
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
+#include <optional>
+#include <vector>
 
 #include "utils/save_load_xdr.h"
 
-#include <utils/mkdir.h>
+#include "persistence/segment_log.h"
 
 #include "config/static_constants.h"
 
@@ -16,29 +22,51 @@
 
 namespace scs {
 
+/**
+ * Writes each block's serialized modified keys to a SegmentLog
+ * (one record per block, led by the block's restore record,
+ * if given -- see state_db/state_restore.h).
+ *
+ * Up to KEY_LOG_QUEUE_DEPTH blocks can be waiting to be written;
+ * log_keys() only blocks when the queue is full.
+ * The background thread writes every queued block, then
+ * syncs once for the whole group.
+ */
 class AsyncKeysToDisk : public utils::AsyncWorker
 {
+    using buffers_t = std::array<std::vector<uint8_t>, TLCACHE_SIZE>;
+
+    struct PendingBlock
+    {
+        uint32_t timestamp;
+        std::vector<uint8_t> restore_record;
+        std::unique_ptr<buffers_t> buffers;
+    };
 
     const std::string folder = "sisyphusdb_logs/";
 
-    std::string 
-    get_filename(uint32_t ts) {
-        return folder + std::to_string(ts);
-    }
+    SegmentLog log;
 
-    void make_folder()
-    {
-        utils::mkdir_safe(folder);
-    }
+    std::deque<PendingBlock> queue;
+    bool in_flight = false;
 
-    std::array<std::vector<uint8_t>, TLCACHE_SIZE> work_item;
-    bool work_done = true;
-    uint32_t work_ts = 0;
+    // written-out buffers, cleared but with their capacity,
+    // to hand back to the storage interface
+    std::vector<std::unique_ptr<buffers_t>> free_buffers;
 
-    bool exists_work_to_do() override final { return !work_done; }
+    std::optional<uint32_t> last_durable_timestamp;
+
+    // logs through this timestamp are covered by a checkpoint
+    std::optional<uint64_t> release_through;
+
+    bool exists_work_to_do() override final
+    {
+        return !queue.empty() || in_flight || release_through.has_value();
+    }
 
     void run()
     {
+        std::vector<PendingBlock> group;
         while (true) {
             std::unique_lock lock(mtx);
 
@@ -50,26 +78,43 @@ class AsyncKeysToDisk : public utils::AsyncWorker
                 return;
             }
 
-            std::string filename = get_filename(work_ts);
+            while (!queue.empty()) {
+                group.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+            auto release = release_through;
+            release_through = std::nullopt;
+            in_flight = true;
+            // room in the queue again
+            cv.notify_all();
 
-            
-           	FILE* f = std::fopen(filename.c_str(), "w");
+            lock.unlock();
 
-			if (f == nullptr) {
-				throw std::runtime_error("failed to open file");
-			}
+            if (!group.empty()) {
+                for (auto& block : group) {
+                    log.append(block.timestamp, block.restore_record, *block.buffers);
+                }
+                log.sync();
+            }
 
-			for (auto& buf : work_item)
-			{
-				std::fwrite(buf.data(), sizeof(buf.data()[0]), buf.size(), f);
-				buf.clear();
-			}
+            if (release) {
+                log.remove_segments_through(*release);
+            }
 
-			std::fflush(f);
-			fsync(fileno(f));
-			std::fclose(f);
+            for (auto& block : group) {
+                for (auto& buf : *block.buffers) {
+                    buf.clear();
+                }
+            }
 
-		    work_done = true;
+            lock.lock();
+
+            for (auto& block : group) {
+                last_durable_timestamp = block.timestamp;
+                free_buffers.push_back(std::move(block.buffers));
+            }
+            group.clear();
+            in_flight = false;
             cv.notify_all();
         }
     }
@@ -77,36 +122,84 @@ class AsyncKeysToDisk : public utils::AsyncWorker
   public:
     AsyncKeysToDisk()
         : utils::AsyncWorker()
-        , work_item()
+        , log(folder)
     {
-        make_folder();
         start_async_thread([this] { run(); });
     }
 
     ~AsyncKeysToDisk() { terminate_worker(); }
 
-    void log_keys(trie::SerializeDiskInterface<sizeof(AddressAndKey), TLCACHE_SIZE>& storage_iface, uint32_t timestamp)
+    void log_keys(trie::SerializeDiskInterface<sizeof(AddressAndKey), TLCACHE_SIZE>& storage_iface, uint32_t timestamp,
+        std::vector<uint8_t> restore_record = {})
     {
-        std::lock_guard lock(mtx);
-        storage_iface.swap_buffers(work_item);
-        work_done = false;
-        work_ts = timestamp;
+        std::unique_lock lock(mtx);
+        cv.wait(lock, [this]() { return queue.size() < KEY_LOG_QUEUE_DEPTH; });
+
+        std::unique_ptr<buffers_t> buffers;
+        if (free_buffers.empty()) {
+            buffers = std::make_unique<buffers_t>();
+        } else {
+            buffers = std::move(free_buffers.back());
+            free_buffers.pop_back();
+        }
+
+        storage_iface.swap_buffers(*buffers);
+        queue.push_back(PendingBlock{ timestamp, std::move(restore_record), std::move(buffers) });
         cv.notify_all();
     }
 
   //  void log_keys(DirectWriteRocksDBIface<sizeof(AddressAndKey)> const& rdb, uint32_t timestamp)
   //  {}
 
-    void log_keys(trie::NullInterface<sizeof(AddressAndKey)>& iface, uint32_t timestamp)
+    void log_keys(trie::NullInterface<sizeof(AddressAndKey)>& iface, uint32_t timestamp,
+        std::vector<uint8_t> restore_record = {})
     {}
 
-    void log_keys(auto&, uint32_t) {
+    void log_keys(auto&, uint32_t, std::vector<uint8_t> = {}) {
         throw std::runtime_error("unimpl");
     }
 
+    // Every block before the returned timestamp is durable on disk.
+    uint32_t get_durable_bound()
+    {
+        std::lock_guard lock(mtx);
+        if (!last_durable_timestamp) {
+            return 0;
+        }
+        return *last_durable_timestamp + 1;
+    }
+
+    // Blocks until every block through timestamp is durable on disk.
+    // Returns false (early) if the worker is shutting down.
+    bool wait_until_durable(uint32_t timestamp)
+    {
+        std::unique_lock lock(mtx);
+        auto durable = [this, timestamp]() {
+            return last_durable_timestamp
+                   && *last_durable_timestamp >= timestamp;
+        };
+        cv.wait(lock, [this, &durable]() { return done_flag || durable(); });
+        return durable();
+    }
+
+    // Lets the worker delete log segments that only hold blocks
+    // at or before timestamp.
+    void release_logs_through(uint64_t timestamp)
+    {
+        std::lock_guard lock(mtx);
+        release_through = std::max(release_through.value_or(0), timestamp);
+        cv.notify_all();
+    }
+
+    std::string const& get_folder() const
+    {
+        return folder;
+    }
+
     void clear_folder()
     {
-        utils::clear_directory(folder);
+        wait_for_async_task();
+        log.clear();
     }
 
     using AsyncWorker::wait_for_async_task;
@@ -31,6 +31,12 @@ GroundhogPersistentStateDB::get_committed_value(const AddressAndKey& a)
     return std::nullopt;
 }
 
+void
+GroundhogPersistentStateDB::prefetch(const AddressAndKey& a)
+{
+    [[maybe_unused]] auto const* res = state_db.get_value(a);
+}
+
 void
 do_nothing_if_merge_groundhog(const GroundhogPersistentStateDB::value_t& value)
 {}
@@ -87,6 +87,9 @@ class GroundhogPersistentStateDB
     std::optional<StorageObject> get_committed_value(
         const AddressAndKey& a);
 
+    // called off the executing thread, by AccessListPrefetchPool
+    void prefetch(const AddressAndKey& a);
+
     std::optional<RevertableObject::DeltaRewind> try_apply_delta(
         const AddressAndKey& a,
         const StorageDelta& delta);
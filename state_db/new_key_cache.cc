@@ -16,70 +16,141 @@
 
 #include "state_db/new_key_cache.h"
 
-#include "crypto/crypto_utils.h"
+#include "utils/seeded_hash.h"
 
-namespace scs {
+#include <utils/compat.h>
 
-NewKeyCacheLine::NewKeyCacheLine()
-    : map()
-    , mtx()
-{}
+#include <sodium.h>
 
-std::optional<RevertableObject::DeltaRewind>
-NewKeyCacheLine::try_reserve_delta(const AddressAndKey& key,
-                                   const StorageDelta& delta)
+#include <algorithm>
+#include <bit>
+
+namespace scs {
+
+NewKeyCache::NewKeyCache()
+    : allocator()
+    , table(new std::atomic<Entry*>[MIN_TABLE_SIZE] {})
+    , table_size(MIN_TABLE_SIZE)
+    , num_entries(0)
+    , overflow()
+    , in_try_reserve_mode(true)
 {
-    std::lock_guard lock(mtx);
-    auto it = map.find(key);
-    if (it == map.end()) {
-        auto* ptr = allocator.allocate();
-        
-        if (ptr == nullptr)
-        {
-            backup_allocator.emplace_back(std::make_unique<RevertableObject>());
-            ptr = backup_allocator.back().get();
-        }
-        it = map.emplace(key, ptr).first;
+    // sets seed
+    update_key_for_round();
+}
 
-        //it = map.emplace(key, std::make_unique<RevertableObject>()).first;
-    }
+void
+NewKeyCache::update_key_for_round()
+{
+    randombytes_buf(&seed, sizeof(seed));
+}
 
-    return it->second->try_add_delta(delta);
+uint64_t
+NewKeyCache::hash(const AddressAndKey& key) const
+{
+    return seeded_hash(key, seed);
 }
 
-std::optional<StorageObject> const&
-NewKeyCacheLine::commit_and_get(const AddressAndKey& key)
+NewKeyCache::Entry*
+NewKeyCache::allocate_entry(const AddressAndKey& key, OverflowShard& shard)
 {
-    auto it = map.find(key);
+    Entry* out = allocator.allocate();
 
-    if (it == map.end()) {
-        return null_obj;
+    if (out == nullptr) {
+        auto ptr = std::make_unique<Entry>();
+        out = ptr.get();
+        std::lock_guard lock(shard.mtx);
+        shard.backup_allocator.emplace_back(std::move(ptr));
     }
-    it->second->commit_round();
-
-    return it->second->get_committed_object();
+    out->key = key;
+    return out;
 }
 
-void
-NewKeyCacheLine::clear()
+NewKeyCache::Entry*
+NewKeyCache::find_or_insert(const AddressAndKey& key)
 {
-    map.clear();
-    backup_allocator.clear();
-    allocator.clear_and_reset();
+    const uint32_t mask = table_size - 1;
+    const uint64_t h = hash(key);
+    uint32_t pos = h & mask;
+
+    auto& shard = get_shard(h);
+
+    for (uint32_t i = 0; i < MAX_PROBES; i++, pos = (pos + 1) & mask) {
+        Entry* e = table[pos].load(std::memory_order_acquire);
+
+        if (e == nullptr) {
+            if (table[pos].compare_exchange_strong(
+                    e, busy(), std::memory_order_acquire)) {
+                Entry* out = allocate_entry(key, shard);
+                table[pos].store(out, std::memory_order_release);
+                num_entries.fetch_add(1, std::memory_order_relaxed);
+                return out;
+            }
+            // e holds whatever beat us to the slot
+        }
+
+        while (e == busy()) {
+            SPINLOCK_PAUSE();
+            e = table[pos].load(std::memory_order_acquire);
+        }
+
+        if (e->key == key) {
+            return e;
+        }
+    }
+
+    // probe window is full of other keys, so every thread
+    // inserting this key ends up here
+    std::lock_guard lock(shard.mtx);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+        auto ptr = std::make_unique<Entry>();
+        ptr->key = key;
+        it = shard.map.emplace(key, ptr.get()).first;
+        shard.backup_allocator.emplace_back(std::move(ptr));
+    }
+    return it->second;
 }
 
-NewKeyCache::NewKeyCache()
-    : lines()
-    , in_try_reserve_mode(true)
+NewKeyCache::Entry*
+NewKeyCache::find(const AddressAndKey& key)
 {
-    // sets hash_key
-    update_key_for_round();
+    const uint32_t mask = table_size - 1;
+    const uint64_t h = hash(key);
+    uint32_t pos = h & mask;
+
+    for (uint32_t i = 0; i < MAX_PROBES; i++, pos = (pos + 1) & mask) {
+        // no concurrent inserts in get mode, so no busy slots
+        Entry* e = table[pos].load(std::memory_order_acquire);
+
+        if (e == nullptr) {
+            return nullptr;
+        }
+        if (e->key == key) {
+            return e;
+        }
+    }
+
+    auto& shard = get_shard(h);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+        return nullptr;
+    }
+    return it->second;
 }
 
 void
-NewKeyCache::update_key_for_round()
+NewKeyCache::reset_table(uint32_t new_size)
 {
-    crypto_shorthash_keygen(hash_key);
+    if (new_size != table_size) {
+        table.reset(new std::atomic<Entry*>[new_size] {});
+        table_size = new_size;
+        return;
+    }
+
+    for (uint32_t i = 0; i < table_size; i++) {
+        table[i].store(nullptr, std::memory_order_relaxed);
+    }
 }
 
 void
@@ -97,35 +168,13 @@ NewKeyCache::assert_get_mode() const
     }
 }
 
-uint16_t
-NewKeyCache::get_cache_line(const AddressAndKey& key, const uint8_t* hash_key)
-{
-    static_assert(crypto_shorthash_BYTES == 8);
-
-    uint64_t hash_out;
-
-    if (crypto_shorthash(reinterpret_cast<uint8_t*>(&hash_out),
-                         key.data(),
-                         key.size(),
-                         hash_key)
-        != 0) {
-        throw std::runtime_error("shorthash fail");
-    }
-
-    // https://lemire.me/blog/2016/06/27/a-fast-alternative-to-the-modulo-reduction
-    return ((hash_out & 0xFFFF'FFFF) /* 32 bits */
-            * static_cast<uint64_t>(CACHE_LINES))
-           >> 32;
-}
-
 std::optional<RevertableObject::DeltaRewind>
 NewKeyCache::try_reserve_delta(const AddressAndKey& key,
                                const StorageDelta& delta)
 {
     assert_try_reserve_mode();
-    uint16_t cache_line = get_cache_line(key, hash_key);
 
-    return lines[cache_line].try_reserve_delta(key, delta);
+    return find_or_insert(key)->obj.try_add_delta(delta);
 }
 
 void
@@ -138,19 +187,39 @@ std::optional<StorageObject> const&
 NewKeyCache::commit_and_get(const AddressAndKey& key)
 {
     assert_get_mode();
-    uint16_t cache_line = get_cache_line(key, hash_key);
 
-    return lines[cache_line].commit_and_get(key);
+    Entry* e = find(key);
+
+    if (e == nullptr) {
+        return null_obj;
+    }
+    e->obj.commit_round();
+
+    return e->obj.get_committed_object();
 }
 
 void
 NewKeyCache::clear_for_next_block()
 {
-    for (auto& line : lines) {
-        line.clear();
+    // size for ~4x the keys created in this block (1/4 load)
+    uint64_t created = num_entries.load(std::memory_order_relaxed);
+    for (auto& shard : overflow) {
+        created += shard.map.size();
     }
+    uint64_t new_size = std::bit_ceil(std::max<uint64_t>(MIN_TABLE_SIZE, 4 * created));
+    new_size = std::min<uint64_t>(new_size, 1u << 30);
+
+    reset_table(new_size);
+    num_entries = 0;
+
+    for (auto& shard : overflow) {
+        shard.map.clear();
+        shard.backup_allocator.clear();
+    }
+    allocator.clear_and_reset();
+
     in_try_reserve_mode = true;
     update_key_for_round();
 }
 
-} // namespace scs
\ No newline at end of file
+} // namespace scs
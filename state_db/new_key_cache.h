@@ -21,11 +21,12 @@
 #include "object/revertable_object.h"
 
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <mutex>
-
-#include <sodium.h>
+#include <vector>
 
 #include "utils/recycling_allocator.h"
 
@@ -33,14 +34,32 @@ namespace scs {
 
 class StorageDelta;
 
-
 /**
+ * Objects for keys that are not (yet) in the main state db.
+ *
+ * Open-addressed (linear probing) table of pointers to entries,
+ * resized between blocks to (roughly) 4x the number of keys
+ * created in the previous block.  Inserts claim an empty slot by CAS,
+ * then publish the entry; lookups that see a claimed-but-unpublished
+ * slot wait for the entry.  Slots are never freed within a block.
+ *
+ * If every slot in a key's probe window (MAX_PROBES) is taken by other keys,
+ * the key goes to one of OVERFLOW_SHARDS mutex-protected overflow maps
+ * instead.  Any thread inserting the same key sees the same full window,
+ * so a key is only ever in one place.  The table is sized from the previous
+ * block, so in a first block or a burst most keys may overflow;
+ * the shards keep that case no slower than one mutex-protected map
+ * per shard (as before the table existed).
+ *
+ * Keys are hashed with seeded_hash(), reseeded per block;
+ * adversarial collisions only push keys into the overflow maps.
+ *
  * IMPORTANT:
- * try_reserve_delta() cannot be called concurrently with get()
- * or clear()
+ * try_reserve_delta() cannot be called concurrently with commit_and_get()
+ * or clear_for_next_block()
  * This is enforced by the boolean flag in NewKeyCache
  **/
-class NewKeyCacheLine
+class NewKeyCache
 {
 #if __cpp_lib_optional >= 202106L
     constexpr static std::optional<StorageObject> null_obj = std::nullopt;
@@ -48,40 +67,60 @@ class NewKeyCacheLine
     const std::optional<StorageObject> null_obj = std::nullopt;
 #endif
 
-    using allocator_t = RecyclingAllocatorLine<RevertableObject, 100'000>;
+    struct Entry
+    {
+        AddressAndKey key;
+        RevertableObject obj;
+    };
+
+    constexpr static uint32_t MIN_TABLE_SIZE = 1 << 16;
+    constexpr static uint32_t MAX_PROBES = 64;
+    constexpr static uint32_t OVERFLOW_SHARDS = 64;
+
+    using allocator_t = RecyclingAllocatorLine<Entry, 7'300'000>;
 
     allocator_t allocator;
-    std::vector<std::unique_ptr<RevertableObject>> backup_allocator;
 
-    std::map<AddressAndKey, RevertableObject*> map;
+    std::unique_ptr<std::atomic<Entry*>[]> table;
+    uint32_t table_size;
 
-    std::mutex mtx;
+    // number of keys in table (not overflow) this block
+    std::atomic<uint32_t> num_entries;
 
-  public:
-    NewKeyCacheLine();
+    struct alignas(64) OverflowShard
+    {
+        std::mutex mtx;
+        // also holds entries allocated when allocator runs out
+        std::vector<std::unique_ptr<Entry>> backup_allocator;
+        std::map<AddressAndKey, Entry*> map;
+    };
 
-    std::optional<RevertableObject::DeltaRewind> __attribute__((
-        warn_unused_result))
-    try_reserve_delta(const AddressAndKey& key, const StorageDelta& delta);
+    std::array<OverflowShard, OVERFLOW_SHARDS> overflow;
 
-    std::optional<StorageObject> const& commit_and_get(
-        const AddressAndKey& key);
+    uint64_t seed;
 
-    void clear();
-};
+    // a slot that's been claimed but whose entry isn't published yet
+    static Entry* busy()
+    {
+        return reinterpret_cast<Entry*>(static_cast<uintptr_t>(1));
+    }
 
-class NewKeyCache
-{
-    constexpr static uint16_t CACHE_LINES = 73; // medium sized prime
+    void update_key_for_round();
 
-    std::array<NewKeyCacheLine, CACHE_LINES> lines;
+    uint64_t hash(const AddressAndKey& key) const;
 
-    uint8_t hash_key[crypto_shorthash_KEYBYTES];
+    OverflowShard& get_shard(uint64_t h)
+    {
+        // low bits pick the table slot
+        return overflow[(h >> 32) % OVERFLOW_SHARDS];
+    }
 
-    void update_key_for_round();
+    Entry* allocate_entry(const AddressAndKey& key, OverflowShard& shard);
 
-    static uint16_t get_cache_line(const AddressAndKey& key,
-                                   const uint8_t* cur_seed);
+    Entry* find_or_insert(const AddressAndKey& key);
+    Entry* find(const AddressAndKey& key);
+
+    void reset_table(uint32_t new_size);
 
     bool in_try_reserve_mode;
 
@@ -101,6 +140,28 @@ class NewKeyCache
         const AddressAndKey& key);
 
     void clear_for_next_block();
+
+    // for testing
+
+    uint32_t get_table_size() const
+    {
+        return table_size;
+    }
+
+    // keys this block that did not fit in the table
+    size_t num_overflow_keys() const
+    {
+        size_t out = 0;
+        for (auto const& shard : overflow) {
+            out += shard.map.size();
+        }
+        return out;
+    }
+
+    constexpr static uint32_t get_min_table_size()
+    {
+        return MIN_TABLE_SIZE;
+    }
 };
 
 } // namespace scs
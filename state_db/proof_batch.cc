@@ -0,0 +1,238 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "state_db/proof_batch.h"
+
+#include <tbb/task_arena.h>
+
+namespace scs
+{
+
+namespace
+{
+
+void
+append_varint(std::vector<uint8_t>& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+// advances pos, returns false on overrun or overlong input
+bool
+read_varint(std::vector<uint8_t> const& in, size_t& pos, uint64_t& v)
+{
+    v = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        if (pos >= in.size()) {
+            return false;
+        }
+        uint8_t b = in[pos++];
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// decodes proofs [first, first + count) from in[pos, end)
+bool
+decode_chunk(std::vector<uint8_t> const& in,
+             size_t pos,
+             size_t end,
+             proof_bytes_t* out,
+             size_t count,
+             size_t max_proof_bytes)
+{
+    for (size_t i = 0; i < count; i++) {
+        uint64_t prefix, suffix, len;
+        if (!read_varint(in, pos, prefix) || !read_varint(in, pos, suffix)
+            || !read_varint(in, pos, len)) {
+            return false;
+        }
+        if (pos > end || len > end - pos || len > max_proof_bytes) {
+            return false;
+        }
+
+        if (i == 0) {
+            if (prefix != 0 || suffix != 0) {
+                return false;
+            }
+            out[i].assign(in.begin() + pos, in.begin() + pos + len);
+        } else {
+            auto const& prev = out[i - 1];
+            if (prefix > prev.size() || suffix > prev.size() - prefix
+                || prefix + suffix > max_proof_bytes - len) {
+                return false;
+            }
+            auto& cur = out[i];
+            cur.reserve(prefix + len + suffix);
+            cur.assign(prev.begin(), prev.begin() + prefix);
+            cur.insert(cur.end(), in.begin() + pos, in.begin() + pos + len);
+            cur.insert(cur.end(), prev.end() - suffix, prev.end());
+        }
+        pos += len;
+    }
+    return pos == end;
+}
+
+} // namespace
+
+namespace detail
+{
+
+void
+encode_proof_diff(proof_bytes_t const* prev,
+                  proof_bytes_t const& cur,
+                  std::vector<uint8_t>& out)
+{
+    size_t prefix = 0, suffix = 0;
+
+    if (prev != nullptr) {
+        size_t max_shared = std::min(prev->size(), cur.size());
+        while (prefix < max_shared && (*prev)[prefix] == cur[prefix]) {
+            prefix++;
+        }
+        while (suffix < max_shared - prefix
+               && (*prev)[prev->size() - 1 - suffix]
+                      == cur[cur.size() - 1 - suffix]) {
+            suffix++;
+        }
+    }
+
+    size_t len = cur.size() - prefix - suffix;
+
+    append_varint(out, prefix);
+    append_varint(out, suffix);
+    append_varint(out, len);
+    out.insert(out.end(), cur.begin() + prefix, cur.begin() + prefix + len);
+}
+
+std::vector<uint8_t>
+assemble_proof_batch(size_t num_proofs,
+                    std::vector<size_t> const& chunk_starts,
+                    std::vector<std::vector<uint8_t>> const& chunks)
+{
+    std::vector<uint8_t> out;
+
+    size_t body_size = 0;
+    for (auto const& c : chunks) {
+        body_size += c.size();
+    }
+    out.reserve(body_size + 10 * (2 + 2 * chunks.size()));
+
+    append_varint(out, num_proofs);
+    append_varint(out, chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        append_varint(out, chunk_starts[i]);
+        append_varint(out, chunks[i].size());
+    }
+    for (auto const& c : chunks) {
+        out.insert(out.end(), c.begin(), c.end());
+    }
+    return out;
+}
+
+size_t
+proof_batch_chunk_size(size_t num_keys)
+{
+    // a few chunks per worker, but long enough runs that
+    // storing each chunk's first proof in full stays cheap
+    constexpr size_t MIN_CHUNK = 64;
+    size_t workers = std::max<int>(1, tbb::this_task_arena::max_concurrency());
+    return std::max(MIN_CHUNK, num_keys / (4 * workers));
+}
+
+} // namespace detail
+
+std::optional<std::vector<proof_bytes_t>>
+decode_proof_batch(std::vector<uint8_t> const& in, size_t max_proof_bytes)
+{
+    size_t pos = 0;
+    uint64_t num_proofs, num_chunks;
+    if (!read_varint(in, pos, num_proofs) || !read_varint(in, pos, num_chunks)) {
+        return std::nullopt;
+    }
+
+    // every proof and every chunk takes at least one byte
+    if (num_proofs > in.size() || num_chunks > in.size()
+        || num_chunks > num_proofs) {
+        return std::nullopt;
+    }
+
+    std::vector<uint64_t> starts(num_chunks), offsets(num_chunks + 1);
+
+    uint64_t byte_offset = 0;
+    for (size_t i = 0; i < num_chunks; i++) {
+        uint64_t len;
+        if (!read_varint(in, pos, starts[i]) || !read_varint(in, pos, len)) {
+            return std::nullopt;
+        }
+        if ((i == 0 && starts[i] != 0)
+            || (i > 0 && starts[i] <= starts[i - 1])
+            || starts[i] >= num_proofs) {
+            return std::nullopt;
+        }
+        offsets[i] = byte_offset;
+        if (len > in.size()) {
+            return std::nullopt;
+        }
+        byte_offset += len;
+    }
+    if (byte_offset != in.size() - pos) {
+        return std::nullopt;
+    }
+    offsets[num_chunks] = byte_offset;
+
+    if (num_chunks == 0) {
+        if (num_proofs != 0) {
+            return std::nullopt;
+        }
+        return std::vector<proof_bytes_t>();
+    }
+
+    std::vector<proof_bytes_t> out(num_proofs);
+    std::atomic<bool> ok = true;
+    const size_t body = pos;
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_chunks),
+        [&](auto r) {
+            for (size_t c = r.begin(); c < r.end(); c++) {
+                size_t first = starts[c];
+                size_t last = (c + 1 < num_chunks) ? starts[c + 1] : num_proofs;
+                if (!decode_chunk(in,
+                                  body + offsets[c],
+                                  body + offsets[c + 1],
+                                  out.data() + first,
+                                  last - first,
+                                  max_proof_bytes)) {
+                    ok = false;
+                }
+            }
+        });
+
+    if (!ok) {
+        return std::nullopt;
+    }
+    return out;
+}
+
+} // namespace scs
@@ -0,0 +1,161 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace scs
+{
+
+/**
+ * A compressed batch of single-key proofs, for a sorted batch of keys.
+ *
+ * This is not a structural multiproof: the batch still holds every
+ * key's full proof, and a client still checks each one on its own.
+ * It only shrinks the bytes sent.
+ *
+ * Proofs of keys that are adjacent in sorted order share every
+ * node above the point where their paths diverge.  Those nodes
+ * serialize to the same bytes at the same (root) end of each proof,
+ * so each proof is stored as a diff against the previous one:
+ * the length of the shared leading bytes, the length of the shared
+ * trailing bytes, and the bytes in between.  This needs nothing from
+ * the trie's proof format beyond its serialized bytes.
+ *
+ * Keys are cut into chunks that are encoded (and decoded) in
+ * parallel; the first proof in each chunk is stored in full.
+ *
+ * Format (integers are LEB128 varints):
+ *   num_proofs, num_chunks,
+ *   (first proof index, byte length) per chunk,
+ *   then per proof: shared_prefix, shared_suffix, len, bytes[len]
+ */
+
+using proof_bytes_t = std::vector<uint8_t>;
+
+namespace detail
+{
+
+// appends the encoding of cur (relative to prev, if any) to out
+void encode_proof_diff(proof_bytes_t const* prev,
+                       proof_bytes_t const& cur,
+                       std::vector<uint8_t>& out);
+
+std::vector<uint8_t> assemble_proof_batch(
+    size_t num_proofs,
+    std::vector<size_t> const& chunk_starts,
+    std::vector<std::vector<uint8_t>> const& chunks);
+
+size_t proof_batch_chunk_size(size_t num_keys);
+
+} // namespace detail
+
+/**
+ * make_single(key) must return the serialized single-key proof,
+ * and must be safe to call concurrently.
+ * Keys should be sorted (otherwise, the output is valid but larger).
+ */
+template<typename key_t, typename proof_fn_t>
+std::vector<uint8_t>
+make_proof_batch(std::vector<key_t> const& sorted_keys, proof_fn_t&& make_single)
+{
+    const size_t n = sorted_keys.size();
+    const size_t chunk_size = detail::proof_batch_chunk_size(n);
+    const size_t num_chunks = (n + chunk_size - 1) / chunk_size;
+
+    std::vector<std::vector<uint8_t>> chunks(num_chunks);
+    std::vector<size_t> chunk_starts(num_chunks);
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_chunks),
+        [&](auto r) {
+            for (size_t c = r.begin(); c < r.end(); c++) {
+                size_t begin = c * chunk_size;
+                size_t end = std::min(n, begin + chunk_size);
+
+                proof_bytes_t prev, cur;
+                for (size_t i = begin; i < end; i++) {
+                    cur = make_single(sorted_keys[i]);
+                    detail::encode_proof_diff(
+                        (i == begin) ? nullptr : &prev, cur, chunks[c]);
+                    std::swap(prev, cur);
+                }
+                chunk_starts[c] = begin;
+            }
+        });
+
+    return detail::assemble_proof_batch(n, chunk_starts, chunks);
+}
+
+// bounds what an adversarial batch can make a client allocate
+constexpr static size_t MAX_SINGLE_PROOF_BYTES = 1 << 16;
+
+/**
+ * Recovers the individual serialized proofs.
+ * Returns nullopt if the input is malformed.
+ */
+std::optional<std::vector<proof_bytes_t>>
+decode_proof_batch(std::vector<uint8_t> const& batch,
+                  size_t max_proof_bytes = MAX_SINGLE_PROOF_BYTES);
+
+/**
+ * verify_single(index, proof_bytes) checks the proof of
+ * the index-th key (against the key and root hash the client expects),
+ * and must be safe to call concurrently.
+ *
+ * Each decoded proof is verified in full, including the nodes it
+ * shares with its neighbours: proofs are opaque bytes here (their
+ * format belongs to the trie library), so a shared node's hash can't
+ * be checked once and reused.  A batch costs as much hashing to
+ * verify as the proofs sent one by one.
+ */
+template<typename verify_fn_t>
+bool
+verify_proof_batch(std::vector<uint8_t> const& batch,
+                  size_t expected_num_proofs,
+                  verify_fn_t&& verify_single)
+{
+    auto proofs = decode_proof_batch(batch);
+    if (!proofs || proofs->size() != expected_num_proofs) {
+        return false;
+    }
+
+    std::atomic<bool> ok = true;
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, proofs->size()),
+        [&](auto r) {
+            for (size_t i = r.begin(); i < r.end(); i++) {
+                if (!ok.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                if (!verify_single(i, (*proofs)[i])) {
+                    ok = false;
+                }
+            }
+        });
+    return ok;
+}
+
+} // namespace scs
@@ -21,6 +21,10 @@
 
 #include <sodium.h>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_group.h>
+
 #include "pedersen_ffi/pedersen.h"
 
 namespace scs {
@@ -75,6 +79,12 @@ SisyphusStateDB::get_committed_value(const AddressAndKey& a)
     return std::nullopt;
 }
 
+void
+SisyphusStateDB::prefetch(const AddressAndKey& a)
+{
+    [[maybe_unused]] auto const* res = state_db.get_value(a);
+}
+
 void
 do_nothing_if_merge(const SisyphusStateDB::value_t& value)
 {}
@@ -105,6 +115,8 @@ struct SisyphusUpdateFn
 {
     SisyphusStateDB::trie_t& main_db;
     uint32_t current_timestamp;
+    StateSnapshotLog& snapshot_log;
+    RestoreRecordLog& restore_log;
 
     using prefix_t = SisyphusStateDB::prefix_t;
     using index_trie_t = TypedModificationIndex::map_t;
@@ -145,6 +157,17 @@ struct SisyphusUpdateFn
 
                 main_db_value->commit_round();
 
+                if constexpr (PERSISTENT_STORAGE_ENABLED || STATE_SNAPSHOTS_ENABLED) {
+                    auto key = addrkey.template get_bytes_array<AddressAndKey>();
+                    auto const& committed = main_db_value->get_committed_object();
+                    if constexpr (PERSISTENT_STORAGE_ENABLED) {
+                        restore_log.log(key, committed);
+                    }
+                    if constexpr (STATE_SNAPSHOTS_ENABLED) {
+                        snapshot_log.log(key, committed);
+                    }
+                }
+
                 // TODO this check shouldn't be necessary
                 if (!(main_db_value->get_committed_object())) {
                     main_db_subnode->delete_value(addrkey, current_timestamp, main_db.get_gc(), main_db.get_storage());
@@ -210,7 +233,7 @@ SisyphusStateDB::commit_modifications(const TypedModificationIndex& list)
         randombytes_buf(current_pedersen_random_seed.data(), current_pedersen_random_seed.size());
     }
 
-    SisyphusUpdateFn update(state_db, current_timestamp);
+    SisyphusUpdateFn update(state_db, current_timestamp, snapshot_log, restore_log);
 
     std::printf("parallel modify before %lf\n", utils::measure_time(ts));
 
@@ -221,10 +244,25 @@ SisyphusStateDB::commit_modifications(const TypedModificationIndex& list)
 
     std::printf("parallel modify after %lf\n", utils::measure_time(ts));
 
-    state_db.hash_and_normalize(0);
+    std::shared_ptr<const StateSnapshotLayer> snapshot_layer;
+    tbb::task_group g;
+    if constexpr (STATE_SNAPSHOTS_ENABLED) {
+        g.run([this, &snapshot_layer] () {
+            snapshot_layer = snapshot_log.extract_layer();
+        });
+    }
+
+    auto h = state_db.hash_and_normalize(0);
+    g.wait();
 
     std::printf("root hash %lf\n", utils::measure_time(ts));
 
+    if constexpr (STATE_SNAPSHOTS_ENABLED) {
+        Hash root_hash;
+        std::memcpy(root_hash.data(), h.data(), h.size());
+        snapshots->publish(current_timestamp, root_hash, std::move(snapshot_layer));
+    }
+
     state_db.do_gc();
     std::printf("finish %lf\n", utils::measure_time(ts));
 }
@@ -241,6 +279,62 @@ SisyphusStateDB::rewind_modifications(const TypedModificationIndex& list)
     state_db.do_gc();
 }
 
+// keys inserted by one task in SisyphusStateDB::restore()
+constexpr static size_t RESTORE_INSERT_GRAIN_SIZE = 1024;
+
+void
+merge_impossible_restore(const SisyphusStateDB::value_t& value,
+                         const StorageObject& new_obj)
+{
+    throw std::runtime_error("duplicate key in restored state");
+}
+
+void
+SisyphusStateDB::restore(RestoredState const& restored, AsyncKeysToDisk& logger)
+{
+    auto ts = utils::init_time_measurement();
+
+    current_timestamp = restored.timestamp;
+
+    auto const& entries = restored.state->get_entries();
+
+    // Entries are sorted, so each range is a disjoint subtree,
+    // and inserts from different threads rarely touch the same nodes.
+    auto* root = state_db.get_root_and_invalidate_hash(current_timestamp);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, entries.size(), RESTORE_INSERT_GRAIN_SIZE),
+        [&](auto r) {
+            for (size_t i = r.begin(); i < r.end(); i++) {
+                root->template insert<&merge_impossible_restore>(
+                    entries[i].first,
+                    state_db.get_gc(),
+                    current_timestamp,
+                    state_db.get_storage(),
+                    *entries[i].second);
+            }
+        });
+
+    std::printf("restore: trie built %lf\n", utils::measure_time(ts));
+
+    Hash root_hash = hash();
+    if (root_hash != restored.header.state_db_hash) {
+        throw std::runtime_error("restored state does not match block header");
+    }
+
+    std::printf("restore: root hash checked %lf\n", utils::measure_time(ts));
+
+    if constexpr (STATE_SNAPSHOTS_ENABLED) {
+        snapshots->publish(current_timestamp, root_hash, restored.state);
+    }
+    state_db.do_gc();
+
+    // hashing wrote every value to the storage buffers, under
+    // the restored timestamp.  The restore record has no entries
+    // (nothing was logged to restore_log), as its state is already
+    // covered by the checkpoint and the logs.
+    log_keys(logger, restored.header);
+}
+
 Hash
 SisyphusStateDB::hash()
 {
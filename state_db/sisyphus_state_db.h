@@ -28,9 +28,13 @@
 
 #include "state_db/async_keys_to_disk.h"
 #include "state_db/optional_value_wrapper.h"
+#include "state_db/state_checkpoint.h"
+#include "state_db/state_restore.h"
+#include "state_db/state_snapshot.h"
 
 #include <map>
 #include <optional>
+#include <stdexcept>
 
 #include <xdrpp/marshal.h>
 
@@ -87,16 +91,31 @@ class SisyphusStateDB
 
     trie_t state_db;
 
+    StateSnapshotLog snapshot_log;
+    // empty unless STATE_SNAPSHOTS_ENABLED
+    std::optional<StateSnapshots> snapshots;
+
+    // values committed since the last log_keys(),
+    // for the block's restore record
+    RestoreRecordLog restore_log;
+
   public:
 
     SisyphusStateDB() 
         : current_timestamp(0)
         , state_db(current_timestamp)
-        {}
+        {
+            if constexpr (STATE_SNAPSHOTS_ENABLED) {
+                snapshots.emplace();
+            }
+        }
 
     std::optional<StorageObject> get_committed_value(
         const AddressAndKey& a);
 
+    // called off the executing thread, by AccessListPrefetchPool
+    void prefetch(const AddressAndKey& a);
+
     std::optional<RevertableObject::DeltaRewind> try_apply_delta(
         const AddressAndKey& a,
         const StorageDelta& delta);
@@ -111,14 +130,68 @@ class SisyphusStateDB
         current_timestamp = ts;
     }
 
-    void log_keys(AsyncKeysToDisk& logger)
+    // Logs this block's values and its restore record.
+    void log_keys(AsyncKeysToDisk& logger, BlockHeader const& header)
     {
-        logger.log_keys(state_db.get_storage(), current_timestamp);
+        if constexpr (PERSISTENT_STORAGE_ENABLED)
+        {
+            logger.log_keys(state_db.get_storage(), current_timestamp,
+                restore_log.extract_record(header));
+        } else
+        {
+            logger.log_keys(state_db.get_storage(), current_timestamp);
+        }
     }
 
+
+    // Every STATE_CHECKPOINT_INTERVAL_BLOCKS blocks, starts writing
+    // a checkpoint of the state committed through this block
+    // (from a snapshot, or else by replaying logger's logs,
+    // once this block's log is durable).
+    void checkpoint_if_due(StateCheckpointer& checkpointer, AsyncKeysToDisk& logger)
+    {
+        if constexpr (PERSISTENT_STORAGE_ENABLED)
+        {
+            if (current_timestamp == 0
+                || current_timestamp % STATE_CHECKPOINT_INTERVAL_BLOCKS != 0) {
+                return;
+            }
+            if constexpr (STATE_SNAPSHOTS_ENABLED)
+            {
+                checkpointer.try_checkpoint(snapshots->pin());
+            } else
+            {
+                uint32_t ts = current_timestamp;
+                checkpointer.try_checkpoint_from_logs(ts,
+                    [&logger, ts] () { return logger.wait_until_durable(ts); });
+            }
+        }
+    }
+
+    /**
+     * Rebuilds the trie from restored (into an empty db),
+     * and throws if the root hash does not match
+     * restored.header.state_db_hash.
+     * Logs the restored block again, so that the trie's log
+     * covers every value it holds.
+     */
+    void restore(RestoredState const& restored, AsyncKeysToDisk& logger);
+
     const trie_t& get_trie() const {
         return state_db;
     }
+
+    // Safe to call from any thread at any time, including
+    // while a block executes or commits.
+    // Snapshot block numbers are commit timestamps.
+    // Throws unless STATE_SNAPSHOTS_ENABLED.
+    std::shared_ptr<const StateSnapshot> pin_snapshot() const
+    {
+        if (!snapshots) {
+            throw std::runtime_error("state snapshots are disabled");
+        }
+        return snapshots->pin();
+    }
 };
 
 } // namespace scs
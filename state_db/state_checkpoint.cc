@@ -0,0 +1,439 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "state_db/state_checkpoint.h"
+
+#include "state_db/state_restore.h"
+
+#include "utils/crc32c.h"
+
+#include <utils/mkdir.h>
+#include <utils/time.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace scs
+{
+
+namespace
+{
+
+const std::string CHECKPOINT_PREFIX = "checkpoint_";
+
+int
+compare_keys(const uint8_t* a, const uint8_t* b)
+{
+    return std::memcmp(a, b, sizeof(AddressAndKey));
+}
+
+uint32_t
+header_crc(CheckpointHeader const& header)
+{
+    return crc32c::compute(reinterpret_cast<const uint8_t*>(&header),
+                           offsetof(CheckpointHeader, header_crc));
+}
+
+void
+sync_directory(std::string const& folder)
+{
+    int dfd = ::open(folder.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dfd < 0) {
+        throw std::runtime_error("failed to open checkpoint directory");
+    }
+    ::fsync(dfd);
+    ::close(dfd);
+}
+
+} // namespace
+
+void
+append_state_entry(std::vector<uint8_t>& out,
+                   AddressAndKey const& key,
+                   std::optional<StorageObject> const& obj)
+{
+    uint32_t len = obj ? xdr::xdr_argpack_size(*obj) : TOMBSTONE_VALUE_LEN;
+
+    size_t sz = out.size();
+    out.resize(sz + sizeof(AddressAndKey) + sizeof(len) + (obj ? len : 0));
+    uint8_t* p = out.data() + sz;
+    std::memcpy(p, key.data(), sizeof(AddressAndKey));
+    p += sizeof(AddressAndKey);
+    std::memcpy(p, &len, sizeof(len));
+    p += sizeof(len);
+
+    if (obj) {
+        xdr::xdr_put put(p, p + len);
+        xdr::xdr_argpack_archive(put, *obj);
+        put.done();
+    }
+}
+
+std::string
+checkpoint_filename(std::string const& folder, uint64_t timestamp)
+{
+    return folder + CHECKPOINT_PREFIX + std::to_string(timestamp);
+}
+
+std::vector<uint64_t>
+list_checkpoints(std::string const& folder)
+{
+    std::vector<uint64_t> out;
+    std::error_code ec;
+    for (auto const& entry : std::filesystem::directory_iterator(folder, ec)) {
+        std::string name = entry.path().filename().string();
+        if (!name.starts_with(CHECKPOINT_PREFIX)) {
+            continue;
+        }
+        uint64_t ts;
+        auto const* begin = name.data() + CHECKPOINT_PREFIX.size();
+        auto const* end = name.data() + name.size();
+        auto [ptr, err] = std::from_chars(begin, end, ts);
+        // skips temporary files
+        if (err == std::errc() && ptr == end) {
+            out.push_back(ts);
+        }
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+void
+write_checkpoint(AsyncIO& io,
+                 std::string const& filename,
+                 uint64_t timestamp,
+                 Hash const& root_hash,
+                 StateSnapshotLayer const& state)
+{
+    auto const& entries = state.get_entries();
+    const size_t n = entries.size();
+    const size_t num_strides
+        = (n + CHECKPOINT_INDEX_STRIDE - 1) / CHECKPOINT_INDEX_STRIDE;
+
+    // serialize each stride separately, in parallel
+    std::vector<std::vector<uint8_t>> strides(num_strides);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_strides),
+        [&](auto r) {
+            for (size_t s = r.begin(); s < r.end(); s++) {
+                auto& out = strides[s];
+                size_t end = std::min(n, (s + 1) * CHECKPOINT_INDEX_STRIDE);
+                for (size_t i = s * CHECKPOINT_INDEX_STRIDE; i < end; i++) {
+                    auto const& [key, obj] = entries[i];
+                    if (!obj) {
+                        throw std::runtime_error("tombstone in checkpoint");
+                    }
+                    append_state_entry(out, key, obj);
+                }
+            }
+        });
+
+    std::vector<CheckpointIndexEntry> index(num_strides);
+    uint64_t offset = sizeof(CheckpointHeader);
+    for (size_t s = 0; s < num_strides; s++) {
+        std::memcpy(index[s].key,
+                    entries[s * CHECKPOINT_INDEX_STRIDE].first.data(),
+                    sizeof(AddressAndKey));
+        index[s].offset = offset;
+        offset += strides[s].size();
+    }
+
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.timestamp = timestamp;
+    header.num_entries = n;
+    header.index_offset = offset;
+    header.num_index_entries = num_strides;
+    header.file_bytes
+        = offset + num_strides * sizeof(CheckpointIndexEntry);
+    std::memcpy(header.root_hash, root_hash.data(), sizeof(header.root_hash));
+
+    std::vector<FileWrite> files(1);
+    std::string tmp_filename = filename + ".tmp";
+    files[0].filename = tmp_filename;
+    auto& buf = files[0].contents;
+    buf.resize(header.file_bytes);
+
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_strides),
+        [&](auto r) {
+            for (size_t s = r.begin(); s < r.end(); s++) {
+                std::memcpy(buf.data() + index[s].offset,
+                            strides[s].data(),
+                            strides[s].size());
+            }
+        });
+    if (num_strides > 0) {
+        std::memcpy(buf.data() + header.index_offset,
+                    index.data(),
+                    num_strides * sizeof(CheckpointIndexEntry));
+    }
+
+    header.body_crc = crc32c::compute(buf.data() + sizeof(CheckpointHeader),
+                                      header.file_bytes - sizeof(CheckpointHeader));
+    header.header_crc = header_crc(header);
+    std::memcpy(buf.data(), &header, sizeof(header));
+
+    write_files_durable(io, files);
+
+    if (::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        throw std::runtime_error("failed to rename checkpoint");
+    }
+    auto dir = std::filesystem::path(filename).parent_path();
+    sync_directory(dir.empty() ? "." : dir.string());
+}
+
+StateCheckpointReader::StateCheckpointReader(std::string const& filename,
+                                             bool verify_body)
+{
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open checkpoint");
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("failed to stat checkpoint");
+    }
+    file_bytes = st.st_size;
+
+    auto fail = [this](const char* msg) {
+        if (base) {
+            ::munmap(const_cast<uint8_t*>(base), file_bytes);
+        }
+        ::close(fd);
+        throw std::runtime_error(msg);
+    };
+
+    if (file_bytes < sizeof(CheckpointHeader)) {
+        fail("checkpoint truncated");
+    }
+
+    void* mapped = ::mmap(nullptr, file_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+        fail("failed to map checkpoint");
+    }
+    base = static_cast<const uint8_t*>(mapped);
+    ::madvise(mapped, file_bytes, MADV_SEQUENTIAL);
+
+    std::memcpy(&header, base, sizeof(header));
+
+    if (header.magic != CHECKPOINT_MAGIC
+        || header.version != CHECKPOINT_VERSION
+        || header.header_crc != header_crc(header)) {
+        fail("bad checkpoint header");
+    }
+    if (header.file_bytes != file_bytes
+        || header.index_offset < sizeof(CheckpointHeader)
+        || header.index_offset > file_bytes
+        || (file_bytes - header.index_offset)
+               != header.num_index_entries * sizeof(CheckpointIndexEntry)
+        || header.num_index_entries
+               != (header.num_entries + CHECKPOINT_INDEX_STRIDE - 1)
+                      / CHECKPOINT_INDEX_STRIDE) {
+        fail("checkpoint size mismatch");
+    }
+
+    uint64_t prev = sizeof(CheckpointHeader);
+    for (size_t s = 0; s < header.num_index_entries; s++) {
+        uint64_t off = index()[s].offset;
+        if (off < prev || off > header.index_offset) {
+            fail("bad checkpoint index");
+        }
+        prev = off;
+    }
+
+    if (verify_body
+        && crc32c::compute(base + sizeof(CheckpointHeader),
+                           file_bytes - sizeof(CheckpointHeader))
+               != header.body_crc) {
+        fail("checkpoint checksum mismatch");
+    }
+}
+
+StateCheckpointReader::~StateCheckpointReader()
+{
+    if (base) {
+        ::munmap(const_cast<uint8_t*>(base), file_bytes);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+Hash
+StateCheckpointReader::get_root_hash() const
+{
+    Hash out;
+    std::memcpy(out.data(), header.root_hash, sizeof(header.root_hash));
+    return out;
+}
+
+std::optional<StorageObject>
+StateCheckpointReader::find(AddressAndKey const& key) const
+{
+    const size_t ns = num_strides();
+    if (ns == 0) {
+        return std::nullopt;
+    }
+
+    // last stride whose first key is <= key
+    size_t lo = 0, hi = ns;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (compare_keys(index()[mid].key, key.data()) <= 0) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    std::optional<StorageObject> out;
+    for_each_in_stride(lo, [&](AddressAndKey const& k, StorageObject&& obj) {
+        if (!out && compare_keys(k.data(), key.data()) == 0) {
+            out = std::move(obj);
+        }
+    });
+    return out;
+}
+
+StateCheckpointer::StateCheckpointer(std::string folder,
+                                     std::function<void(uint64_t)> on_durable)
+    : utils::AsyncWorker()
+    , folder(folder)
+    , on_durable(on_durable)
+{
+    utils::mkdir_safe(folder);
+    start_async_thread([this] { run(); });
+}
+
+bool
+StateCheckpointer::try_checkpoint(std::shared_ptr<const StateSnapshot> snapshot)
+{
+    std::lock_guard lock(mtx);
+    if (!work_done) {
+        return false;
+    }
+    work_snapshot = std::move(snapshot);
+    work_done = false;
+    cv.notify_all();
+    return true;
+}
+
+bool
+StateCheckpointer::try_checkpoint_from_logs(uint64_t timestamp,
+                                            std::function<bool()> wait)
+{
+    std::lock_guard lock(mtx);
+    if (!work_done) {
+        return false;
+    }
+    work_log_timestamp = timestamp;
+    wait_for_logs = std::move(wait);
+    work_done = false;
+    cv.notify_all();
+    return true;
+}
+
+void
+StateCheckpointer::write_out(uint64_t timestamp,
+                             Hash const& root_hash,
+                             StateSnapshotLayer const& state)
+{
+    auto ts = utils::init_time_measurement();
+
+    write_checkpoint(io,
+                     checkpoint_filename(folder, timestamp),
+                     timestamp,
+                     root_hash,
+                     state);
+
+    for (auto old : list_checkpoints(folder)) {
+        if (old < timestamp) {
+            std::filesystem::remove(checkpoint_filename(folder, old));
+        }
+    }
+
+    std::printf("checkpoint %" PRIu64 " (%zu entries) written in %lf\n",
+                timestamp,
+                state.size(),
+                utils::measure_time(ts));
+
+    on_durable(timestamp);
+}
+
+void
+StateCheckpointer::write_out(StateSnapshot const& snapshot)
+{
+    auto state = snapshot.flatten();
+    write_out(snapshot.get_block_number(), snapshot.get_root_hash(), *state);
+}
+
+void
+StateCheckpointer::write_out_from_logs(uint64_t timestamp)
+{
+    auto restored = load_persisted_state(folder, timestamp);
+    if (!restored || restored->timestamp != timestamp) {
+        throw std::runtime_error("checkpointed block is not in the log");
+    }
+    write_out(timestamp, restored->header.state_db_hash, *restored->state);
+}
+
+void
+StateCheckpointer::run()
+{
+    while (true) {
+        std::unique_lock lock(mtx);
+
+        if ((!done_flag) && (!exists_work_to_do())) {
+            cv.wait(lock,
+                    [this]() { return done_flag || exists_work_to_do(); });
+        }
+        if (done_flag) {
+            return;
+        }
+
+        auto snapshot = std::move(work_snapshot);
+        auto log_timestamp = work_log_timestamp;
+        auto wait = std::move(wait_for_logs);
+        work_log_timestamp = std::nullopt;
+        lock.unlock();
+
+        if (snapshot) {
+            write_out(*snapshot);
+            snapshot.reset();
+        } else if (log_timestamp && wait()) {
+            write_out_from_logs(*log_timestamp);
+        }
+
+        lock.lock();
+        work_done = true;
+        cv.notify_all();
+    }
+}
+
+} // namespace scs
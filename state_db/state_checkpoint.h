@@ -0,0 +1,303 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "xdr/storage.h"
+#include "xdr/types.h"
+
+#include "config/static_constants.h"
+
+#include "persistence/async_io.h"
+
+#include "state_db/state_snapshot.h"
+
+#include <utils/async_worker.h>
+
+#include <xdrpp/marshal.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace scs
+{
+
+/**
+ * A full copy of committed state as of one block
+ * (folder/checkpoint_<timestamp>).
+ *
+ * Once a checkpoint is durable, the key logs of every block
+ * up to and including its timestamp are redundant; restoring
+ * needs only the newest checkpoint and the logs after it.
+ *
+ * Format (little endian):
+ *   CheckpointHeader
+ *   entries, sorted by key:
+ *     key (sizeof(AddressAndKey)), value_len (u32), value (xdr)
+ *   index: one CheckpointIndexEntry per CHECKPOINT_INDEX_STRIDE entries
+ *     (the first key and offset of each stride), so that readers can
+ *     binary search, or split decoding across threads.
+ *
+ * Every entry starts at a multiple of 4 bytes (as xdr requires).
+ */
+struct CheckpointHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t timestamp;
+    uint64_t num_entries;
+    uint64_t index_offset;
+    uint64_t num_index_entries;
+    uint64_t file_bytes;
+    uint8_t root_hash[32];
+    // of [sizeof(CheckpointHeader), file_bytes)
+    uint32_t body_crc;
+    // of the header up to here
+    uint32_t header_crc;
+};
+static_assert(sizeof(CheckpointHeader) == 88, "unexpected padding");
+
+struct CheckpointIndexEntry
+{
+    uint8_t key[sizeof(AddressAndKey)];
+    uint64_t offset;
+};
+static_assert(sizeof(CheckpointIndexEntry) == sizeof(AddressAndKey) + 8,
+              "unexpected padding");
+
+constexpr static uint32_t CHECKPOINT_MAGIC = 0x5C5C'4B50;
+constexpr static uint32_t CHECKPOINT_VERSION = 1;
+
+/**
+ * Entries (of checkpoints, and of the block records used
+ * for restarts) are key, value_len (u32), value (xdr).
+ * value_len = TOMBSTONE_VALUE_LEN marks a deleted key
+ * (which a checkpoint never contains).
+ */
+constexpr static uint32_t TOMBSTONE_VALUE_LEN = UINT32_MAX;
+
+void
+append_state_entry(std::vector<uint8_t>& out,
+                   AddressAndKey const& key,
+                   std::optional<StorageObject> const& obj);
+
+// Decodes the entry at the start of [p, end).
+// Returns the number of bytes read.  Throws if malformed.
+inline size_t
+read_state_entry(const uint8_t* p,
+                 const uint8_t* end,
+                 AddressAndKey& key,
+                 std::optional<StorageObject>& obj)
+{
+    const size_t avail = end - p;
+    if (avail < sizeof(AddressAndKey) + sizeof(uint32_t)) {
+        throw std::runtime_error("malformed state entry");
+    }
+    std::memcpy(key.data(), p, sizeof(AddressAndKey));
+
+    uint32_t len;
+    std::memcpy(&len, p + sizeof(AddressAndKey), sizeof(len));
+
+    size_t consumed = sizeof(AddressAndKey) + sizeof(len);
+    if (len == TOMBSTONE_VALUE_LEN) {
+        obj = std::nullopt;
+        return consumed;
+    }
+    if (avail - consumed < len) {
+        throw std::runtime_error("malformed state entry");
+    }
+
+    obj.emplace();
+    xdr::xdr_get g(p + consumed, p + consumed + len);
+    xdr::xdr_argpack_archive(g, *obj);
+    g.done();
+    return consumed + len;
+}
+
+std::string
+checkpoint_filename(std::string const& folder, uint64_t timestamp);
+
+// checkpoint timestamps in folder, ascending
+std::vector<uint64_t>
+list_checkpoints(std::string const& folder);
+
+/**
+ * Serializes state (which must have no tombstones) and durably
+ * writes it to filename (via a temporary file and a rename,
+ * so that filename only ever holds a complete checkpoint).
+ */
+void
+write_checkpoint(AsyncIO& io,
+                 std::string const& filename,
+                 uint64_t timestamp,
+                 Hash const& root_hash,
+                 StateSnapshotLayer const& state);
+
+/**
+ * Read-only view of a checkpoint file (memory-mapped).
+ */
+class StateCheckpointReader
+{
+    int fd = -1;
+    const uint8_t* base = nullptr;
+    size_t file_bytes = 0;
+
+    CheckpointHeader header;
+
+    const CheckpointIndexEntry* index() const
+    {
+        return reinterpret_cast<const CheckpointIndexEntry*>(
+            base + header.index_offset);
+    }
+
+    uint64_t stride_end_offset(size_t stride) const
+    {
+        return (stride + 1 < header.num_index_entries)
+                   ? index()[stride + 1].offset
+                   : header.index_offset;
+    }
+
+  public:
+    // Throws if the file is missing, truncated, or fails a checksum.
+    // verify_body = false skips checksumming the entries
+    // (e.g. when each entry is checked some other way).
+    explicit StateCheckpointReader(std::string const& filename,
+                                   bool verify_body = true);
+
+    ~StateCheckpointReader();
+
+    StateCheckpointReader(const StateCheckpointReader&) = delete;
+    StateCheckpointReader& operator=(const StateCheckpointReader&) = delete;
+
+    uint64_t get_timestamp() const { return header.timestamp; }
+
+    Hash get_root_hash() const;
+
+    uint64_t size() const { return header.num_entries; }
+
+    size_t num_strides() const { return header.num_index_entries; }
+
+    /**
+     * Calls fn(key, object) on the entries of one stride, in order.
+     * Throws on a malformed entry.
+     */
+    template<typename fn_t>
+    void for_each_in_stride(size_t stride, fn_t&& fn) const
+    {
+        const uint8_t* p = base + index()[stride].offset;
+        const uint8_t* end = base + stride_end_offset(stride);
+
+        AddressAndKey key;
+        std::optional<StorageObject> obj;
+        while (p < end) {
+            p += read_state_entry(p, end, key, obj);
+            if (!obj) {
+                throw std::runtime_error("tombstone in checkpoint");
+            }
+            fn(key, std::move(*obj));
+        }
+    }
+
+    /**
+     * Calls fn(stride, key, object) on every entry, strides in parallel.
+     */
+    template<typename fn_t>
+    void parallel_for_each(fn_t&& fn) const
+    {
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, num_strides()),
+            [&](auto r) {
+                for (size_t s = r.begin(); s < r.end(); s++) {
+                    for_each_in_stride(
+                        s, [&](AddressAndKey const& k, StorageObject&& o) {
+                            fn(s, k, std::move(o));
+                        });
+                }
+            });
+    }
+
+    std::optional<StorageObject> find(AddressAndKey const& key) const;
+};
+
+/**
+ * Writes checkpoints in the background.
+ * on_durable(timestamp) is called (from the worker thread)
+ * once the checkpoint at timestamp is on disk and older
+ * checkpoints are deleted.
+ *
+ * A checkpoint comes either from a pinned snapshot, or (when
+ * snapshots are disabled) from the previous checkpoint and the
+ * restore records logged since, which folder must hold.
+ */
+class StateCheckpointer : public utils::AsyncWorker
+{
+    const std::string folder;
+    std::function<void(uint64_t)> on_durable;
+
+    AsyncIO io;
+
+    // one of work_snapshot, work_log_timestamp is set
+    std::shared_ptr<const StateSnapshot> work_snapshot;
+    std::optional<uint64_t> work_log_timestamp;
+    std::function<bool()> wait_for_logs;
+    bool work_done = true;
+
+    bool exists_work_to_do() override final { return !work_done; }
+
+    void run();
+
+    void write_out(uint64_t timestamp,
+                   Hash const& root_hash,
+                   StateSnapshotLayer const& state);
+
+    void write_out(StateSnapshot const& snapshot);
+
+    void write_out_from_logs(uint64_t timestamp);
+
+  public:
+    StateCheckpointer(std::string folder,
+                      std::function<void(uint64_t)> on_durable);
+
+    ~StateCheckpointer() { terminate_worker(); }
+
+    // Does nothing (and returns false) if the previous
+    // checkpoint is still being written.
+    bool try_checkpoint(std::shared_ptr<const StateSnapshot> snapshot);
+
+    /**
+     * Same, but checkpoints the state as of timestamp by replaying
+     * the logs in folder.  The worker first calls wait_for_logs(),
+     * which must return true once the logs through timestamp are
+     * durable (or false to skip the checkpoint).
+     * Replaying holds a full copy of state in memory while the
+     * checkpoint is written.
+     */
+    bool try_checkpoint_from_logs(uint64_t timestamp,
+                                  std::function<bool()> wait_for_logs);
+
+    using AsyncWorker::wait_for_async_task;
+};
+
+} // namespace scs
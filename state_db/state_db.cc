@@ -25,6 +25,8 @@
 #include <utils/serialize_endian.h>
 #include <utils/time.h>
 
+#include <tbb/task_group.h>
+
 namespace scs {
 
 void
@@ -68,6 +70,14 @@ StateDB::get_committed_value(const AddressAndKey& a) const
     return std::nullopt;
 }
 
+void
+StateDB::prefetch(const AddressAndKey& a) const
+{
+    // the walk itself warms the (shared) cache with the path;
+    // prefetching the value would only warm this thread's core
+    [[maybe_unused]] auto const* res = state_db.get_value(a);
+}
+
 std::optional<RevertableObject::DeltaRewind>
 StateDB::try_apply_delta(const AddressAndKey& a, const StorageDelta& delta)
 {
@@ -93,6 +103,7 @@ struct UpdateFn
 {
     NewKeyCache& new_key_cache;
     StateDB::trie_t& main_db;
+    StateSnapshotLog& snapshot_log;
     using prefix_t = StateDB::prefix_t;
 
     template<typename Applyable>
@@ -125,6 +136,12 @@ struct UpdateFn
 
                 main_db_value->commit_round();
 
+                if constexpr (STATE_SNAPSHOTS_ENABLED) {
+                    snapshot_log.log(
+                        addrkey.template get_bytes_array<AddressAndKey>(),
+                        main_db_value->get_committed_object());
+                }
+
                 if (!(main_db_value->get_committed_object())) {
                     main_db_subnode->delete_value(addrkey, main_db.get_gc());
                 }
@@ -138,6 +155,10 @@ struct UpdateFn
                 if (new_obj) {
                     main_db_subnode->template insert<&merge_impossible>(
                         addrkey, main_db.get_gc(), *new_obj);
+
+                    if constexpr (STATE_SNAPSHOTS_ENABLED) {
+                        snapshot_log.log(query, new_obj);
+                    }
                 }
 
                 // otherwise, main_db_value is nullptr,
@@ -162,13 +183,13 @@ struct UpdateFn
 };
 
 void
-StateDB::commit_modifications(const ModifiedKeysList& list)
+StateDB::commit_modifications(const ModifiedKeysList& list, uint64_t block_number)
 {
     auto ts = utils::init_time_measurement();
 
     new_key_cache.finalize_modifications();
 
-    UpdateFn update(new_key_cache, state_db);
+    UpdateFn update(new_key_cache, state_db, snapshot_log);
 
     std::printf("parallel modify before %lf\n", utils::measure_time(ts));
 
@@ -179,12 +200,28 @@ StateDB::commit_modifications(const ModifiedKeysList& list)
 
     std::printf("parallel modify after %lf\n", utils::measure_time(ts));
 
-    new_key_cache.clear_for_next_block();
+    // the main trie holds its own copies of new objects by now,
+    // so resetting the cache can overlap with rehashing
+    std::shared_ptr<const StateSnapshotLayer> snapshot_layer;
+    tbb::task_group g;
+    g.run([this, &snapshot_layer] () {
+        new_key_cache.clear_for_next_block();
+        if constexpr (STATE_SNAPSHOTS_ENABLED) {
+            snapshot_layer = snapshot_log.extract_layer();
+        }
+    });
 
-    state_db.hash_and_normalize();
+    auto h = state_db.hash_and_normalize();
+    g.wait();
 
     std::printf("clear and root hash %lf\n", utils::measure_time(ts));
 
+    if constexpr (STATE_SNAPSHOTS_ENABLED) {
+        Hash root_hash;
+        std::memcpy(root_hash.data(), h.data(), h.size());
+        snapshots->publish(block_number, root_hash, std::move(snapshot_layer));
+    }
+
     state_db.do_gc();
     has_uncommitted_deltas = false;
     std::printf("finish %lf\n", utils::measure_time(ts));
@@ -24,12 +24,14 @@
 
 #include <map>
 #include <optional>
+#include <stdexcept>
 
 #include <xdrpp/marshal.h>
 
 #include "object/revertable_object.h"
 
 #include "state_db/new_key_cache.h"
+#include "state_db/state_snapshot.h"
 #include "config/static_constants.h"
 
 namespace scs {
@@ -72,23 +74,49 @@ class StateDB
     trie_t state_db;
     NewKeyCache new_key_cache;
 
+    StateSnapshotLog snapshot_log;
+    // empty unless STATE_SNAPSHOTS_ENABLED
+    std::optional<StateSnapshots> snapshots;
+
     std::atomic<bool> has_uncommitted_deltas = false;
 
     void assert_not_uncommitted_deltas() const;
 
   public:
+    StateDB()
+    {
+        if constexpr (STATE_SNAPSHOTS_ENABLED) {
+            snapshots.emplace();
+        }
+    }
+
     std::optional<StorageObject> get_committed_value(
         const AddressAndKey& a) const;
 
+    // called off the executing thread, by AccessListPrefetchPool
+    void prefetch(const AddressAndKey& a) const;
+
     std::optional<RevertableObject::DeltaRewind> try_apply_delta(
         const AddressAndKey& a,
         const StorageDelta& delta);
 
-    void commit_modifications(const ModifiedKeysList& list);
+    // block_number labels the snapshot of the committed state
+    void commit_modifications(const ModifiedKeysList& list, uint64_t block_number);
 
     void rewind_modifications(const ModifiedKeysList& list);
 
     Hash hash();
+
+    // Safe to call from any thread at any time, including
+    // while a block executes or commits.
+    // Throws unless STATE_SNAPSHOTS_ENABLED.
+    std::shared_ptr<const StateSnapshot> pin_snapshot() const
+    {
+        if (!snapshots) {
+            throw std::runtime_error("state snapshots are disabled");
+        }
+        return snapshots->pin();
+    }
 };
 
 } // namespace scs
@@ -37,6 +37,12 @@ StateDBv2::get_committed_value(const AddressAndKey& a) const
     return std::nullopt;
 }
 
+void
+StateDBv2::prefetch(const AddressAndKey& a) const
+{
+    [[maybe_unused]] auto const* res = state_db.get_value(a);
+}
+
 void
 do_nothing_if_merge(
     const StateDBv2::value_t& value) {}
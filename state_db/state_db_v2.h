@@ -70,6 +70,9 @@ class StateDBv2
     std::optional<StorageObject> get_committed_value(
         const AddressAndKey& a) const;
 
+    // called off the executing thread, by AccessListPrefetchPool
+    void prefetch(const AddressAndKey& a) const;
+
     std::optional<RevertableObject::DeltaRewind> try_apply_delta(
         const AddressAndKey& a,
         const StorageDelta& delta);
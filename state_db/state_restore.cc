@@ -0,0 +1,424 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "state_db/state_restore.h"
+
+#include "crypto/hash.h"
+
+#include "persistence/segment_log.h"
+
+#include "state_db/state_checkpoint.h"
+
+#include <utils/time.h>
+
+#include <xdrpp/marshal.h>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+
+namespace scs
+{
+
+namespace
+{
+
+using entry_t = StateSnapshotLayer::entry_t;
+
+// final merge is split by the first byte of each key
+constexpr size_t NUM_RESTORE_PARTITIONS = 256;
+
+BlockRestoreHead
+read_restore_head(std::vector<uint8_t> const& payload)
+{
+    BlockRestoreHead head;
+    if (payload.size() < sizeof(head)) {
+        throw std::runtime_error("key log record has no restore record");
+    }
+    std::memcpy(&head, payload.data(), sizeof(head));
+    if (head.magic != BLOCK_RESTORE_MAGIC
+        || payload.size() - sizeof(head) < head.header_bytes
+        || payload.size() - sizeof(head) - head.header_bytes
+               < head.delta_bytes) {
+        throw std::runtime_error("key log record has no restore record");
+    }
+    return head;
+}
+
+std::vector<entry_t>
+concatenate(std::vector<std::vector<entry_t>>&& parts)
+{
+    std::vector<size_t> starts(parts.size() + 1, 0);
+    for (size_t i = 0; i < parts.size(); i++) {
+        starts[i + 1] = starts[i] + parts[i].size();
+    }
+
+    std::vector<entry_t> out(starts.back());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, parts.size()),
+                      [&](auto r) {
+                          for (size_t i = r.begin(); i < r.end(); i++) {
+                              std::move(parts[i].begin(),
+                                        parts[i].end(),
+                                        out.begin() + starts[i]);
+                              parts[i].clear();
+                              parts[i].shrink_to_fit();
+                          }
+                      });
+    return out;
+}
+
+std::vector<entry_t>
+decode_checkpoint(StateCheckpointReader const& reader)
+{
+    std::vector<std::vector<entry_t>> strides(reader.num_strides());
+    // each stride is decoded by exactly one thread
+    reader.parallel_for_each(
+        [&](size_t stride, AddressAndKey const& key, StorageObject&& obj) {
+            strides[stride].emplace_back(key, std::move(obj));
+        });
+    return concatenate(std::move(strides));
+}
+
+// entries of newer override those of older; drops tombstones
+void
+merge_into_base(std::span<const entry_t> newer,
+                std::span<const entry_t> older,
+                std::vector<entry_t>& out)
+{
+    out.reserve(newer.size() + older.size());
+
+    auto emit = [&](entry_t const& e) {
+        if (e.second) {
+            out.push_back(e);
+        }
+    };
+
+    size_t n = 0, o = 0;
+    while (n < newer.size() && o < older.size()) {
+        int res = std::memcmp(newer[n].first.data(),
+                              older[o].first.data(),
+                              sizeof(AddressAndKey));
+        if (res < 0) {
+            emit(newer[n++]);
+        } else if (res > 0) {
+            emit(older[o++]);
+        } else {
+            emit(newer[n++]);
+            o++;
+        }
+    }
+    for (; n < newer.size(); n++) {
+        emit(newer[n]);
+    }
+    for (; o < older.size(); o++) {
+        emit(older[o]);
+    }
+}
+
+size_t
+partition_start(std::vector<entry_t> const& entries, size_t partition)
+{
+    auto it = std::partition_point(
+        entries.begin(), entries.end(), [partition](entry_t const& e) {
+            return e.first[0] < partition;
+        });
+    return it - entries.begin();
+}
+
+// layers are oldest first
+std::shared_ptr<const StateSnapshotLayer>
+merge_tail(std::vector<std::shared_ptr<const StateSnapshotLayer>>&& layers)
+{
+    if (layers.empty()) {
+        return StateSnapshotLayer::make_empty();
+    }
+    while (layers.size() > 1) {
+        std::vector<std::shared_ptr<const StateSnapshotLayer>> next(
+            (layers.size() + 1) / 2);
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, next.size()), [&](auto r) {
+                for (size_t i = r.begin(); i < r.end(); i++) {
+                    if (2 * i + 1 < layers.size()) {
+                        next[i] = StateSnapshotLayer::merge(
+                            *layers[2 * i + 1], *layers[2 * i], false);
+                    } else {
+                        next[i] = layers[2 * i];
+                    }
+                }
+            });
+        layers = std::move(next);
+    }
+    return layers[0];
+}
+
+// head is filled in by finish_restore_record()
+std::vector<uint8_t>
+start_restore_record(BlockHeader const& header)
+{
+    auto header_bytes = xdr::xdr_to_opaque(header);
+
+    std::vector<uint8_t> out(sizeof(BlockRestoreHead));
+    out.insert(out.end(), header_bytes.begin(), header_bytes.end());
+
+    BlockRestoreHead head;
+    head.magic = BLOCK_RESTORE_MAGIC;
+    head.header_bytes = header_bytes.size();
+    head.delta_bytes = 0;
+    head.num_entries = 0;
+    std::memcpy(out.data(), &head, sizeof(head));
+    return out;
+}
+
+void
+finish_restore_record(std::vector<uint8_t>& out, uint64_t num_entries)
+{
+    BlockRestoreHead head;
+    std::memcpy(&head, out.data(), sizeof(head));
+    head.delta_bytes = out.size() - sizeof(head) - head.header_bytes;
+    head.num_entries = num_entries;
+    std::memcpy(out.data(), &head, sizeof(head));
+}
+
+} // namespace
+
+std::vector<uint8_t>
+encode_block_restore_record(BlockHeader const& header,
+                            StateSnapshotLayer const& delta)
+{
+    auto out = start_restore_record(header);
+    for (auto const& [key, obj] : delta.get_entries()) {
+        append_state_entry(out, key, obj);
+    }
+    finish_restore_record(out, delta.size());
+    return out;
+}
+
+void
+RestoreRecordLog::log(AddressAndKey const& key,
+                      std::optional<StorageObject> const& committed)
+{
+    auto& buf = cache.get();
+    append_state_entry(buf.bytes, key, committed);
+    buf.num_entries++;
+}
+
+std::vector<uint8_t>
+RestoreRecordLog::extract_record(BlockHeader const& header)
+{
+    auto& objs = cache.get_objects();
+
+    size_t total_bytes = 0;
+    uint64_t num_entries = 0;
+    for (auto const& obj : objs) {
+        if (obj) {
+            total_bytes += obj->bytes.size();
+            num_entries += obj->num_entries;
+        }
+    }
+
+    auto out = start_restore_record(header);
+    out.reserve(out.size() + total_bytes);
+    for (auto& obj : objs) {
+        if (obj) {
+            out.insert(out.end(), obj->bytes.begin(), obj->bytes.end());
+            // keeps capacity for the next block
+            obj->bytes.clear();
+            obj->num_entries = 0;
+        }
+    }
+    finish_restore_record(out, num_entries);
+    return out;
+}
+
+BlockRestoreRecord
+decode_block_restore_record(std::vector<uint8_t> const& payload,
+                            bool decode_delta)
+{
+    auto head = read_restore_head(payload);
+
+    BlockRestoreRecord out;
+    const uint8_t* p = payload.data() + sizeof(head);
+    xdr::xdr_from_opaque(p, p + head.header_bytes, out.header);
+
+    if (!decode_delta) {
+        return out;
+    }
+
+    p += head.header_bytes;
+    const uint8_t* end = p + head.delta_bytes;
+
+    std::vector<entry_t> entries;
+    entries.reserve(head.num_entries);
+    while (p < end) {
+        auto& [key, obj] = entries.emplace_back();
+        p += read_state_entry(p, end, key, obj);
+    }
+    if (entries.size() != head.num_entries) {
+        throw std::runtime_error("restore record entry count mismatch");
+    }
+    out.delta = std::make_shared<const StateSnapshotLayer>(std::move(entries));
+    return out;
+}
+
+std::optional<RestoredState>
+load_persisted_state(std::string const& folder, uint64_t through)
+{
+    auto ts = utils::init_time_measurement();
+
+    std::optional<uint64_t> checkpoint_ts;
+    Hash checkpoint_root;
+    std::vector<entry_t> base;
+
+    auto checkpoints = list_checkpoints(folder);
+    std::erase_if(checkpoints, [through](uint64_t c) { return c > through; });
+    if (!checkpoints.empty()) {
+        StateCheckpointReader reader(
+            checkpoint_filename(folder, checkpoints.back()));
+        checkpoint_ts = reader.get_timestamp();
+        checkpoint_root = reader.get_root_hash();
+        base = decode_checkpoint(reader);
+    }
+
+    std::printf("restore: checkpoint loaded %lf\n", utils::measure_time(ts));
+
+    struct TailRecord
+    {
+        uint64_t timestamp;
+        // just the restore record, not the trie's serialization
+        std::vector<uint8_t> payload;
+    };
+
+    std::vector<TailRecord> tail;
+    std::optional<BlockHeader> checkpoint_header;
+    std::optional<uint64_t> prev_ts;
+
+    SegmentLog::replay(
+        folder, [&](uint64_t timestamp, std::vector<uint8_t> const& payload) {
+            if (prev_ts && timestamp < *prev_ts) {
+                throw std::runtime_error("key log out of order");
+            }
+            prev_ts = timestamp;
+
+            if (timestamp > through) {
+                return;
+            }
+
+            if (checkpoint_ts && timestamp <= *checkpoint_ts) {
+                if (timestamp == *checkpoint_ts) {
+                    checkpoint_header
+                        = decode_block_restore_record(payload, false).header;
+                }
+                return;
+            }
+
+            auto head = read_restore_head(payload);
+            size_t len = sizeof(head) + head.header_bytes + head.delta_bytes;
+            tail.push_back(TailRecord{
+                timestamp,
+                std::vector<uint8_t>(payload.begin(), payload.begin() + len) });
+        });
+
+    if (!checkpoint_ts && tail.empty()) {
+        return std::nullopt;
+    }
+
+    std::printf("restore: read %zu log records %lf\n",
+                tail.size(),
+                utils::measure_time(ts));
+
+    std::vector<BlockRestoreRecord> records(tail.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, tail.size()),
+                      [&](auto r) {
+                          for (size_t i = r.begin(); i < r.end(); i++) {
+                              records[i] = decode_block_restore_record(
+                                  tail[i].payload, true);
+                              tail[i].payload.clear();
+                              tail[i].payload.shrink_to_fit();
+                          }
+                      });
+
+    if (checkpoint_header
+        && checkpoint_header->state_db_hash != checkpoint_root) {
+        throw std::runtime_error("checkpoint does not match its block header");
+    }
+
+    // a restart logs the restored block's record again,
+    // so a header can repeat
+    std::optional<BlockHeader> prev_header = checkpoint_header;
+    for (auto const& record : records) {
+        if (prev_header) {
+            auto prev_hash = hash_xdr(*prev_header);
+            if (record.header.block_number == prev_header->block_number) {
+                if (hash_xdr(record.header) != prev_hash) {
+                    throw std::runtime_error("conflicting block headers in log");
+                }
+            } else if (record.header.prev_header_hash != prev_hash) {
+                throw std::runtime_error("gap in logged block headers");
+            }
+        }
+        prev_header = record.header;
+    }
+
+    if (!prev_header) {
+        throw std::runtime_error("no block header for checkpoint");
+    }
+
+    std::vector<std::shared_ptr<const StateSnapshotLayer>> layers;
+    layers.reserve(records.size());
+    for (auto& record : records) {
+        layers.push_back(std::move(record.delta));
+    }
+    auto tail_layer = merge_tail(std::move(layers));
+    auto const& newer = tail_layer->get_entries();
+
+    std::vector<std::vector<entry_t>> parts(NUM_RESTORE_PARTITIONS);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, NUM_RESTORE_PARTITIONS), [&](auto r) {
+            for (size_t p = r.begin(); p < r.end(); p++) {
+                size_t n_start = partition_start(newer, p);
+                size_t n_end = partition_start(newer, p + 1);
+                size_t o_start = partition_start(base, p);
+                size_t o_end = partition_start(base, p + 1);
+                merge_into_base(
+                    std::span<const entry_t>(newer).subspan(n_start,
+                                                            n_end - n_start),
+                    std::span<const entry_t>(base).subspan(o_start,
+                                                           o_end - o_start),
+                    parts[p]);
+            }
+        });
+
+    RestoredState out{
+        .timestamp = tail.empty() ? *checkpoint_ts : tail.back().timestamp,
+        .header = *prev_header,
+        .state = std::make_shared<const StateSnapshotLayer>(
+            concatenate(std::move(parts)))
+    };
+
+    std::printf("restore: %zu entries through %" PRIu64 " in %lf\n",
+                out.state->size(),
+                out.timestamp,
+                utils::measure_time(ts));
+    return out;
+}
+
+} // namespace scs
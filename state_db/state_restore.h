@@ -0,0 +1,131 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "xdr/block.h"
+#include "xdr/types.h"
+
+#include "config/static_constants.h"
+
+#include "state_db/state_snapshot.h"
+
+#include <utils/threadlocal_cache.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace scs
+{
+
+/**
+ * Restarting from disk.
+ *
+ * Each block's key log record starts with a restore record:
+ * the block's header, and the committed value (or tombstone)
+ * of every key the block modified.  The rest of the key log
+ * record is the trie's own serialization, which we never decode.
+ *
+ * State at a restart is the newest checkpoint, overwritten by the
+ * restore records of every block logged after it.
+ *
+ * Restore record format (little endian):
+ *   BlockRestoreHead
+ *   BlockHeader (xdr, header_bytes)
+ *   entries (delta_bytes; see append_state_entry())
+ */
+struct BlockRestoreHead
+{
+    uint32_t magic;
+    uint32_t header_bytes;
+    uint64_t delta_bytes;
+    uint64_t num_entries;
+};
+static_assert(sizeof(BlockRestoreHead) == 24, "unexpected padding");
+
+constexpr static uint32_t BLOCK_RESTORE_MAGIC = 0x5C5C'B10C;
+
+std::vector<uint8_t>
+encode_block_restore_record(BlockHeader const& header,
+                            StateSnapshotLayer const& delta);
+
+/**
+ * Builds a block's restore record as its keys commit, from whichever
+ * threads apply the commit (see SisyphusUpdateFn).  Entries are
+ * serialized as they are logged, and in no particular order
+ * (decoding sorts them).
+ */
+class RestoreRecordLog
+{
+    struct Buffer
+    {
+        std::vector<uint8_t> bytes;
+        uint64_t num_entries = 0;
+    };
+
+    utils::ThreadlocalCache<Buffer, TLCACHE_SIZE> cache;
+
+  public:
+    void log(AddressAndKey const& key,
+             std::optional<StorageObject> const& committed);
+
+    // Restore record of every entry logged since the last call.
+    // Not threadsafe with log().
+    std::vector<uint8_t> extract_record(BlockHeader const& header);
+};
+
+struct BlockRestoreRecord
+{
+    BlockHeader header;
+    // nullptr unless decoded
+    std::shared_ptr<const StateSnapshotLayer> delta;
+};
+
+// Throws if payload does not start with a restore record.
+BlockRestoreRecord
+decode_block_restore_record(std::vector<uint8_t> const& payload,
+                            bool decode_delta);
+
+struct RestoredState
+{
+    // timestamp (in the state db) of the newest block restored
+    uint64_t timestamp;
+    // that block's header
+    BlockHeader header;
+    // sorted, no tombstones
+    std::shared_ptr<const StateSnapshotLayer> state;
+};
+
+/**
+ * Loads the newest checkpoint in folder, and applies the restore
+ * records after it (up to and including timestamp through),
+ * decoding and merging across all cores.
+ *
+ * Returns nullopt if nothing was persisted.
+ * Throws if the logs are unusable (missing restore records,
+ * or a gap in the chain of block headers).
+ *
+ * Does not check the state against header.state_db_hash;
+ * that needs the rebuilt trie (SisyphusStateDB::restore()).
+ */
+std::optional<RestoredState>
+load_persisted_state(std::string const& folder,
+                     uint64_t through = UINT64_MAX);
+
+} // namespace scs
@@ -0,0 +1,285 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "state_db/state_snapshot.h"
+
+#include <tbb/parallel_sort.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace scs
+{
+
+namespace
+{
+
+int
+compare_keys(AddressAndKey const& a, AddressAndKey const& b)
+{
+    return std::memcmp(a.data(), b.data(), sizeof(AddressAndKey));
+}
+
+bool
+entry_lt(StateSnapshotLayer::entry_t const& a,
+         StateSnapshotLayer::entry_t const& b)
+{
+    return compare_keys(a.first, b.first) < 0;
+}
+
+} // namespace
+
+StateSnapshotLayer::StateSnapshotLayer(std::vector<entry_t>&& e)
+    : entries(std::move(e))
+{
+    tbb::parallel_sort(entries.begin(), entries.end(), entry_lt);
+
+    for (size_t i = 1; i < entries.size(); i++) {
+        if (compare_keys(entries[i - 1].first, entries[i].first) == 0) {
+            throw std::runtime_error("duplicate key in snapshot layer");
+        }
+    }
+}
+
+std::shared_ptr<const StateSnapshotLayer>
+StateSnapshotLayer::merge(StateSnapshotLayer const& newer,
+                          StateSnapshotLayer const& older,
+                          bool drop_tombstones)
+{
+    std::shared_ptr<StateSnapshotLayer> out(new StateSnapshotLayer());
+    auto& merged = out->entries;
+    merged.reserve(newer.size() + older.size());
+
+    auto emit = [&](entry_t const& e) {
+        if (drop_tombstones && !e.second) {
+            return;
+        }
+        merged.push_back(e);
+    };
+
+    auto n_it = newer.entries.begin();
+    auto o_it = older.entries.begin();
+
+    while (n_it != newer.entries.end() && o_it != older.entries.end()) {
+        int res = compare_keys(n_it->first, o_it->first);
+        if (res < 0) {
+            emit(*n_it);
+            n_it++;
+        } else if (res > 0) {
+            emit(*o_it);
+            o_it++;
+        } else {
+            emit(*n_it);
+            n_it++;
+            o_it++;
+        }
+    }
+    for (; n_it != newer.entries.end(); n_it++) {
+        emit(*n_it);
+    }
+    for (; o_it != older.entries.end(); o_it++) {
+        emit(*o_it);
+    }
+    return out;
+}
+
+const std::optional<StorageObject>*
+StateSnapshotLayer::find(AddressAndKey const& key) const
+{
+    auto it = std::lower_bound(
+        entries.begin(),
+        entries.end(),
+        key,
+        [](entry_t const& e, AddressAndKey const& k) {
+            return compare_keys(e.first, k) < 0;
+        });
+
+    if (it == entries.end() || compare_keys(it->first, key) != 0) {
+        return nullptr;
+    }
+    return &(it->second);
+}
+
+std::optional<StorageObject>
+StateSnapshot::get_committed_value(AddressAndKey const& key) const
+{
+    for (auto const& layer : layers) {
+        auto const* res = layer->find(key);
+        if (res) {
+            return *res;
+        }
+    }
+    return std::nullopt;
+}
+
+std::shared_ptr<const StateSnapshotLayer>
+StateSnapshot::flatten() const
+{
+    auto empty = StateSnapshotLayer::make_empty();
+    if (layers.empty()) {
+        return empty;
+    }
+
+    // merging into the oldest layer drops tombstones
+    auto acc = StateSnapshotLayer::merge(*layers.back(), *empty, true);
+    for (size_t i = layers.size() - 1; i > 0; i--) {
+        acc = StateSnapshotLayer::merge(*layers[i - 1], *acc, true);
+    }
+    return acc;
+}
+
+std::shared_ptr<const StateSnapshotLayer>
+StateSnapshotLog::extract_layer()
+{
+    auto& objs = cache.get_objects();
+
+    size_t total = 0;
+    for (auto const& obj : objs) {
+        if (obj) {
+            total += obj->size();
+        }
+    }
+
+    std::vector<StateSnapshotLayer::entry_t> entries;
+    entries.reserve(total);
+
+    for (auto& obj : objs) {
+        if (obj) {
+            std::move(obj->begin(), obj->end(), std::back_inserter(entries));
+            obj->clear();
+        }
+    }
+
+    return std::make_shared<const StateSnapshotLayer>(std::move(entries));
+}
+
+StateSnapshots::StateSnapshots()
+    : utils::AsyncWorker()
+    , latest(std::make_shared<const StateSnapshot>(
+          0, Hash(), std::vector<layer_ptr_t>()))
+{
+    start_async_thread([this] { run(); });
+}
+
+void
+StateSnapshots::publish(uint64_t block_number,
+                        Hash const& root_hash,
+                        layer_ptr_t layer)
+{
+    std::lock_guard lock(mtx);
+
+    auto prev = latest.load(std::memory_order_relaxed);
+
+    std::vector<layer_ptr_t> layers;
+    layers.reserve(prev->layers.size() + 1);
+    if (layer && layer->size() > 0) {
+        layers.push_back(std::move(layer));
+    }
+    layers.insert(layers.end(), prev->layers.begin(), prev->layers.end());
+
+    bool should_compact = layers.size() > 1;
+
+    latest.store(std::make_shared<const StateSnapshot>(
+                     block_number, root_hash, std::move(layers)),
+                 std::memory_order_release);
+
+    if (should_compact) {
+        compaction_requested = true;
+        cv.notify_all();
+    }
+}
+
+std::shared_ptr<const StateSnapshot>
+StateSnapshots::compact_once(std::shared_ptr<const StateSnapshot> const& base)
+{
+    auto const& layers = base->layers;
+
+    // merge the newest pair where the newer layer is at least
+    // half the size of the older, so that sizes at least double
+    // going down the list
+    for (size_t i = 0; i + 1 < layers.size(); i++) {
+        if (2 * layers[i]->size() < layers[i + 1]->size()) {
+            continue;
+        }
+
+        bool is_oldest = (i + 2 == layers.size());
+
+        std::vector<layer_ptr_t> new_layers;
+        new_layers.reserve(layers.size() - 1);
+        new_layers.insert(
+            new_layers.end(), layers.begin(), layers.begin() + i);
+        new_layers.push_back(
+            StateSnapshotLayer::merge(*layers[i], *layers[i + 1], is_oldest));
+        new_layers.insert(
+            new_layers.end(), layers.begin() + i + 2, layers.end());
+
+        return std::make_shared<const StateSnapshot>(
+            base->block_number, base->root_hash, std::move(new_layers));
+    }
+    return nullptr;
+}
+
+void
+StateSnapshots::run()
+{
+    while (true) {
+        std::unique_lock lock(mtx);
+
+        if ((!done_flag) && (!exists_work_to_do())) {
+            cv.wait(lock,
+                    [this]() { return done_flag || exists_work_to_do(); });
+        }
+        if (done_flag) {
+            return;
+        }
+
+        auto base = latest.load(std::memory_order_relaxed);
+
+        // merging can take a while; publish() must not wait on it
+        lock.unlock();
+        auto compacted = compact_once(base);
+        lock.lock();
+
+        auto cur = latest.load(std::memory_order_relaxed);
+
+        if (!compacted) {
+            if (cur == base) {
+                compaction_requested = false;
+                cv.notify_all();
+            }
+            continue;
+        }
+
+        // publish() only prepends layers, so base's layers
+        // are the tail of cur's
+        size_t num_new = cur->layers.size() - base->layers.size();
+
+        std::vector<layer_ptr_t> layers;
+        layers.reserve(num_new + compacted->layers.size());
+        layers.insert(
+            layers.end(), cur->layers.begin(), cur->layers.begin() + num_new);
+        layers.insert(layers.end(),
+                      compacted->layers.begin(),
+                      compacted->layers.end());
+
+        latest.store(std::make_shared<const StateSnapshot>(
+                         cur->block_number, cur->root_hash, std::move(layers)),
+                     std::memory_order_release);
+    }
+}
+
+} // namespace scs
@@ -0,0 +1,189 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "xdr/storage.h"
+#include "xdr/types.h"
+
+#include "config/static_constants.h"
+
+#include <utils/async_worker.h>
+#include <utils/threadlocal_cache.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace scs
+{
+
+/**
+ * Read-only, versioned views of committed state,
+ * for serving queries while the next block executes.
+ *
+ * Each committed block contributes one immutable layer
+ * (the committed value, or a tombstone, of every key it modified),
+ * sorted by key.  A snapshot is a newest-first list of layers,
+ * so reads never touch the live trie.  Pinning a snapshot loads
+ * a std::atomic<std::shared_ptr>, which is not lock-free
+ * (libstdc++ guards it with a spinlock), so readers briefly
+ * contend with publish() and with each other.
+ *
+ * A background worker merges adjacent layers (LSM-style) so that
+ * the number of layers a read walks stays logarithmic.
+ * Merging builds new layers; snapshots pinned before a merge
+ * keep the old ones alive until the last reader drops them.
+ *
+ * Snapshots only cover state committed through this process
+ * (or installed via StateSnapshots::publish when restoring).
+ */
+class StateSnapshotLayer
+{
+  public:
+    using entry_t = std::pair<AddressAndKey, std::optional<StorageObject>>;
+
+  private:
+    std::vector<entry_t> entries;
+
+    StateSnapshotLayer() = default;
+
+  public:
+    // sorts entries; keys must be unique
+    explicit StateSnapshotLayer(std::vector<entry_t>&& entries);
+
+    // entries of newer override those of older.
+    // Tombstones are dropped if older is the oldest layer.
+    static std::shared_ptr<const StateSnapshotLayer>
+    merge(StateSnapshotLayer const& newer,
+          StateSnapshotLayer const& older,
+          bool drop_tombstones);
+
+    // nullptr if key is not in this layer,
+    // otherwise the value (nullopt if deleted)
+    const std::optional<StorageObject>* find(AddressAndKey const& key) const;
+
+    size_t size() const { return entries.size(); }
+
+    // sorted by key
+    std::vector<entry_t> const& get_entries() const { return entries; }
+
+    static std::shared_ptr<const StateSnapshotLayer> make_empty()
+    {
+        return std::shared_ptr<const StateSnapshotLayer>(new StateSnapshotLayer());
+    }
+};
+
+class StateSnapshot
+{
+    using layer_ptr_t = std::shared_ptr<const StateSnapshotLayer>;
+
+    const uint64_t block_number;
+    const Hash root_hash;
+
+    // newest first
+    const std::vector<layer_ptr_t> layers;
+
+    friend class StateSnapshots;
+
+  public:
+    StateSnapshot(uint64_t block_number,
+                  Hash const& root_hash,
+                  std::vector<layer_ptr_t>&& layers)
+        : block_number(block_number)
+        , root_hash(root_hash)
+        , layers(std::move(layers))
+    {}
+
+    std::optional<StorageObject> get_committed_value(
+        AddressAndKey const& key) const;
+
+    uint64_t get_block_number() const { return block_number; }
+
+    Hash const& get_root_hash() const { return root_hash; }
+
+    size_t num_layers() const { return layers.size(); }
+
+    // All of the snapshot's state in one layer, without tombstones.
+    // Expensive (copies everything); meant for background tasks.
+    std::shared_ptr<const StateSnapshotLayer> flatten() const;
+};
+
+/**
+ * Collects the values committed during one commit_modifications()
+ * call, from whichever threads apply the commit.
+ */
+class StateSnapshotLog
+{
+    using entry_t = StateSnapshotLayer::entry_t;
+
+    utils::ThreadlocalCache<std::vector<entry_t>, TLCACHE_SIZE> cache;
+
+  public:
+    void log(AddressAndKey const& key,
+             std::optional<StorageObject> const& committed)
+    {
+        cache.get().emplace_back(key, committed);
+    }
+
+    // not threadsafe with log()
+    std::shared_ptr<const StateSnapshotLayer> extract_layer();
+};
+
+class StateSnapshots : public utils::AsyncWorker
+{
+    using layer_ptr_t = std::shared_ptr<const StateSnapshotLayer>;
+
+    std::atomic<std::shared_ptr<const StateSnapshot>> latest;
+
+    // set by publish(), cleared by the compaction worker
+    bool compaction_requested = false;
+
+    bool exists_work_to_do() override final
+    {
+        return compaction_requested;
+    }
+
+    void run();
+
+    // returns nullptr if no adjacent layers should be merged
+    std::shared_ptr<const StateSnapshot>
+    compact_once(std::shared_ptr<const StateSnapshot> const& base);
+
+  public:
+    StateSnapshots();
+
+    ~StateSnapshots() { terminate_worker(); }
+
+    // Readers hold the returned pointer for as long as they read.
+    // Never null (an empty snapshot at block 0 before any publish).
+    std::shared_ptr<const StateSnapshot> pin() const
+    {
+        return latest.load(std::memory_order_acquire);
+    }
+
+    // Called once per committed block, in block order.
+    void publish(uint64_t block_number,
+                 Hash const& root_hash,
+                 layer_ptr_t layer);
+
+    using AsyncWorker::wait_for_async_task;
+};
+
+} // namespace scs
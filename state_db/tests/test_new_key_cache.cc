@@ -0,0 +1,267 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "object/make_delta.h"
+
+#include "state_db/new_key_cache.h"
+
+#include "threadlocal/threadlocal_context.h"
+
+#include "test_utils/paired_workers.h"
+
+#include "xdr/storage_delta.h"
+
+#include <bit>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace scs {
+
+namespace {
+
+AddressAndKey
+make_new_key(uint64_t i)
+{
+    AddressAndKey out;
+    std::memset(out.data(), 0, out.size());
+    std::memcpy(out.data() + 8, &i, sizeof(i));
+    return out;
+}
+
+// credits key i with amount, and commits the delta
+bool
+credit_new_key(NewKeyCache& cache, uint64_t i, int64_t amount)
+{
+    auto res = cache.try_reserve_delta(
+        make_new_key(i), make_nonnegative_int64_set_add(0, amount));
+    if (!res) {
+        return false;
+    }
+    res->commit();
+    return true;
+}
+
+// Every key is created concurrently by two threads,
+// and must end up as one object with both credits.
+void
+run_new_keys(NewKeyCache& cache, uint32_t num_threads, uint32_t per_thread)
+{
+    const uint32_t num_keys = num_threads * per_thread;
+
+    auto res = test::run_paired_workers(
+        num_threads, per_thread, [&](uint32_t i) {
+            return credit_new_key(cache, i, 1);
+        });
+
+    std::printf("new key cache: %" PRIu32 " threads, %" PRIu32
+                " new keys in %.3f ms (%.1f ns/delta)\n",
+                num_threads,
+                num_keys,
+                res.elapsed_ns / 1'000'000.0,
+                static_cast<double>(res.elapsed_ns) / (2 * num_keys));
+
+    REQUIRE(res.successes == 2 * num_keys);
+
+    cache.finalize_modifications();
+
+    for (uint32_t i = 0; i < num_keys; i++) {
+        auto const& obj = cache.commit_and_get(make_new_key(i));
+        REQUIRE(!!obj);
+        REQUIRE(obj->body.nonnegative_int64() == 2);
+    }
+
+    REQUIRE(!cache.commit_and_get(make_new_key(num_keys)));
+}
+
+} // namespace
+
+TEST_CASE("new key cache single thread", "[statedb]")
+{
+    test::DeferredContextClear defer;
+
+    auto cache = std::make_unique<NewKeyCache>();
+
+    auto key = make_new_key(1);
+
+    {
+        auto res = cache->try_reserve_delta(key, make_nonnegative_int64_set_add(0, 5));
+        REQUIRE(!!res);
+        res->commit();
+    }
+    {
+        // reverted
+        auto res = cache->try_reserve_delta(make_new_key(2), make_nonnegative_int64_set_add(0, 5));
+        REQUIRE(!!res);
+    }
+
+    REQUIRE_THROWS(cache->commit_and_get(key));
+
+    cache->finalize_modifications();
+
+    REQUIRE_THROWS(cache->try_reserve_delta(key, make_nonnegative_int64_set_add(0, 1)));
+
+    REQUIRE(cache->commit_and_get(key)->body.nonnegative_int64() == 5);
+    REQUIRE(!cache->commit_and_get(make_new_key(2)));
+    REQUIRE(!cache->commit_and_get(make_new_key(3)));
+
+    cache->clear_for_next_block();
+
+    REQUIRE_THROWS(cache->commit_and_get(key));
+    cache->finalize_modifications();
+    REQUIRE(!cache->commit_and_get(key));
+}
+
+TEST_CASE("new key cache concurrent", "[statedb]")
+{
+    test::DeferredContextClear defer;
+
+    auto cache = std::make_unique<NewKeyCache>();
+
+    // second block reuses the recycled objects,
+    // and runs with a table sized from the first block
+    for (uint32_t block = 0; block < 2; block++) {
+        run_new_keys(*cache, 4, 50'000);
+        cache->clear_for_next_block();
+    }
+}
+
+TEST_CASE("new key cache overflow", "[statedb]")
+{
+    test::DeferredContextClear defer;
+
+    auto cache = std::make_unique<NewKeyCache>();
+
+    // first block, so the table is the minimum size,
+    // and fills up long before the last key
+    const uint32_t table_size = cache->get_table_size();
+    REQUIRE(table_size == NewKeyCache::get_min_table_size());
+    const uint32_t num_keys = 4 * table_size;
+
+    for (uint32_t i = 0; i < num_keys; i++) {
+        REQUIRE(credit_new_key(*cache, i, i % 7 + 1));
+    }
+    REQUIRE(cache->num_overflow_keys() >= num_keys - table_size);
+
+    // finds the same entry, wherever the key went
+    for (uint32_t i = 0; i < num_keys; i++) {
+        REQUIRE(credit_new_key(*cache, i, 1));
+    }
+    REQUIRE(cache->num_overflow_keys() >= num_keys - table_size);
+    REQUIRE(cache->num_overflow_keys() <= num_keys);
+
+    cache->finalize_modifications();
+
+    for (uint32_t i = 0; i < num_keys; i++) {
+        auto const& obj = cache->commit_and_get(make_new_key(i));
+        REQUIRE(!!obj);
+        REQUIRE(obj->body.nonnegative_int64() == i % 7 + 2);
+    }
+    REQUIRE(!cache->commit_and_get(make_new_key(num_keys)));
+}
+
+TEST_CASE("new key cache resizes per block", "[statedb]")
+{
+    test::DeferredContextClear defer;
+
+    auto cache = std::make_unique<NewKeyCache>();
+
+    const uint32_t min_size = NewKeyCache::get_min_table_size();
+    const uint32_t num_keys = 100'000;
+    // 1/4 load
+    const uint32_t sized = std::bit_ceil(4 * num_keys);
+
+    auto run_block = [&](uint32_t first_key, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            REQUIRE(credit_new_key(*cache, first_key + i, 1));
+        }
+        cache->finalize_modifications();
+        cache->clear_for_next_block();
+    };
+
+    run_block(0, num_keys);
+    REQUIRE(cache->get_table_size() == sized);
+
+    // a block like the last fits in the table
+    for (uint32_t i = 0; i < num_keys; i++) {
+        REQUIRE(credit_new_key(*cache, num_keys + i, 1));
+    }
+    REQUIRE(cache->num_overflow_keys() == 0);
+    cache->finalize_modifications();
+    cache->clear_for_next_block();
+    REQUIRE(cache->get_table_size() == sized);
+
+    // shrinks back after a quiet block
+    run_block(0, 10);
+    REQUIRE(cache->get_table_size() == min_size);
+}
+
+TEST_CASE("new key cache recycles objects", "[statedb]")
+{
+    test::DeferredContextClear defer;
+
+    auto cache = std::make_unique<NewKeyCache>();
+
+    const uint32_t num_keys = 1000;
+
+    for (uint32_t i = 0; i < num_keys; i++) {
+        REQUIRE(credit_new_key(*cache, i, 5));
+    }
+    {
+        // reverted
+        auto res = cache->try_reserve_delta(make_new_key(2 * num_keys),
+                                            make_nonnegative_int64_set_add(0, 5));
+        REQUIRE(!!res);
+    }
+    cache->finalize_modifications();
+    for (uint32_t i = 0; i < num_keys; i++) {
+        REQUIRE(cache->commit_and_get(make_new_key(i))->body.nonnegative_int64() == 5);
+    }
+    cache->clear_for_next_block();
+
+    // the next block's keys get the same (recycled) objects,
+    // which must not remember the last block's values
+    for (uint32_t i = 0; i <= num_keys; i++) {
+        REQUIRE(credit_new_key(*cache, num_keys + i, 1));
+    }
+    cache->finalize_modifications();
+
+    for (uint32_t i = 0; i <= num_keys; i++) {
+        auto const& obj = cache->commit_and_get(make_new_key(num_keys + i));
+        REQUIRE(!!obj);
+        REQUIRE(obj->body.nonnegative_int64() == 1);
+    }
+    for (uint32_t i = 0; i < num_keys; i++) {
+        REQUIRE(!cache->commit_and_get(make_new_key(i)));
+    }
+}
+
+TEST_CASE("new key cache 1M keys", "[.][statedb][bench]")
+{
+    test::DeferredContextClear defer;
+
+    auto cache = std::make_unique<NewKeyCache>();
+
+    for (uint32_t block = 0; block < 2; block++) {
+        run_new_keys(*cache, 96, 1'000'000 / 96);
+        cache->clear_for_next_block();
+    }
+}
+
+} // namespace scs
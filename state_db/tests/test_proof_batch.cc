@@ -0,0 +1,119 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "state_db/proof_batch.h"
+
+#include <algorithm>
+
+namespace scs {
+
+namespace test {
+
+// stand-in for a serialized trie proof: one 32-byte "node"
+// per 4-bit level of the key, root first, then the key itself
+proof_bytes_t
+proof_batch_fake_proof(uint32_t key)
+{
+    proof_bytes_t out;
+    for (int32_t shift = 28; shift >= 0; shift -= 4) {
+        uint32_t node = key >> shift;
+        for (uint32_t i = 0; i < 32; i++) {
+            out.push_back(static_cast<uint8_t>((node * 0x9E37'79B9u) >> (i % 4 * 8)) ^ i);
+        }
+    }
+    for (uint32_t i = 0; i < 4; i++) {
+        out.push_back(static_cast<uint8_t>(key >> (8 * i)));
+    }
+    return out;
+}
+
+} // namespace test
+
+using namespace test;
+
+TEST_CASE("proof batch roundtrip", "[proof_batch]")
+{
+    std::vector<uint32_t> keys;
+    for (uint32_t i = 0; i < 5000; i++) {
+        keys.push_back(i * 7919 + (i % 3));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    auto batch = make_proof_batch(keys, proof_batch_fake_proof);
+
+    size_t total_single = 0;
+    for (auto k : keys) {
+        total_single += proof_batch_fake_proof(k).size();
+    }
+    // shared upper levels are stored once per run of keys
+    REQUIRE(3 * batch.size() < 2 * total_single);
+
+    auto decoded = decode_proof_batch(batch);
+    REQUIRE(!!decoded);
+    REQUIRE(decoded->size() == keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        REQUIRE((*decoded)[i] == proof_batch_fake_proof(keys[i]));
+    }
+
+    REQUIRE(verify_proof_batch(batch, keys.size(), [&](size_t i, proof_bytes_t const& pf) {
+        return pf == proof_batch_fake_proof(keys[i]);
+    }));
+
+    REQUIRE(!verify_proof_batch(batch, keys.size() + 1, [&](size_t, proof_bytes_t const&) {
+        return true;
+    }));
+
+    REQUIRE(!verify_proof_batch(batch, keys.size(), [&](size_t i, proof_bytes_t const& pf) {
+        return i != 1234;
+    }));
+}
+
+TEST_CASE("proof batch empty and malformed", "[proof_batch]")
+{
+    std::vector<uint32_t> none;
+    auto empty = make_proof_batch(none, proof_batch_fake_proof);
+    auto decoded = decode_proof_batch(empty);
+    REQUIRE(!!decoded);
+    REQUIRE(decoded->empty());
+
+    std::vector<uint32_t> keys = {1, 2, 3, 100, 1000};
+    auto batch = make_proof_batch(keys, proof_batch_fake_proof);
+    REQUIRE(!!decode_proof_batch(batch));
+
+    SECTION("truncated")
+    {
+        batch.pop_back();
+        REQUIRE(!decode_proof_batch(batch));
+    }
+    SECTION("extended")
+    {
+        batch.push_back(0);
+        REQUIRE(!decode_proof_batch(batch));
+    }
+    SECTION("bad proof count")
+    {
+        batch[0] = 100;
+        REQUIRE(!decode_proof_batch(batch));
+    }
+    SECTION("oversized proof")
+    {
+        REQUIRE(!decode_proof_batch(batch, 100));
+    }
+}
+
+} // namespace scs
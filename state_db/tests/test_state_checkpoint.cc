@@ -0,0 +1,202 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "state_db/state_checkpoint.h"
+
+#include <utils/mkdir.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace scs {
+
+namespace test {
+
+AddressAndKey
+checkpoint_make_key(uint64_t v)
+{
+    AddressAndKey out;
+    out.fill(0);
+    for (size_t i = 0; i < sizeof(v); i++) {
+        out[sizeof(v) - 1 - i] = (v >> (8 * i)) & 0xFF;
+    }
+    return out;
+}
+
+std::optional<StorageObject>
+checkpoint_make_obj(int64_t v)
+{
+    StorageObject out;
+    out.body.type(ObjectType::NONNEGATIVE_INT64);
+    out.body.nonnegative_int64() = v;
+    return out;
+}
+
+// keys 0, 2, 4, ... (2n - 2), with value 10 * key
+std::shared_ptr<const StateSnapshotLayer>
+checkpoint_make_layer(size_t n)
+{
+    std::vector<StateSnapshotLayer::entry_t> entries;
+    for (size_t i = 0; i < n; i++) {
+        entries.emplace_back(checkpoint_make_key(2 * i), checkpoint_make_obj(20 * i));
+    }
+    return std::make_shared<const StateSnapshotLayer>(std::move(entries));
+}
+
+Hash
+checkpoint_make_hash(uint8_t v)
+{
+    Hash out;
+    out.fill(v);
+    return out;
+}
+
+} // namespace test
+
+using namespace test;
+
+TEST_CASE("checkpoint roundtrip", "[checkpoint]")
+{
+    const std::string folder = "test_checkpoint/";
+    utils::mkdir_safe(folder);
+    utils::clear_directory(folder);
+
+    AsyncIO io;
+
+    const size_t n = 3 * CHECKPOINT_INDEX_STRIDE + 5;
+    auto layer = checkpoint_make_layer(n);
+
+    auto filename = checkpoint_filename(folder, 17);
+    write_checkpoint(io, filename, 17, checkpoint_make_hash(3), *layer);
+
+    REQUIRE(list_checkpoints(folder) == std::vector<uint64_t>{ 17 });
+
+    SECTION("read back")
+    {
+        StateCheckpointReader reader(filename);
+        REQUIRE(reader.get_timestamp() == 17);
+        REQUIRE(reader.get_root_hash() == checkpoint_make_hash(3));
+        REQUIRE(reader.size() == n);
+        REQUIRE(reader.num_strides() == 4);
+
+        std::atomic<uint64_t> count = 0, bad = 0;
+        reader.parallel_for_each(
+            [&](size_t, AddressAndKey const& k, StorageObject&& obj) {
+                uint64_t key = 0;
+                for (size_t i = 0; i < 8; i++) {
+                    key = (key << 8) | k[i];
+                }
+                if (obj.body.nonnegative_int64() != static_cast<int64_t>(10 * key)) {
+                    bad++;
+                }
+                count++;
+            });
+        REQUIRE(count == n);
+        REQUIRE(bad == 0);
+
+        for (uint64_t k : { 0ul, 2ul, 2ul * CHECKPOINT_INDEX_STRIDE, 2ul * (n - 1) }) {
+            auto res = reader.find(checkpoint_make_key(k));
+            REQUIRE(!!res);
+            REQUIRE(res->body.nonnegative_int64() == static_cast<int64_t>(10 * k));
+        }
+        REQUIRE(!reader.find(checkpoint_make_key(1)));
+        REQUIRE(!reader.find(checkpoint_make_key(2 * n)));
+    }
+
+    SECTION("corruption detected")
+    {
+        int fd = ::open(filename.c_str(), O_RDWR);
+        REQUIRE(fd >= 0);
+        uint8_t byte;
+        off_t off = sizeof(CheckpointHeader) + 100;
+        REQUIRE(::pread(fd, &byte, 1, off) == 1);
+        byte ^= 1;
+        REQUIRE(::pwrite(fd, &byte, 1, off) == 1);
+        ::close(fd);
+
+        REQUIRE_THROWS(StateCheckpointReader(filename));
+    }
+
+    SECTION("truncation detected")
+    {
+        REQUIRE(::truncate(filename.c_str(), 1000) == 0);
+        REQUIRE_THROWS(StateCheckpointReader(filename, false));
+    }
+
+    SECTION("empty")
+    {
+        auto empty_file = checkpoint_filename(folder, 18);
+        write_checkpoint(io, empty_file, 18, checkpoint_make_hash(0), *StateSnapshotLayer::make_empty());
+        StateCheckpointReader reader(empty_file);
+        REQUIRE(reader.size() == 0);
+        REQUIRE(!reader.find(checkpoint_make_key(0)));
+    }
+
+    utils::clear_directory(folder);
+}
+
+TEST_CASE("checkpointer flattens snapshot and replaces old checkpoints", "[checkpoint]")
+{
+    const std::string folder = "test_checkpointer/";
+    utils::mkdir_safe(folder);
+    utils::clear_directory(folder);
+
+    std::vector<std::shared_ptr<const StateSnapshotLayer>> layers;
+    {
+        // newest first: overwrite key 0, delete key 2
+        std::vector<StateSnapshotLayer::entry_t> entries;
+        entries.emplace_back(checkpoint_make_key(0), checkpoint_make_obj(5));
+        entries.emplace_back(checkpoint_make_key(2), std::nullopt);
+        entries.emplace_back(checkpoint_make_key(1), checkpoint_make_obj(7));
+        layers.push_back(std::make_shared<const StateSnapshotLayer>(std::move(entries)));
+    }
+    layers.push_back(checkpoint_make_layer(100));
+
+    auto snapshot = std::make_shared<const StateSnapshot>(
+        20, checkpoint_make_hash(9), std::move(layers));
+
+    std::vector<uint64_t> durable;
+    {
+        StateCheckpointer checkpointer(folder, [&](uint64_t ts) { durable.push_back(ts); });
+
+        auto old_layer = checkpoint_make_layer(3);
+        REQUIRE(checkpointer.try_checkpoint(std::make_shared<const StateSnapshot>(
+            10, checkpoint_make_hash(1),
+            std::vector<std::shared_ptr<const StateSnapshotLayer>>{ old_layer })));
+        checkpointer.wait_for_async_task();
+
+        REQUIRE(checkpointer.try_checkpoint(snapshot));
+        checkpointer.wait_for_async_task();
+    }
+
+    REQUIRE(durable == std::vector<uint64_t>{ 10, 20 });
+    REQUIRE(list_checkpoints(folder) == std::vector<uint64_t>{ 20 });
+
+    StateCheckpointReader reader(checkpoint_filename(folder, 20));
+    REQUIRE(reader.size() == 100);
+    REQUIRE(reader.find(checkpoint_make_key(0))->body.nonnegative_int64() == 5);
+    REQUIRE(reader.find(checkpoint_make_key(1))->body.nonnegative_int64() == 7);
+    REQUIRE(!reader.find(checkpoint_make_key(2)));
+    REQUIRE(reader.find(checkpoint_make_key(4))->body.nonnegative_int64() == 40);
+
+    utils::clear_directory(folder);
+}
+
+} // namespace scs
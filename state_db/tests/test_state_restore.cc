@@ -0,0 +1,335 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "state_db/state_restore.h"
+
+#include "crypto/hash.h"
+#include "persistence/segment_log.h"
+#include "state_db/state_checkpoint.h"
+
+#include <utils/mkdir.h>
+
+#include <thread>
+
+namespace scs {
+
+namespace test {
+
+AddressAndKey
+restore_make_key(uint64_t v)
+{
+    AddressAndKey out;
+    out.fill(0);
+    // spread keys across partitions
+    out[0] = v & 0xFF;
+    for (size_t i = 0; i < sizeof(v); i++) {
+        out[1 + sizeof(v) - 1 - i] = (v >> (8 * i)) & 0xFF;
+    }
+    return out;
+}
+
+std::optional<StorageObject>
+restore_make_obj(int64_t v)
+{
+    StorageObject out;
+    out.body.type(ObjectType::NONNEGATIVE_INT64);
+    out.body.nonnegative_int64() = v;
+    return out;
+}
+
+BlockHeader
+restore_make_header(uint64_t block_number,
+                    BlockHeader const* prev,
+                    uint8_t state_hash)
+{
+    BlockHeader out;
+    out.block_number = block_number;
+    if (prev) {
+        out.prev_header_hash = hash_xdr(*prev);
+    }
+    out.state_db_hash.fill(state_hash);
+    return out;
+}
+
+std::shared_ptr<const StateSnapshotLayer>
+restore_make_layer(std::vector<std::pair<uint64_t, std::optional<int64_t>>> const& kvs)
+{
+    std::vector<StateSnapshotLayer::entry_t> entries;
+    for (auto const& [k, v] : kvs) {
+        entries.emplace_back(restore_make_key(k),
+                             v ? restore_make_obj(*v) : std::nullopt);
+    }
+    return std::make_shared<const StateSnapshotLayer>(std::move(entries));
+}
+
+void
+restore_log_block(SegmentLog& log,
+                  uint64_t ts,
+                  BlockHeader const& header,
+                  StateSnapshotLayer const& delta)
+{
+    // stands in for the trie's serialization, which restores skip
+    std::vector<std::vector<uint8_t>> trie_bytes(2, std::vector<uint8_t>(37, 0xAB));
+    log.append(ts, encode_block_restore_record(header, delta), trie_bytes);
+}
+
+} // namespace test
+
+using namespace test;
+
+TEST_CASE("block restore record roundtrip", "[restore]")
+{
+    auto header = restore_make_header(5, nullptr, 7);
+    auto delta = restore_make_layer({ { 1, 10 }, { 2, std::nullopt }, { 300, 30 } });
+
+    auto bytes = encode_block_restore_record(header, *delta);
+    // trailing bytes (the trie's) are ignored
+    bytes.resize(bytes.size() + 100, 0xFF);
+
+    auto res = decode_block_restore_record(bytes, true);
+    REQUIRE(res.header.block_number == 5);
+    REQUIRE(res.header.state_db_hash == header.state_db_hash);
+    REQUIRE(res.delta->size() == 3);
+    REQUIRE(res.delta->find(restore_make_key(1))->value().body.nonnegative_int64() == 10);
+    REQUIRE(!res.delta->find(restore_make_key(2))->has_value());
+
+    REQUIRE(!decode_block_restore_record(bytes, false).delta);
+
+    std::vector<uint8_t> no_record(100, 0);
+    REQUIRE_THROWS(decode_block_restore_record(no_record, false));
+}
+
+TEST_CASE("restore record log", "[restore]")
+{
+    RestoreRecordLog restore_log;
+
+    auto header = restore_make_header(5, nullptr, 7);
+
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < 4; t++) {
+        threads.emplace_back([&, t] {
+            for (uint64_t i = t; i < 1000; i += 4) {
+                restore_log.log(restore_make_key(i),
+                                (i % 10 == 0) ? std::nullopt : restore_make_obj(i));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    auto res = decode_block_restore_record(restore_log.extract_record(header), true);
+    REQUIRE(res.header.block_number == 5);
+    REQUIRE(res.delta->size() == 1000);
+    REQUIRE(res.delta->find(restore_make_key(7))->value().body.nonnegative_int64() == 7);
+    REQUIRE(!res.delta->find(restore_make_key(10))->has_value());
+
+    // extracting resets the log
+    auto empty = decode_block_restore_record(restore_log.extract_record(header), true);
+    REQUIRE(empty.delta->size() == 0);
+}
+
+TEST_CASE("load persisted state", "[restore]")
+{
+    const std::string folder = "test_restore/";
+    utils::mkdir_safe(folder);
+    utils::clear_directory(folder);
+
+    SECTION("nothing persisted")
+    {
+        REQUIRE(!load_persisted_state(folder));
+    }
+
+    // block 10 is checkpointed: keys 0..999, value 2 * key
+    std::vector<std::pair<uint64_t, std::optional<int64_t>>> base_kvs;
+    for (uint64_t i = 0; i < 1000; i++) {
+        base_kvs.emplace_back(i, 2 * i);
+    }
+    auto h10 = restore_make_header(10, nullptr, 10);
+    auto base = restore_make_layer(base_kvs);
+
+    auto h11 = restore_make_header(11, &h10, 11);
+    auto d11 = restore_make_layer({ { 0, 100 }, { 1, std::nullopt }, { 5000, 5 } });
+    auto h12 = restore_make_header(12, &h11, 12);
+    auto d12 = restore_make_layer({ { 0, 200 }, { 5000, std::nullopt }, { 1, 1 } });
+
+    SECTION("checkpoint and log tail")
+    {
+        {
+            AsyncIO io;
+            write_checkpoint(io, checkpoint_filename(folder, 10), 10, h10.state_db_hash, *base);
+
+            SegmentLog log(folder, 2 * DIRECT_IO_ALIGNMENT);
+            // covered by the checkpoint, so its (wrong) values are skipped
+            restore_log_block(log, 9, restore_make_header(9, nullptr, 9), *restore_make_layer({ { 7, -1 } }));
+            restore_log_block(log, 10, h10, *StateSnapshotLayer::make_empty());
+            restore_log_block(log, 11, h11, *d11);
+            restore_log_block(log, 12, h12, *d12);
+            // a restart logs the restored block again
+            restore_log_block(log, 12, h12, *StateSnapshotLayer::make_empty());
+            log.sync();
+        }
+
+        auto res = load_persisted_state(folder);
+        REQUIRE(!!res);
+        REQUIRE(res->timestamp == 12);
+        REQUIRE(res->header.block_number == 12);
+        REQUIRE(res->state->size() == 1000);
+
+        REQUIRE(res->state->find(restore_make_key(0))->value().body.nonnegative_int64() == 200);
+        REQUIRE(res->state->find(restore_make_key(1))->value().body.nonnegative_int64() == 1);
+        REQUIRE(res->state->find(restore_make_key(7))->value().body.nonnegative_int64() == 14);
+        REQUIRE(res->state->find(restore_make_key(999))->value().body.nonnegative_int64() == 1998);
+        REQUIRE(res->state->find(restore_make_key(5000)) == nullptr);
+
+        // sorted, no tombstones
+        auto const& entries = res->state->get_entries();
+        for (size_t i = 0; i < entries.size(); i++) {
+            REQUIRE(entries[i].second.has_value());
+            if (i > 0) {
+                REQUIRE(entries[i - 1].first < entries[i].first);
+            }
+        }
+    }
+
+    auto write_checkpoint_and_tail = [&] {
+        AsyncIO io;
+        write_checkpoint(io, checkpoint_filename(folder, 10), 10, h10.state_db_hash, *base);
+
+        SegmentLog log(folder);
+        restore_log_block(log, 10, h10, *StateSnapshotLayer::make_empty());
+        restore_log_block(log, 11, h11, *d11);
+        restore_log_block(log, 12, h12, *d12);
+        log.sync();
+    };
+
+    SECTION("bounded by timestamp")
+    {
+        write_checkpoint_and_tail();
+
+        auto res = load_persisted_state(folder, 11);
+        REQUIRE(!!res);
+        REQUIRE(res->timestamp == 11);
+        REQUIRE(res->header.block_number == 11);
+        REQUIRE(res->state->size() == 1000);
+        REQUIRE(res->state->find(restore_make_key(0))->value().body.nonnegative_int64() == 100);
+        REQUIRE(res->state->find(restore_make_key(1)) == nullptr);
+        REQUIRE(res->state->find(restore_make_key(5000))->value().body.nonnegative_int64() == 5);
+    }
+
+    SECTION("checkpoint from logs")
+    {
+        write_checkpoint_and_tail();
+
+        std::vector<uint64_t> durable;
+        {
+            StateCheckpointer checkpointer(folder, [&](uint64_t ts) { durable.push_back(ts); });
+
+            // logs not durable yet, so skipped
+            REQUIRE(checkpointer.try_checkpoint_from_logs(12, [] { return false; }));
+            checkpointer.wait_for_async_task();
+            REQUIRE(durable.empty());
+
+            REQUIRE(checkpointer.try_checkpoint_from_logs(12, [] { return true; }));
+            checkpointer.wait_for_async_task();
+        }
+        REQUIRE(durable == std::vector<uint64_t>{ 12 });
+        REQUIRE(list_checkpoints(folder) == std::vector<uint64_t>{ 12 });
+
+        StateCheckpointReader reader(checkpoint_filename(folder, 12));
+        REQUIRE(reader.get_root_hash() == h12.state_db_hash);
+        REQUIRE(reader.size() == 1000);
+        REQUIRE(reader.find(restore_make_key(0))->body.nonnegative_int64() == 200);
+        REQUIRE(reader.find(restore_make_key(1))->body.nonnegative_int64() == 1);
+        REQUIRE(!reader.find(restore_make_key(5000)));
+
+        auto res = load_persisted_state(folder);
+        REQUIRE(!!res);
+        REQUIRE(res->timestamp == 12);
+        REQUIRE(res->state->size() == 1000);
+    }
+
+    SECTION("log only")
+    {
+        {
+            SegmentLog log(folder);
+            restore_log_block(log, 11, h11, *d11);
+            restore_log_block(log, 12, h12, *d12);
+            log.sync();
+        }
+        auto res = load_persisted_state(folder);
+        REQUIRE(!!res);
+        REQUIRE(res->state->size() == 2);
+        REQUIRE(res->state->find(restore_make_key(1))->value().body.nonnegative_int64() == 1);
+    }
+
+    SECTION("checkpoint only")
+    {
+        {
+            AsyncIO io;
+            write_checkpoint(io, checkpoint_filename(folder, 10), 10, h10.state_db_hash, *base);
+            SegmentLog log(folder);
+            restore_log_block(log, 10, h10, *StateSnapshotLayer::make_empty());
+            log.sync();
+        }
+        auto res = load_persisted_state(folder);
+        REQUIRE(!!res);
+        REQUIRE(res->timestamp == 10);
+        REQUIRE(res->state->size() == 1000);
+    }
+
+    SECTION("gap in log")
+    {
+        {
+            AsyncIO io;
+            write_checkpoint(io, checkpoint_filename(folder, 10), 10, h10.state_db_hash, *base);
+            SegmentLog log(folder);
+            restore_log_block(log, 10, h10, *StateSnapshotLayer::make_empty());
+            restore_log_block(log, 12, h12, *d12);
+            log.sync();
+        }
+        REQUIRE_THROWS(load_persisted_state(folder));
+    }
+
+    SECTION("checkpoint mismatches header")
+    {
+        {
+            AsyncIO io;
+            write_checkpoint(io, checkpoint_filename(folder, 10), 10, h11.state_db_hash, *base);
+            SegmentLog log(folder);
+            restore_log_block(log, 10, h10, *StateSnapshotLayer::make_empty());
+            log.sync();
+        }
+        REQUIRE_THROWS(load_persisted_state(folder));
+    }
+
+    SECTION("log without restore records")
+    {
+        {
+            SegmentLog log(folder);
+            std::vector<std::vector<uint8_t>> trie_bytes(1, std::vector<uint8_t>(100, 0));
+            log.append(3, trie_bytes);
+            log.sync();
+        }
+        REQUIRE_THROWS(load_persisted_state(folder));
+    }
+
+    utils::clear_directory(folder);
+}
+
+} // namespace scs
@@ -0,0 +1,189 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "state_db/state_snapshot.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace scs {
+
+namespace test {
+
+AddressAndKey
+snapshot_make_key(uint64_t v)
+{
+    AddressAndKey out;
+    out.fill(0);
+    // big endian, so that keys sort in numeric order
+    for (size_t i = 0; i < sizeof(v); i++) {
+        out[sizeof(v) - 1 - i] = (v >> (8 * i)) & 0xFF;
+    }
+    return out;
+}
+
+StorageObject
+snapshot_make_obj(int64_t v)
+{
+    StorageObject out;
+    out.body.type(ObjectType::NONNEGATIVE_INT64);
+    out.body.nonnegative_int64() = v;
+    return out;
+}
+
+std::shared_ptr<const StateSnapshotLayer>
+snapshot_make_layer(std::vector<std::pair<uint64_t, std::optional<int64_t>>> const& kvs)
+{
+    std::vector<StateSnapshotLayer::entry_t> entries;
+    for (auto const& [k, v] : kvs) {
+        if (v) {
+            entries.emplace_back(snapshot_make_key(k), snapshot_make_obj(*v));
+        } else {
+            entries.emplace_back(snapshot_make_key(k), std::nullopt);
+        }
+    }
+    return std::make_shared<const StateSnapshotLayer>(std::move(entries));
+}
+
+std::optional<int64_t>
+snapshot_read(StateSnapshot const& snap, uint64_t k)
+{
+    auto res = snap.get_committed_value(snapshot_make_key(k));
+    if (!res) {
+        return std::nullopt;
+    }
+    return res->body.nonnegative_int64();
+}
+
+} // namespace test
+
+using namespace test;
+
+TEST_CASE("snapshot layer merge", "[snapshot]")
+{
+    auto older = snapshot_make_layer({{5, 50}, {1, 10}, {3, 30}});
+    auto newer = snapshot_make_layer({{3, std::nullopt}, {4, 40}, {1, 11}});
+
+    REQUIRE(newer->find(snapshot_make_key(2)) == nullptr);
+    REQUIRE(newer->find(snapshot_make_key(3)) != nullptr);
+    REQUIRE(!*newer->find(snapshot_make_key(3)));
+
+    SECTION("keep tombstones")
+    {
+        auto merged = StateSnapshotLayer::merge(*newer, *older, false);
+        REQUIRE(merged->size() == 4);
+        REQUIRE(merged->find(snapshot_make_key(1))->value().body.nonnegative_int64() == 11);
+        REQUIRE(!*merged->find(snapshot_make_key(3)));
+    }
+    SECTION("drop tombstones")
+    {
+        auto merged = StateSnapshotLayer::merge(*newer, *older, true);
+        REQUIRE(merged->size() == 3);
+        REQUIRE(merged->find(snapshot_make_key(3)) == nullptr);
+        REQUIRE(merged->find(snapshot_make_key(5))->value().body.nonnegative_int64() == 50);
+    }
+}
+
+TEST_CASE("pinned snapshots survive later blocks", "[snapshot]")
+{
+    StateSnapshots snapshots;
+
+    REQUIRE(snapshots.pin()->get_block_number() == 0);
+    REQUIRE(!snapshot_read(*snapshots.pin(), 1));
+
+    snapshots.publish(1, Hash(), snapshot_make_layer({{1, 10}, {2, 20}}));
+    auto pinned = snapshots.pin();
+
+    for (uint64_t b = 2; b < 100; b++) {
+        snapshots.publish(b, Hash(), snapshot_make_layer({{1, static_cast<int64_t>(b)}, {b + 1, std::nullopt}}));
+    }
+    snapshots.wait_for_async_task();
+
+    REQUIRE(pinned->get_block_number() == 1);
+    REQUIRE(snapshot_read(*pinned, 1) == 10);
+    REQUIRE(snapshot_read(*pinned, 2) == 20);
+
+    auto cur = snapshots.pin();
+    REQUIRE(cur->get_block_number() == 99);
+    REQUIRE(snapshot_read(*cur, 1) == 99);
+    REQUIRE(snapshot_read(*cur, 2) == 20);
+    // deleted in block 2
+    REQUIRE(!snapshot_read(*cur, 3));
+
+    // compaction keeps the number of layers logarithmic
+    REQUIRE(cur->num_layers() <= 8);
+}
+
+TEST_CASE("concurrent readers see consistent blocks", "[snapshot]")
+{
+    constexpr uint64_t num_keys = 1000;
+    constexpr uint64_t num_blocks = 200;
+    constexpr uint32_t num_readers = 4;
+
+    StateSnapshots snapshots;
+
+    std::atomic<bool> done = false;
+    std::atomic<uint32_t> errors = 0;
+
+    std::vector<std::thread> readers;
+    for (uint32_t t = 0; t < num_readers; t++) {
+        readers.emplace_back([&, t]() {
+            uint64_t k = t;
+            while (!done.load(std::memory_order_relaxed)) {
+                auto snap = snapshots.pin();
+                uint64_t b = snap->get_block_number();
+
+                // block b writes key (b % num_keys) = b on top of
+                // every key k set to the block that last wrote it
+                k = (k + 7) % num_keys;
+                auto v = snapshot_read(*snap, k);
+
+                uint64_t last_write = 0;
+                for (uint64_t i = 1; i <= b; i++) {
+                    if (i % num_keys == k) {
+                        last_write = i;
+                    }
+                }
+                if (last_write == 0) {
+                    if (v) {
+                        errors++;
+                    }
+                } else if (v != static_cast<int64_t>(last_write)) {
+                    errors++;
+                }
+            }
+        });
+    }
+
+    for (uint64_t b = 1; b <= num_blocks; b++) {
+        snapshots.publish(b, Hash(), snapshot_make_layer({{b % num_keys, static_cast<int64_t>(b)}}));
+    }
+    snapshots.wait_for_async_task();
+
+    done = true;
+    for (auto& r : readers) {
+        r.join();
+    }
+
+    REQUIRE(errors == 0);
+    REQUIRE(snapshots.pin()->get_block_number() == num_blocks);
+}
+
+} // namespace scs
@@ -234,13 +234,11 @@ ProxyApplicator::try_apply(StorageDelta const& d)
         {
         	make_current(ObjectType::HASH_SET);
 
-        	for (auto const& h : current -> body.hash_set().hashes)
-        	{
-        		if (h == d.hash())
-        		{
-        			return false;
-        		}
-        	}
+            // committed hashsets are normalized, and we maintain that here
+            if (hashset_contains(current -> body.hash_set(), d.hash()))
+            {
+                return false;
+            }
 
         	if (current -> body.hash_set().hashes.size() >= current -> body.hash_set().max_size)
         	{
@@ -252,8 +250,12 @@ ProxyApplicator::try_apply(StorageDelta const& d)
                 return false;
             }
 
-        	current -> body.hash_set().hashes.push_back(d.hash());
-            normalize_hashset(current -> body.hash_set());
+            {
+                auto& h_list = current -> body.hash_set().hashes;
+                h_list.insert(
+                    std::upper_bound(h_list.begin(), h_list.end(), d.hash(), std::greater<HashSetEntry>()),
+                    d.hash());
+            }
         	new_hashes.push_back(d.hash());
         	return true;
         }
@@ -52,13 +52,12 @@ PROXY_TEMPLATE
 StorageProxy<StateDB_t>::value_t& 
 StorageProxy<StateDB_t>::get_local(AddressAndKey const& key) const
 {
-	auto it = cache.find(key);
-	if (it == cache.end())
+	auto* v = cache.find(key);
+	if (v == nullptr)
 	{
-		auto res = state_db.get_committed_value(key);
-		it = cache.emplace(key, res).first;
+		return cache.try_emplace(key, state_db.get_committed_value(key)).first;
 	}
-	return it->second;
+	return *v;
 }
 
 PROXY_TEMPLATE
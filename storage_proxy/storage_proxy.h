@@ -20,10 +20,10 @@
 #include "xdr/types.h"
 
 #include "storage_proxy/storage_proxy_value.h"
+#include "storage_proxy/storage_proxy_cache.h"
 
 #include <cstdint>
 #include <vector>
-#include <map>
 
 namespace scs
 {
@@ -39,7 +39,7 @@ class StorageProxy
 
 	using value_t = StorageProxyValue;
 
-	mutable std::map<AddressAndKey, value_t> cache;
+	mutable StorageProxyCache<value_t> cache;
 
 	value_t& get_local(AddressAndKey const& key) const;
 
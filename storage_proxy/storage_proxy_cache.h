@@ -0,0 +1,342 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "xdr/types.h"
+
+#include <utils/non_movable.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace scs
+{
+
+/**
+ * Per-transaction map from AddressAndKey to proxy values.
+ *
+ * Open addressing (linear probing) over an index of entry offsets.
+ * The first INLINE_ENTRIES entries (and their index) live inline
+ * in the object, since most transactions touch only a few keys.
+ * Entries past that go into geometrically growing segments,
+ * so references to values are stable until clear().
+ *
+ * Overflow segments and the overflow index are returned
+ * to a thread-local pool on clear(), and the next cache on
+ * that thread picks them up instead of reallocating.
+ *
+ * Iteration is in insertion order.
+ */
+template<typename value_t, uint32_t INLINE_ENTRIES = 8>
+class StorageProxyCache : public utils::NonMovableOrCopyable
+{
+	static_assert(INLINE_ENTRIES > 0 && (INLINE_ENTRIES & (INLINE_ENTRIES - 1)) == 0,
+		"inline size must be a power of two");
+
+public:
+
+	struct entry_t
+	{
+		const AddressAndKey key;
+		value_t value;
+
+		template<typename... Args>
+		entry_t(AddressAndKey const& key, Args&&... args)
+			: key(key)
+			, value(std::forward<Args>(args)...)
+			{}
+	};
+
+private:
+
+	struct alignas(entry_t) slot_t
+	{
+		std::byte buf[sizeof(entry_t)];
+	};
+
+	using segment_t = std::unique_ptr<slot_t[]>;
+
+	// index entries are (entry offset + 1), 0 is empty
+	constexpr static uint32_t INLINE_INDEX_SIZE = 2 * INLINE_ENTRIES;
+
+	struct RecycledBuffers
+	{
+		std::vector<segment_t> segments;
+		std::vector<uint32_t> index;
+	};
+
+	static RecycledBuffers& get_recycled()
+	{
+		static thread_local RecycledBuffers recycled;
+		return recycled;
+	}
+
+	slot_t inline_entries[INLINE_ENTRIES];
+	uint32_t inline_index[INLINE_INDEX_SIZE];
+
+	// segment i holds (INLINE_ENTRIES << i) entries
+	std::vector<segment_t> segments;
+	std::vector<uint32_t> overflow_index;
+
+	uint32_t num_entries = 0;
+
+	uint32_t* get_index()
+	{
+		return overflow_index.empty() ? inline_index : overflow_index.data();
+	}
+
+	const uint32_t* get_index() const
+	{
+		return overflow_index.empty() ? inline_index : overflow_index.data();
+	}
+
+	uint32_t index_mask() const
+	{
+		return (overflow_index.empty() ? INLINE_INDEX_SIZE : overflow_index.size()) - 1;
+	}
+
+	static uint64_t hash(AddressAndKey const& key)
+	{
+		// Not cryptographic -- the index is per-transaction and
+		// (2x) oversized, so adversarial collisions only cost the
+		// attacking tx (who pays gas for each key) more probes.
+		uint64_t h = 0;
+		for (size_t i = 0; i < sizeof(AddressAndKey); i += sizeof(uint64_t))
+		{
+			uint64_t word;
+			std::memcpy(&word, key.data() + i, sizeof(uint64_t));
+			h = (h ^ word) * 0x9E37'79B9'7F4A'7C15ull;
+		}
+		return h ^ (h >> 32);
+	}
+
+	slot_t& get_slot(uint32_t offset)
+	{
+		if (offset < INLINE_ENTRIES)
+		{
+			return inline_entries[offset];
+		}
+		uint32_t overflow_offset = offset - INLINE_ENTRIES;
+		uint32_t q = overflow_offset / INLINE_ENTRIES + 1;
+		uint32_t seg = 31 - __builtin_clz(q);
+		uint32_t seg_start = INLINE_ENTRIES * ((1u << seg) - 1);
+		return segments[seg][overflow_offset - seg_start];
+	}
+
+	entry_t& get_entry(uint32_t offset)
+	{
+		return *std::launder(reinterpret_cast<entry_t*>(get_slot(offset).buf));
+	}
+
+	const entry_t& get_entry(uint32_t offset) const
+	{
+		return const_cast<StorageProxyCache*>(this)->get_entry(offset);
+	}
+
+	// returns the index slot holding key, or the empty slot where it would go
+	uint32_t probe(AddressAndKey const& key) const
+	{
+		const uint32_t* index = get_index();
+		const uint32_t mask = index_mask();
+
+		uint32_t pos = hash(key) & mask;
+		while(true)
+		{
+			uint32_t v = index[pos];
+			if (v == 0 || get_entry(v - 1).key == key)
+			{
+				return pos;
+			}
+			pos = (pos + 1) & mask;
+		}
+	}
+
+	void ensure_segment_for(uint32_t offset)
+	{
+		if (offset < INLINE_ENTRIES)
+		{
+			return;
+		}
+		uint32_t q = (offset - INLINE_ENTRIES) / INLINE_ENTRIES + 1;
+		uint32_t seg = 31 - __builtin_clz(q);
+
+		if (segments.size() > seg)
+		{
+			return;
+		}
+
+		auto& recycled = get_recycled().segments;
+		if (segments.empty() && !recycled.empty())
+		{
+			segments.swap(recycled);
+			if (segments.size() > seg)
+			{
+				return;
+			}
+		}
+		segments.emplace_back(new slot_t[INLINE_ENTRIES << seg]);
+	}
+
+	// called when the index would exceed a 1/2 load factor
+	void grow_index()
+	{
+		uint32_t new_size = 2 * (index_mask() + 1);
+
+		std::vector<uint32_t> new_index;
+		auto& recycled = get_recycled().index;
+		if (overflow_index.empty())
+		{
+			new_index.swap(recycled);
+		}
+		new_index.assign(new_size, 0);
+
+		overflow_index.swap(new_index);
+		const uint32_t mask = new_size - 1;
+		for (uint32_t i = 0; i < num_entries; i++)
+		{
+			uint32_t pos = hash(get_entry(i).key) & mask;
+			while (overflow_index[pos] != 0)
+			{
+				pos = (pos + 1) & mask;
+			}
+			overflow_index[pos] = i + 1;
+		}
+
+		if (new_index.capacity() > recycled.capacity())
+		{
+			recycled.swap(new_index);
+		}
+	}
+
+public:
+
+	StorageProxyCache()
+		: segments()
+		, overflow_index()
+	{
+		std::memset(inline_index, 0, sizeof(inline_index));
+	}
+
+	value_t* find(AddressAndKey const& key)
+	{
+		uint32_t v = get_index()[probe(key)];
+		if (v == 0)
+		{
+			return nullptr;
+		}
+		return &get_entry(v - 1).value;
+	}
+
+	template<typename... Args>
+	std::pair<value_t&, bool> try_emplace(AddressAndKey const& key, Args&&... args)
+	{
+		uint32_t pos = probe(key);
+		uint32_t v = get_index()[pos];
+		if (v != 0)
+		{
+			return {get_entry(v - 1).value, false};
+		}
+
+		if (2 * (num_entries + 1) > index_mask() + 1)
+		{
+			grow_index();
+			pos = probe(key);
+		}
+
+		uint32_t offset = num_entries;
+		ensure_segment_for(offset);
+
+		entry_t* e = new (get_slot(offset).buf) entry_t(key, std::forward<Args>(args)...);
+		num_entries++;
+		get_index()[pos] = offset + 1;
+		return {e->value, true};
+	}
+
+	uint32_t size() const
+	{
+		return num_entries;
+	}
+
+	void clear()
+	{
+		for (uint32_t i = 0; i < num_entries; i++)
+		{
+			get_entry(i).~entry_t();
+		}
+		num_entries = 0;
+		std::memset(inline_index, 0, sizeof(inline_index));
+
+		auto& recycled = get_recycled();
+		if (segments.size() > recycled.segments.size())
+		{
+			recycled.segments.swap(segments);
+		}
+		segments.clear();
+
+		if (overflow_index.capacity() > recycled.index.capacity())
+		{
+			recycled.index.swap(overflow_index);
+		}
+		overflow_index.clear();
+	}
+
+	~StorageProxyCache()
+	{
+		clear();
+	}
+
+	template<typename cache_ptr_t, typename entry_ref_t>
+	class iterator_base
+	{
+		cache_ptr_t cache;
+		uint32_t offset;
+
+	public:
+
+		iterator_base(cache_ptr_t cache, uint32_t offset)
+			: cache(cache)
+			, offset(offset)
+			{}
+
+		entry_ref_t operator*() const
+		{
+			return cache->get_entry(offset);
+		}
+
+		iterator_base& operator++()
+		{
+			offset++;
+			return *this;
+		}
+
+		bool operator==(iterator_base const& other) const = default;
+	};
+
+	using iterator = iterator_base<StorageProxyCache*, entry_t&>;
+	using const_iterator = iterator_base<const StorageProxyCache*, entry_t const&>;
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, num_entries); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, num_entries); }
+};
+
+} /* scs */
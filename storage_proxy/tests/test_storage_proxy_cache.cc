@@ -0,0 +1,127 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "storage_proxy/storage_proxy_cache.h"
+
+#include <map>
+
+namespace scs {
+
+namespace {
+
+AddressAndKey
+make_key(uint32_t addr, uint32_t key)
+{
+    AddressAndKey out;
+    out.fill(0);
+    std::memcpy(out.data(), &addr, sizeof(addr));
+    std::memcpy(out.data() + sizeof(Address), &key, sizeof(key));
+    return out;
+}
+
+} // namespace
+
+TEST_CASE("storage proxy cache", "[proxy]")
+{
+    std::map<AddressAndKey, uint64_t> expect;
+    std::vector<AddressAndKey> insert_order;
+
+    auto run_inserts = [&](StorageProxyCache<uint64_t>& cache, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            // some repeats
+            auto k = make_key(i % 3, (i * 7) % (count / 2 + 1));
+            auto [v, inserted] = cache.try_emplace(k, i);
+            auto [it, expect_inserted] = expect.try_emplace(k, i);
+
+            REQUIRE(inserted == expect_inserted);
+            REQUIRE(v == it->second);
+            if (inserted) {
+                insert_order.push_back(k);
+            }
+        }
+    };
+
+    auto check = [&](StorageProxyCache<uint64_t> const& cache) {
+        REQUIRE(cache.size() == expect.size());
+
+        uint32_t i = 0;
+        for (auto const& [k, v] : cache) {
+            REQUIRE(k == insert_order[i]);
+            REQUIRE(v == expect[k]);
+            i++;
+        }
+        REQUIRE(i == insert_order.size());
+    };
+
+    SECTION("inline only")
+    {
+        StorageProxyCache<uint64_t> cache;
+        run_inserts(cache, 8);
+        check(cache);
+    }
+
+    SECTION("overflow")
+    {
+        StorageProxyCache<uint64_t> cache;
+        run_inserts(cache, 1000);
+        check(cache);
+
+        for (auto const& [k, v] : expect) {
+            REQUIRE(cache.find(k) != nullptr);
+            REQUIRE(*cache.find(k) == v);
+        }
+        REQUIRE(cache.find(make_key(100, 100)) == nullptr);
+    }
+
+    SECTION("reuse after clear")
+    {
+        StorageProxyCache<uint64_t> cache;
+        run_inserts(cache, 1000);
+        cache.clear();
+
+        REQUIRE(cache.size() == 0);
+        REQUIRE(cache.find(insert_order[0]) == nullptr);
+
+        expect.clear();
+        insert_order.clear();
+
+        // picks up recycled buffers from the first use
+        StorageProxyCache<uint64_t> cache2;
+        run_inserts(cache2, 500);
+        check(cache2);
+
+        expect.clear();
+        insert_order.clear();
+
+        run_inserts(cache, 100);
+        check(cache);
+    }
+
+    SECTION("stable references")
+    {
+        StorageProxyCache<uint64_t> cache;
+        auto& v0 = cache.try_emplace(make_key(0, 0), 1234).first;
+        for (uint32_t i = 1; i < 1000; i++) {
+            cache.try_emplace(make_key(0, i), i);
+        }
+        REQUIRE(&v0 == cache.find(make_key(0, 0)));
+        REQUIRE(v0 == 1234);
+    }
+}
+
+} // namespace scs
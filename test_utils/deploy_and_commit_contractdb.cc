@@ -45,7 +45,7 @@ deploy_and_commit_contractdb(ContractDB& contract_db,
     {
         TransactionRewind rewind;
 
-        proxy.push_updates_to_db(rewind);
+        REQUIRE(proxy.push_updates_to_db(rewind));
 
         rewind.commit();
     }
@@ -0,0 +1,87 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace scs {
+
+namespace test {
+
+struct PairedWorkersResult
+{
+    uint64_t elapsed_ns;
+    // calls of fn that returned true
+    uint64_t successes;
+};
+
+/**
+ * Thread t calls fn(i) for each i in its own range
+ * [t * per_thread, (t + 1) * per_thread), interleaved with
+ * the same offsets in the next thread's range, so every index
+ * is raced on by two threads.  Threads start together.
+ */
+template<typename fn_t>
+PairedWorkersResult
+run_paired_workers(uint32_t num_threads, uint32_t per_thread, fn_t&& fn)
+{
+    std::atomic<bool> start = false;
+    std::atomic<uint64_t> successes = 0;
+
+    auto worker = [&](uint32_t t) {
+        const uint32_t mine = t * per_thread;
+        const uint32_t theirs = ((t + 1) % num_threads) * per_thread;
+
+        uint64_t local_successes = 0;
+
+        while (!start.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+
+        for (uint32_t i = 0; i < per_thread; i++) {
+            local_successes += fn(mine + i);
+            local_successes += fn(theirs + i);
+        }
+        successes.fetch_add(local_successes);
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < num_threads; t++) {
+        threads.emplace_back(worker, t);
+    }
+
+    auto ts = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - ts)
+                       .count();
+
+    return PairedWorkersResult{ .elapsed_ns = static_cast<uint64_t>(elapsed),
+                                .successes = successes.load() };
+}
+
+} // namespace test
+
+} // namespace scs
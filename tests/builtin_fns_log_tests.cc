@@ -57,7 +57,7 @@ TEST_CASE("test log", "[builtin]")
     auto make_tx = [&](TransactionInvocation const& invocation)
         -> std::pair<Hash, SignedTransaction> {
         Transaction tx(
-            invocation, UINT64_MAX, 1, xdr::xvector<Contract>());
+            invocation, UINT64_MAX, 1, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
 
         SignedTransaction stx;
         stx.tx = tx;
@@ -0,0 +1,229 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "transaction_context/global_context.h"
+#include "transaction_context/execution_context.h"
+
+#include "crypto/hash.h"
+#include "test_utils/deploy_and_commit_contractdb.h"
+#include "utils/load_wasm.h"
+#include "utils/make_calldata.h"
+
+#include "threadlocal/threadlocal_context.h"
+
+#include "utils/simd_memory.h"
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+
+namespace scs {
+
+namespace {
+
+// Byte-at-a-time versions of the simd:: primitives.  The empty asm
+// on the index keeps gcc from vectorizing the loops
+// (or turning them back into libc calls).
+
+void
+byte_loop_copy(uint8_t* dst, const uint8_t* src, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = src[i];
+        asm volatile("" : "+r"(i));
+    }
+}
+
+void
+byte_loop_set(uint8_t* dst, uint8_t val, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = val;
+        asm volatile("" : "+r"(i));
+    }
+}
+
+int32_t
+byte_loop_compare(const uint8_t* lhs, const uint8_t* rhs, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (lhs[i] != rhs[i]) {
+            return static_cast<int32_t>(lhs[i]) - static_cast<int32_t>(rhs[i]);
+        }
+        asm volatile("" : "+r"(i));
+    }
+    return 0;
+}
+
+size_t
+byte_loop_find_zero(const uint8_t* ptr, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (ptr[i] == 0) {
+            return i;
+        }
+        asm volatile("" : "+r"(i));
+    }
+    return len;
+}
+
+// bytes per ns (GB/s) of reps calls of fn
+template<typename fn_t>
+double
+env_memory_throughput(size_t len, uint32_t reps, fn_t&& fn)
+{
+    auto ts = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < reps; i++) {
+        fn();
+        asm volatile("" ::: "memory");
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - ts)
+                       .count();
+    return static_cast<double>(len) * reps / elapsed;
+}
+
+} // namespace
+
+TEST_CASE("env memory fns", "[builtin]")
+{
+    test::DeferredContextClear defer;
+
+    GlobalContext scs_data_structures;
+    auto& script_db = scs_data_structures.contract_db;
+
+    auto c = load_wasm_from_file("cpp_contracts/bench_env_memory.wasm");
+    auto h = hash_xdr(*c);
+
+    test::deploy_and_commit_contractdb(script_db, h, c);
+
+    ExecutionContext<TxContext> exec_ctx;
+
+    BlockContext block_context(0);
+
+    struct bench_calldata
+    {
+        uint32_t len;
+        uint32_t reps;
+    };
+
+    auto exec_success = [&](uint32_t method, uint32_t len, uint32_t reps) {
+        TransactionInvocation invocation(
+            h, method, make_calldata(bench_calldata{ .len = len, .reps = reps }));
+
+        SignedTransaction stx;
+        stx.tx = Transaction(invocation, UINT64_MAX, 1, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
+
+        REQUIRE(exec_ctx.execute(hash_xdr(stx), stx, scs_data_structures, block_context)
+                == TransactionStatus::SUCCESS);
+
+        auto const& logs = exec_ctx.get_logs();
+        REQUIRE(logs.size() == 1);
+        return logs[0];
+    };
+
+    auto pattern_sum = [](uint32_t len) -> uint64_t {
+        uint64_t out = 0;
+        for (uint32_t i = 0; i < len; i++) {
+            out += (i % 255) + 1;
+        }
+        return out;
+    };
+
+    // lengths straddle the vector widths used on the host
+    for (uint32_t len : { 1u, 31u, 32u, 33u, 100u, 1000u })
+    {
+        SECTION("memcpy " + std::to_string(len))
+        {
+            REQUIRE(exec_success(0, len, 3) == make_calldata(pattern_sum(len)));
+        }
+        SECTION("memset " + std::to_string(len))
+        {
+            REQUIRE(exec_success(1, len, 3) == make_calldata(static_cast<uint64_t>(2 * len)));
+        }
+        SECTION("memcmp " + std::to_string(len))
+        {
+            REQUIRE(exec_success(2, len, 3) == make_calldata(static_cast<int32_t>(-1)));
+        }
+        SECTION("strnlen " + std::to_string(len))
+        {
+            REQUIRE(exec_success(3, len, 3) == make_calldata(len));
+        }
+    }
+}
+
+TEST_CASE("env memory fns throughput", "[.][builtin][bench]")
+{
+    // the sizes the contract bench uses, up to its buffer size
+    for (size_t len : { 64u, 1024u, 16384u })
+    {
+        std::vector<uint8_t> a(len + 1), b(len + 1);
+        auto fill = [&] {
+            for (size_t i = 0; i < len; i++) {
+                // never zero
+                a[i] = b[i] = (i % 255) + 1;
+            }
+            // differ only in the last byte, so every compare scans the whole range
+            b[len - 1]++;
+        };
+
+        const uint32_t reps = (1u << 28) / len;
+
+        struct result
+        {
+            const char* name;
+            double simd, bytes;
+        };
+        std::vector<result> results;
+
+        results.push_back({ "memcpy",
+            env_memory_throughput(len, reps, [&] { simd::copy(a.data(), b.data(), len); }),
+            env_memory_throughput(len, reps, [&] { byte_loop_copy(a.data(), b.data(), len); }) });
+        results.push_back({ "memset",
+            env_memory_throughput(len, reps, [&] { simd::set(a.data(), 1, len); }),
+            env_memory_throughput(len, reps, [&] { byte_loop_set(a.data(), 1, len); }) });
+
+        fill();
+        int32_t cmp_simd = 0, cmp_bytes = 0;
+        results.push_back({ "memcmp",
+            env_memory_throughput(len, reps, [&] { cmp_simd = simd::compare(a.data(), b.data(), len); }),
+            env_memory_throughput(len, reps, [&] { cmp_bytes = byte_loop_compare(a.data(), b.data(), len); }) });
+
+        size_t zero_simd = 0, zero_bytes = 0;
+        results.push_back({ "strnlen",
+            env_memory_throughput(len, reps, [&] { zero_simd = simd::find_zero(a.data(), len + 1); }),
+            env_memory_throughput(len, reps, [&] { zero_bytes = byte_loop_find_zero(a.data(), len + 1); }) });
+
+        for (auto const& r : results) {
+            std::printf("env %s len %zu: simd %.2f GB/s, byte loop %.2f GB/s (%.1fx)\n",
+                        r.name,
+                        len,
+                        r.simd,
+                        r.bytes,
+                        r.simd / r.bytes);
+        }
+
+        REQUIRE(cmp_simd == -1);
+        REQUIRE(cmp_simd == cmp_bytes);
+        REQUIRE(zero_simd == zero_bytes);
+        REQUIRE(zero_simd == len);
+    }
+}
+
+} // namespace scs
@@ -57,7 +57,7 @@ TEST_CASE("gas metering", "[gas]")
         TransactionInvocation invocation(h, 0, make_calldata(duration));
 
         Transaction tx = Transaction(
-            invocation, gas_limit, gas_bid, xdr::xvector<Contract>());
+            invocation, gas_limit, gas_bid, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
         SignedTransaction stx;
         stx.tx = tx;
 
@@ -80,7 +80,7 @@ TEST_CASE("gas metering", "[gas]")
         TransactionInvocation invocation(h, 1, make_calldata());
 
         Transaction tx = Transaction(
-            invocation, gas_limit, gas_bid, xdr::xvector<Contract>());
+            invocation, gas_limit, gas_bid, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
         SignedTransaction stx;
         stx.tx = tx;
 
@@ -59,7 +59,7 @@ TEST_CASE("hashset manipulation test contract", "[sdk][hashset]")
         TransactionInvocation invocation(h, round, make_calldata());
 
         Transaction tx = Transaction(
-            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>());
+            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
         SignedTransaction stx;
         stx.tx = tx;
 
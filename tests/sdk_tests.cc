@@ -76,7 +76,7 @@ TEST_CASE("replay cache", "[sdk]")
         TransactionInvocation invocation(h, 0, make_calldata(data));
 
         Transaction tx = Transaction(
-            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>());
+            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
         SignedTransaction stx;
         stx.tx = tx;
 
@@ -179,7 +179,7 @@ TEST_CASE("semaphore", "[sdk]")
         TransactionInvocation invocation(h, 1, make_calldata(data));
 
         Transaction tx = Transaction(
-            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>());
+            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
         SignedTransaction stx;
         stx.tx = tx;
 
@@ -208,7 +208,7 @@ TEST_CASE("semaphore", "[sdk]")
         TransactionInvocation invocation(h, 2, make_calldata(data));
 
         Transaction tx = Transaction(
-            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>());
+            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
         
         SignedTransaction stx;
         stx.tx = tx;
@@ -238,7 +238,7 @@ TEST_CASE("semaphore", "[sdk]")
         TransactionInvocation invocation(h, 3, make_calldata(data));
 
         Transaction tx = Transaction(
-            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>());
+            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
         
         SignedTransaction stx;
         stx.tx = tx;
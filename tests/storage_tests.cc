@@ -80,7 +80,7 @@ TEST_CASE("hashset insert", "[storage]")
         TransactionInvocation invocation(h, 0, make_calldata(data));
 
         Transaction tx = Transaction(
-            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>());
+            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
         SignedTransaction stx;
         stx.tx = tx;
 
@@ -195,7 +195,7 @@ TEST_CASE("int64 storage write", "[storage]")
         TransactionInvocation invocation(h, 1, make_calldata(data));
 
         Transaction tx = Transaction(
-            invocation, UINT64_MAX, 1, xdr::xvector<Contract>());
+            invocation, UINT64_MAX, 1, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
         SignedTransaction stx;
         stx.tx = tx;
         auto hash = hash_xdr(stx);
@@ -225,7 +225,7 @@ TEST_CASE("int64 storage write", "[storage]")
         TransactionInvocation invocation(h, 0, make_calldata(data));
 
         Transaction tx = Transaction(
-            invocation, UINT64_MAX, 1, xdr::xvector<Contract>());
+            invocation, UINT64_MAX, 1, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
         SignedTransaction stx;
         stx.tx = tx;
 
@@ -428,7 +428,7 @@ TEST_CASE("raw mem storage write", "[storage]")
         = [&](TransactionInvocation const& invocation)
         -> std::pair<Hash, SignedTransaction> {
         Transaction tx = Transaction(
-            invocation, UINT64_MAX, 1, xdr::xvector<Contract>());
+            invocation, UINT64_MAX, 1, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
         SignedTransaction stx;
         stx.tx = tx;
         auto hash = hash_xdr(stx);
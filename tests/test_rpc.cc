@@ -91,7 +91,7 @@ TEST_CASE("simulated echo rpc", "[rpc]")
         TransactionInvocation invocation(h, 0, make_calldata(rpc_calldata { .addr = rpcAddr, .value = calldata }));
 
         Transaction tx = Transaction(
-            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>());
+            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
         SignedTransaction stx;
         stx.tx = tx;
 
@@ -123,7 +123,7 @@ TEST_CASE("simulated echo rpc", "[rpc]")
         TransactionInvocation invocation(h, 0, make_calldata(rpc_calldata { .addr = rpcAddr, .value = calldata }));
 
         Transaction tx = Transaction(
-            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>());
+            invocation, UINT64_MAX, gas_bid, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
         SignedTransaction stx;
         stx.tx = tx;
 
@@ -213,7 +213,7 @@ TEST_CASE("test ensure ndet results all consumed", "[rpc]")
     auto make_tx = [&](TransactionInvocation const& invocation)
         -> std::pair<Hash, SignedTransaction> {
         Transaction tx(
-            invocation, UINT64_MAX, 1, xdr::xvector<Contract>());
+            invocation, UINT64_MAX, 1, xdr::xvector<Contract>(), xdr::xvector<AddressAndKey>());
 
         SignedTransaction stx;
         stx.tx = tx;
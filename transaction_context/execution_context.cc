@@ -34,12 +34,14 @@
 #include "transaction_context/global_context.h"
 
 #include "utils/defer.h"
+#include "utils/simd_memory.h"
 
 #include <utils/time.h>
 
 #include "common/syscall_nos.h"
 #include "builtin_fns/gas_costs.h"
 #include "contract_db/contract_utils.h"
+#include "hash_set/utils.h"
 
 #define EC_DECL(ret) template<typename TransactionContext_t> ret ExecutionContext<TransactionContext_t>
 
@@ -55,8 +57,32 @@ EC_DECL()::ExecutionContext()
     , tx_context(nullptr)
     , results_of_last_tx(nullptr)
     , addr_db(nullptr)
+    , calldata_buffers()
 {}
 
+EC_DECL(std::span<const uint8_t>)::stage_nested_calldata(
+    wasm_api::WasmRuntime& caller, uint32_t offset, uint32_t len)
+{
+    auto [mem, mlen] = caller.get_memory();
+
+    if (static_cast<uint64_t>(offset) + static_cast<uint64_t>(len) > mlen) {
+        throw HostError("calldata out of bounds");
+    }
+
+    // depth of the callee (the caller is already on the stack)
+    size_t depth = tx_context->get_invocation_depth();
+
+    if (calldata_buffers.size() <= depth) {
+        calldata_buffers.resize(depth + 1);
+    }
+
+    // Moving the outer vector in resize() does not move the inner
+    // buffers, so spans handed out for shallower frames stay valid.
+    auto& buf = calldata_buffers[depth];
+    buf.assign(mem + offset, mem + offset + len);
+    return { buf.data(), buf.size() };
+}
+
 
 EC_DECL(void)::invoke_subroutine(MethodInvocation const& invocation)
 {
@@ -98,7 +124,7 @@ EC_DECL(void)::invoke_subroutine(MethodInvocation const& invocation)
     tx_context->push_invocation_stack(runtime, invocation);
 
     runtime->template invoke<void>(
-        invocation.get_invocable_methodname().c_str());
+        invocation.get_invocable_methodname());
 
     tx_context->pop_invocation_stack();
 }
@@ -149,7 +175,7 @@ ExecutionContext<TransactionContext_t>::execute(Hash const& tx_hash,
     MethodInvocation invocation(tx.tx.invocation);
 
     tx_context = std::make_unique<TransactionContext_t>(
-        tx, tx_hash, scs_data_structures, block_context.block_number, nondeterministic_res);
+        tx, tx_hash, scs_data_structures, block_context.block_number, std::move(nondeterministic_res));
 
     defer d{ [this]() {
         extract_results();
@@ -157,6 +183,17 @@ ExecutionContext<TransactionContext_t>::execute(Hash const& tx_hash,
     } };
 
     try {
+        // a lone contract is metered (and charged for) when it is created.
+        // Otherwise they're metered in parallel up front, so they're
+        // paid for up front, whether or not they're created.
+        if (tx.tx.contracts_to_deploy.size() > 1) {
+            for (auto const& contract : tx.tx.contracts_to_deploy) {
+                tx_context -> consume_gas(gas_create_contract(contract.size()));
+            }
+            tx_context -> prepaid_contract_creations.assign(tx.tx.contracts_to_deploy.size(), true);
+            scs_data_structures.contract_db.premeter_contracts(tx.tx.contracts_to_deploy);
+        }
+
         invoke_subroutine(invocation);
     } catch (wasm_api::HostError& e) {
 	    std::printf("tx failed %s\n", e.what());
@@ -180,7 +217,7 @@ ExecutionContext<TransactionContext_t>::execute(Hash const& tx_hash,
     }
 
     // cannot be rewound -- this forms the threshold for commit
-    if (!block_context.tx_set.try_add_transaction(tx_hash, tx, tx_context -> tx_results->get_results().ndeterministic_results))
+    if (!block_context.tx_set.try_add_transaction(tx_hash, tx, tx_context -> tx_results->extract_nondeterministic_results()))
     {
         return TransactionStatus::FAILURE;
     }
@@ -221,30 +258,73 @@ EC_DECL()::~ExecutionContext()
   }
 }
 
+namespace {
+
+void
+check_linear_memory_range(uint32_t offset, uint32_t len, uint32_t mlen)
+{
+    if (static_cast<uint64_t>(offset) + static_cast<uint64_t>(len) > mlen) {
+        throw HostError("env: memory access out of bounds");
+    }
+}
+
+} // namespace
+
 EC_DECL(int32_t)::env_memcmp(uint32_t lhs, uint32_t rhs, uint32_t sz)
 {
     tx_context -> consume_gas(gas_memcmp(sz));
-    return tx_context -> get_current_runtime()->memcmp(lhs, rhs, sz);
+    auto [mem, mlen] = tx_context -> get_current_runtime()->get_memory();
+
+    check_linear_memory_range(lhs, sz, mlen);
+    check_linear_memory_range(rhs, sz, mlen);
+
+    return simd::compare(mem + lhs, mem + rhs, sz);
 }
 
 
 EC_DECL(uint32_t)::env_memset(uint32_t ptr, uint32_t val, uint32_t len)
 {
     tx_context -> consume_gas(gas_memset(len));
-    return tx_context -> get_current_runtime()->memset(ptr, val, len);
+    auto [mem, mlen] = tx_context -> get_current_runtime()->get_memory();
+
+    check_linear_memory_range(ptr, len, mlen);
+
+    simd::set(mem + ptr, static_cast<uint8_t>(val), len);
+    return ptr;
 }
 
 
 EC_DECL(uint32_t)::env_memcpy( uint32_t dst, uint32_t src, uint32_t len)
 {
     tx_context -> consume_gas(gas_memcpy(len));
-    return tx_context -> get_current_runtime()->safe_memcpy(dst, src, len);
+    auto [mem, mlen] = tx_context -> get_current_runtime()->get_memory();
+
+    check_linear_memory_range(dst, len, mlen);
+    check_linear_memory_range(src, len, mlen);
+
+    simd::copy(mem + dst, mem + src, len);
+    return dst;
 }
 
 EC_DECL(uint32_t)::env_strnlen(uint32_t ptr, uint32_t max_len)
 {
     tx_context -> consume_gas(gas_strnlen(max_len));
-    return tx_context -> get_current_runtime()->safe_strlen(ptr, max_len);
+    auto [mem, mlen] = tx_context -> get_current_runtime()->get_memory();
+
+    if (ptr > mlen) {
+        throw HostError("env: memory access out of bounds");
+    }
+
+    // The string may legitimately end before the end of memory
+    // even if ptr + max_len does not, so only scan what exists
+    // and fail if the scan runs off the end.
+    uint32_t scan_len = std::min<uint32_t>(max_len, mlen - ptr);
+
+    uint32_t len = simd::find_zero(mem + ptr, scan_len);
+    if (len == scan_len && scan_len < max_len) {
+        throw HostError("env: unterminated string");
+    }
+    return len;
 }
 
 EC_DECL(void)::gas_handler(uint64_t gas)
@@ -345,10 +425,13 @@ syscall_handler(uint64_t callno, uint64_t arg0, uint64_t arg1, uint64_t arg2, ui
 
         consume_gas(gas_invoke(calldata_len + return_len));
 
+        // Calldata must be copied out of the caller's memory:
+        // a reentrant call can write to (or grow) that memory
+        // while the callee is still reading its calldata.
         MethodInvocation invocation(
             load_from_memory_constsize.template operator()<Address>(arg0),
             methodname,
-            load_from_memory.template operator()<std::vector<uint8_t>>(calldata, calldata_len));
+            stage_nested_calldata(runtime, calldata, calldata_len));
 
         CONTRACT_INFO("call into %s method %lu",
                       debug::array_to_str(invocation.addr).c_str(),
@@ -642,21 +725,11 @@ syscall_handler(uint64_t callno, uint64_t arg0, uint64_t arg1, uint64_t arg2, ui
             throw HostError("type mismatch in hashset get_index_of");
         }
 
-        auto const& entries = res->body.hash_set().hashes;
-
-        // TODO reimplement with a binary search if need be
-        bool found = false;
-        for (auto i = 0u; i < entries.size(); i++)
-        {
-            if (entries[i].index == arg1) {
-                ret = i;
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
+        auto idx = hashset_find_index(res->body.hash_set(), arg1);
+        if (!idx) {
             throw HostError("key nexist (not found)");
         }
+        ret = *idx;
         break;
     }
     case HS_GET_INDEX:
@@ -697,10 +770,14 @@ syscall_handler(uint64_t callno, uint64_t arg0, uint64_t arg1, uint64_t arg2, ui
             throw HostError("Invalid deployable contract access");
         }
 
-        std::shared_ptr<const Contract> contract = std::make_shared<const Contract>(
-            tx_ctx.get_deployable_contract(contract_idx));
+        auto const& contract = tx_ctx.get_deployable_contract(contract_idx);
 
-        consume_gas(gas_create_contract(contract -> size()));
+        auto& prepaid = tx_ctx.prepaid_contract_creations;
+        if (contract_idx < prepaid.size() && prepaid[contract_idx]) {
+            prepaid[contract_idx] = false;
+        } else {
+            consume_gas(gas_create_contract(contract.size()));
+        }
 
         Hash h = tx_ctx.contract_db_proxy.create_contract(contract);
 
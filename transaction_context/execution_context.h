@@ -19,6 +19,8 @@
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <span>
+#include <vector>
 
 #include "transaction_context/global_context.h"
 
@@ -43,6 +45,14 @@ class ExecutionContext : public utils::NonMovableOrCopyable
 
     RpcAddressDB* addr_db;
 
+    // Calldata for nested invocations, indexed by call depth.
+    // Buffers are reused across invocations and transactions,
+    // so steady-state cross-contract calls do not allocate.
+    std::vector<std::vector<uint8_t>> calldata_buffers;
+
+    std::span<const uint8_t>
+    stage_nested_calldata(wasm_api::WasmRuntime& caller, uint32_t offset, uint32_t len);
+
     void invoke_subroutine(MethodInvocation const& invocation);
 
     auto& get_transaction_context()
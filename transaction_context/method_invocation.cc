@@ -16,43 +16,51 @@
 
 #include "transaction_context/method_invocation.h"
 
-#include <iomanip>
-#include <sstream>
-
 #include <utils/serialize_endian.h>
 
 namespace scs
 {
 
-MethodInvocation::MethodInvocation(TransactionInvocation const& root_invocation)
-	: addr(root_invocation.invokedAddress)
-	, method_name(root_invocation.method_name)
-	, calldata(root_invocation.calldata)
-	{}
+namespace
+{
 
-MethodInvocation::MethodInvocation(const Address& addr, uint32_t method, std::vector<uint8_t>&& calldata)
-	: addr(addr)
-	, method_name(method)
-	, calldata(std::move(calldata))
-	{}
+std::array<char, MethodInvocation::METHODNAME_BUF_LEN>
+make_invocable_methodname(uint32_t method_name)
+{
+	constexpr static char hex_chars[] = "0123456789ABCDEF";
 
+	std::array<char, MethodInvocation::METHODNAME_BUF_LEN> out;
+	out[0] = 'p';
+	out[1] = 'u';
+	out[2] = 'b';
 
-std::string 
-MethodInvocation::get_invocable_methodname() const
-{
-	std::stringstream ss;
-	ss << "pub";
-	ss << std::hex << std::uppercase << std::setw(2) << std::setfill('0');
 	uint8_t buf[4];
 
 	utils::write_unsigned_little_endian(buf, method_name);
 
 	for (auto i = 0u; i < 4; i++)
 	{
-		ss << std::setfill('0') << std::setw(2) << static_cast<int>(buf[i]);
+		out[3 + 2*i] = hex_chars[buf[i] >> 4];
+		out[4 + 2*i] = hex_chars[buf[i] & 0xF];
 	}
-
-	return ss.str();
+	out[11] = '\0';
+	return out;
 }
 
+} /* anonymous namespace */
+
+MethodInvocation::MethodInvocation(TransactionInvocation const& root_invocation)
+	: addr(root_invocation.invokedAddress)
+	, method_name(root_invocation.method_name)
+	, calldata(root_invocation.calldata.data(), root_invocation.calldata.size())
+	, invocable_methodname(make_invocable_methodname(method_name))
+	{}
+
+MethodInvocation::MethodInvocation(const Address& addr, uint32_t method, std::span<const uint8_t> calldata)
+	: addr(addr)
+	, method_name(method)
+	, calldata(calldata)
+	, invocable_methodname(make_invocable_methodname(method_name))
+	{}
+
 } /* scs */
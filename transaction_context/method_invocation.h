@@ -16,8 +16,9 @@
  * limitations under the License.
  */
 
+#include <array>
 #include <cstdint>
-#include <vector>
+#include <span>
 
 #include "xdr/types.h"
 #include "xdr/transaction.h"
@@ -33,13 +34,31 @@ struct MethodInvocation
 	// Here, public/private is denoted by method prefix
 	// full method name is pub{XXXX}
 	const uint32_t method_name;
-	const std::vector<uint8_t> calldata;
 
-	std::string 
-	get_invocable_methodname() const;
+	// Calldata is never owned by an invocation.
+	// Root invocations point into the SignedTransaction,
+	// and nested invocations point into a buffer owned
+	// by the ExecutionContext (one per call depth), 
+	// both of which outlive the invocation.
+	const std::span<const uint8_t> calldata;
+
+	// "pub" + 8 hex chars + null terminator
+	constexpr static size_t METHODNAME_BUF_LEN = 12;
+
+private:
+
+	std::array<char, METHODNAME_BUF_LEN> invocable_methodname;
+
+public:
+
+	const char* 
+	get_invocable_methodname() const
+	{
+		return invocable_methodname.data();
+	}
 
 	MethodInvocation(TransactionInvocation const& root_invocation);
-	MethodInvocation(const Address& addr, uint32_t method, std::vector<uint8_t>&& calldata);
+	MethodInvocation(const Address& addr, uint32_t method, std::span<const uint8_t> calldata);
 };
 
 } /* scs */
@@ -37,7 +37,7 @@ TC_DECL::TransactionContext(SignedTransaction const& tx,
                                        Hash const& tx_hash,
                                        GlobalContext_t& global_context,
                                        uint64_t current_block,
-                                       std::optional<NondeterministicResults> const& results)
+                                       std::optional<NondeterministicResults>&& results)
     : invocation_stack()
     , runtime_stack()
     , tx(tx)
@@ -45,7 +45,7 @@ TC_DECL::TransactionContext(SignedTransaction const& tx,
     , gas_used(0)
     , current_block(current_block)
     , return_buf()
-    , tx_results(results ? new TransactionResultsFrame(*results) : new TransactionResultsFrame())
+    , tx_results(results ? new TransactionResultsFrame(std::move(*results)) : new TransactionResultsFrame())
     , storage_proxy(global_context.state_db)
     , contract_db_proxy(global_context.contract_db)
 {}
@@ -162,7 +162,9 @@ TC_DECL::push_storage_deltas()
         return nullptr;
     }
 
-    contract_db_proxy.push_updates_to_db(commitment->rewind);
+    if (!contract_db_proxy.push_updates_to_db(commitment->rewind)) {
+        return nullptr;
+    }
 
     return commitment;
 }
@@ -85,6 +85,11 @@ public:
 
 	void consume_gas(uint64_t gas_to_consume);
 
+	// by deployable contract index: charged gas_create_contract()
+	// before execution, so the first CONTRACT_CREATE of that
+	// contract charges nothing more (later ones pay again)
+	std::vector<bool> prepaid_contract_creations;
+
 	std::vector<uint8_t> return_buf;
 
 	std::unique_ptr<TransactionResultsFrame> tx_results;
@@ -97,12 +102,11 @@ public:
 		Hash const& tx_hash, 
 		GlobalContext_t& scs_data_structures,
 		uint64_t current_block,
-		std::optional<NondeterministicResults> const& = std::nullopt);
+		std::optional<NondeterministicResults>&& = std::nullopt);
 
 	std::unique_ptr<TransactionResults> extract_results()
 	{
-		// TODO some copies to be removed here
-		auto out = std::make_unique<TransactionResults>(tx_results -> get_results());
+		auto out = std::make_unique<TransactionResults>(tx_results -> extract_results());
 		tx_results.reset();
 		return out;
 	}
@@ -151,6 +155,11 @@ public:
 	WitnessEntry const&
 	get_witness(uint64_t wit_idx) const;
 
+	size_t get_invocation_depth() const
+	{
+		return invocation_stack.size();
+	}
+
 	void pop_invocation_stack();
 	void push_invocation_stack(wasm_api::WasmRuntime* runtime, MethodInvocation const& invocation);
 
@@ -27,7 +27,7 @@ using xdr::operator==;
 void
 TransactionResultsFrame::add_log(TransactionLog log)
 {
-	results.logs.push_back(log);
+	results.logs.push_back(std::move(log));
 }
 
 void
@@ -35,7 +35,7 @@ TransactionResultsFrame::add_rpc_result(RpcResult result)
 {
 	if (!validating)
 	{
-		results.ndeterministic_results.rpc_results.push_back(result);
+		results.ndeterministic_results.rpc_results.push_back(std::move(result));
 	} 
 	else
 	{
@@ -34,11 +34,11 @@ class TransactionResultsFrame
 
 public:
 
-    TransactionResultsFrame(NondeterministicResults const& res)
+    TransactionResultsFrame(NondeterministicResults&& res)
         : results()
         , validating(true)
         {
-            results.ndeterministic_results = res;
+            results.ndeterministic_results = std::move(res);
         }
     TransactionResultsFrame()
         : results()
@@ -55,8 +55,18 @@ public:
     void add_rpc_result(RpcResult result);
     RpcResult get_next_rpc_result();
 
-    TransactionResults get_results() {
-        return results;
+    // Both of these move out of the frame.
+    // Nondeterministic results are moved into the block's tx set
+    // once a tx commits, and the remainder (i.e. logs)
+    // are moved out when the tx context is torn down.
+    NondeterministicResults&& extract_nondeterministic_results()
+    {
+        return std::move(results.ndeterministic_results);
+    }
+
+    TransactionResults&& extract_results()
+    {
+        return std::move(results);
     }
 
     bool validating_check_all_rpc_results_used() const;
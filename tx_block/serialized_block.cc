@@ -0,0 +1,76 @@
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tx_block/serialized_block.h"
+
+#include <xdrpp/marshal.h>
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace scs {
+
+void
+SerializedBlock::reset(size_t n, size_t len)
+{
+    if (n > UINT32_MAX || len < HEADER_LEN) {
+        throw std::runtime_error("invalid serialized block size");
+    }
+    num_txs = n;
+    bytes.resize(len);
+
+    // big-endian, as in XDR
+    uint8_t* header = bytes.data();
+    header[0] = num_txs >> 24;
+    header[1] = num_txs >> 16;
+    header[2] = num_txs >> 8;
+    header[3] = num_txs;
+}
+
+Block
+SerializedBlock::to_block() const
+{
+    Block out;
+    if (bytes.size() == 0) {
+        return out;
+    }
+    xdr::xdr_get g(bytes.data(), bytes.data() + bytes.size());
+    xdr::xdr_argpack_archive(g, out);
+    g.done();
+    return out;
+}
+
+int
+save_xdr_to_file_fast(SerializedBlock& block, const char* filename, AsyncIO& io)
+{
+    std::vector<FileWrite> files(1);
+    files[0].filename = filename;
+    files[0].contents = std::move(block.bytes);
+
+    int res = 0;
+    try {
+        write_files_durable(io, files);
+    } catch (std::runtime_error const&) {
+        res = -1;
+    }
+
+    // keep the buffer for the next block
+    block.bytes = std::move(files[0].contents);
+    return res;
+}
+
+} // namespace scs
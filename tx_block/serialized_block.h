@@ -0,0 +1,67 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "persistence/async_io.h"
+
+#include "xdr/block.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace scs {
+
+/**
+ * The XDR encoding of a Block, assembled directly
+ * from the serialized entries of a tx set.
+ *
+ * The buffer is aligned for direct io, so persisting
+ * the block writes it out as is.
+ */
+class SerializedBlock
+{
+    AlignedBuffer bytes;
+    uint32_t num_txs = 0;
+
+    friend int save_xdr_to_file_fast(
+        SerializedBlock& block, const char* filename, AsyncIO& io);
+
+  public:
+    // XDR length of Block::transactions
+    constexpr static size_t HEADER_LEN = 4;
+
+    // Sizes the buffer for num_txs entries totalling len bytes
+    // (header included), and writes the header.
+    void reset(size_t num_txs, size_t len);
+
+    uint8_t* data() { return bytes.data(); }
+    const uint8_t* data() const { return bytes.data(); }
+    size_t size() const { return bytes.size(); }
+
+    uint32_t num_transactions() const { return num_txs; }
+
+    // decodes the block -- for testing
+    Block to_block() const;
+};
+
+/*! Persist a serialized block, in place of save_xdr_to_file_fast()
+    for the decoded Block.  Durable on return.
+*/
+int __attribute__((warn_unused_result))
+save_xdr_to_file_fast(SerializedBlock& block, const char* filename, AsyncIO& io);
+
+} // namespace scs
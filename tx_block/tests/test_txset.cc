@@ -0,0 +1,93 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "tx_block/tx_set.h"
+#include "xdr/transaction.h"
+#include "crypto/hash.h"
+
+#include <xdrpp/marshal.h>
+#include <xdrpp/types.h>
+
+#include <algorithm>
+
+namespace scs {
+
+using xdr::operator==;
+
+TEST_CASE("test txset serialized block", "[txset]")
+{
+    TxSet set;
+
+    auto add_tx = [&] (SignedTransaction const& stx)
+    {
+        auto h = hash_xdr(stx);
+        return set.try_add_transaction(h, stx, NondeterministicResults());
+    };
+
+    auto simple_make_tx = [] (uint64_t nonce) {
+
+        SignedTransaction t;
+        t.tx.gas_limit = nonce;
+        return t;
+    };
+
+    SECTION("empty")
+    {
+        set.finalize();
+
+        SerializedBlock b;
+        set.serialize_block(b);
+
+        REQUIRE(b.num_transactions() == 0);
+        REQUIRE(b.to_block().transactions.size() == 0);
+        REQUIRE(b.size() == SerializedBlock::HEADER_LEN);
+    }
+
+    SECTION("matches xdr encoding")
+    {
+        for (uint64_t i = 0; i < 1000; i++) {
+            REQUIRE(add_tx(simple_make_tx(i)));
+        }
+        // second result for a tx already in the set
+        REQUIRE(add_tx(simple_make_tx(5)));
+
+        set.finalize();
+
+        SerializedBlock b;
+        set.serialize_block(b);
+
+        REQUIRE(b.num_transactions() == 1000);
+
+        auto block = b.to_block();
+        REQUIRE(block.transactions.size() == 1000);
+
+        auto expect = xdr::xdr_to_opaque(block);
+        REQUIRE(expect.size() == b.size());
+        REQUIRE(std::equal(expect.begin(), expect.end(), b.data()));
+
+        for (auto const& entry : block.transactions) {
+            REQUIRE(entry.nondeterministic_results.size() == set.contains_tx(hash_xdr(entry.tx)));
+        }
+        REQUIRE(set.contains_tx(hash_xdr(simple_make_tx(5))) == 2);
+    }
+
+    SECTION("buffer reuse")
+    {
+        for (uint64_t i = 0; i < 100; i++) {
+            REQUIRE(add_tx(simple_make_tx(i)));
+        }
+        set.finalize();
+
+        SerializedBlock b;
+        set.serialize_block(b);
+
+        set.clear();
+        REQUIRE(add_tx(simple_make_tx(1000)));
+        set.finalize();
+
+        set.serialize_block(b);
+        REQUIRE(b.num_transactions() == 1);
+        REQUIRE(b.to_block().transactions.at(0).tx == simple_make_tx(1000));
+    }
+}
+
+} // namespace scs
@@ -18,6 +18,11 @@
 
 #include <xdrpp/types.h>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <cstring>
+
 namespace scs {
 
 using xdr::operator==;
@@ -58,15 +63,18 @@ struct ResultListInsertFn
 
 
         if (main_entry.nondeterministic_results.size() == 0) {
-            main_entry.tx = other_entry.tx;
+            main_entry.tx = std::move(other_entry.tx);
         }
-        if (other_entry.nondeterministic_results.size() > 0 && main_entry.tx != other_entry.tx) {
+        else if (other_entry.nondeterministic_results.size() > 0 && main_entry.tx != other_entry.tx) {
             throw std::runtime_error("tx mismatch");
         }
         main_entry.nondeterministic_results.insert(
             main_entry.nondeterministic_results.end(), 
-            other_entry.nondeterministic_results.begin(), 
-            other_entry.nondeterministic_results.end());
+            std::make_move_iterator(other_entry.nondeterministic_results.begin()), 
+            std::make_move_iterator(other_entry.nondeterministic_results.end()));
+
+        // off the block finalization path
+        main_value.reserialize();
     }
 
     static TxSetEntry new_value(TxSet::prefix_t const& key)
@@ -75,18 +83,28 @@ struct ResultListInsertFn
     }
 };
 
-static TxSetEntry const& get_txset_entry(trie::ByteArrayPrefix<sizeof(Hash)> const&, const LockableTxSetEntry& entry)
+static std::span<const uint8_t> get_txset_serialization(trie::ByteArrayPrefix<sizeof(Hash)> const&, const LockableTxSetEntry& entry)
 {
-    return entry.get();
+    return entry.serialization();
+}
+
+static TxSetEntry
+make_txset_entry(const SignedTransaction& tx, NondeterministicResults&& nres)
+{
+    // not TxSetEntry(tx, {nres}), which copies nres out of the initializer list
+    TxSetEntry out;
+    out.tx = tx;
+    out.nondeterministic_results.push_back(std::move(nres));
+    return out;
 }
 
 bool
-TxSet::try_add_transaction(const Hash& hash, const SignedTransaction& tx, const NondeterministicResults& nres)
+TxSet::try_add_transaction(const Hash& hash, const SignedTransaction& tx, NondeterministicResults&& nres)
 {
     assert_txs_not_merged();
     auto& local_trie = cache.get(txs);
     local_trie.template insert<ResultListInsertFn, TxSetEntry>(
-        hash, TxSetEntry(tx, xdr::xvector<NondeterministicResults>{nres}));
+        hash, make_txset_entry(tx, std::move(nres)));
     return true;
 }
 
@@ -98,11 +116,27 @@ TxSet::finalize()
 }
 
 void 
-TxSet::serialize_block(Block& out) const
+TxSet::serialize_block(SerializedBlock& out) const
 {
     assert_txs_merged();
 
-    txs.accumulate_values_parallel<decltype(out.transactions), get_txset_entry>(out.transactions, 10);
+    std::vector<std::span<const uint8_t>> entries;
+    txs.accumulate_values_parallel<decltype(entries), get_txset_serialization>(entries, 10);
+
+    std::vector<size_t> offsets(entries.size() + 1);
+    offsets[0] = SerializedBlock::HEADER_LEN;
+    for (size_t i = 0; i < entries.size(); i++) {
+        offsets[i + 1] = offsets[i] + entries[i].size();
+    }
+
+    out.reset(entries.size(), offsets.back());
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, entries.size(), 1000),
+        [&](auto r) {
+            for (size_t i = r.begin(); i < r.end(); i++) {
+                std::memcpy(out.data() + offsets[i], entries[i].data(), entries[i].size());
+            }
+        });
 }
 
 Hash
@@ -28,27 +28,38 @@
 #include <xdrpp/marshal.h>
 
 #include <mutex>
+#include <span>
 
 #include "config/static_constants.h"
 
+#include "tx_block/serialized_block.h"
+
 namespace scs {
 
+/**
+ * Keeps the XDR serialization of the entry alongside it,
+ * so that hashing the trie and building the block
+ * never serialize an entry again.
+ */
 class LockableTxSetEntry
 {
     std::mutex mtx;
     TxSetEntry entry;
+    xdr::opaque_vec<> serialized;
 
 public:
 
     LockableTxSetEntry()
         : mtx()
         , entry()
+        , serialized(xdr::xdr_to_opaque(entry))
         {}
 
     LockableTxSetEntry& operator=(TxSetEntry&& other)
     {
         std::lock_guard lock(mtx);
         entry = std::move(other);
+        reserialize();
         return *this;
     }
 
@@ -57,6 +68,7 @@ public:
         return {mtx, std::adopt_lock};
     }
 
+    // caller must reserialize() after modifying the entry
     TxSetEntry& get()
     {
         return entry;
@@ -67,9 +79,18 @@ public:
         return entry;
     }
 
+    void reserialize()
+    {
+        serialized = xdr::xdr_to_opaque(entry);
+    }
+
+    std::span<const uint8_t> serialization() const
+    {
+        return {serialized.data(), serialized.size()};
+    }
+
     void copy_data(std::vector<uint8_t>& buf) const {
-        auto serialization = xdr::xdr_to_opaque(entry);
-        buf.insert(buf.end(), serialization.begin(), serialization.end());
+        buf.insert(buf.end(), serialized.begin(), serialized.end());
     }
 };
 
@@ -106,11 +127,12 @@ class TxSet
     void assert_txs_not_merged() const;
 
   public:
-    bool try_add_transaction(const Hash& hash, const SignedTransaction& tx, const NondeterministicResults& nres);
+    bool try_add_transaction(const Hash& hash, const SignedTransaction& tx, NondeterministicResults&& nres);
 
     void finalize();
 
-    void serialize_block(Block& out) const;
+    // one memcpy per tx, from the serializations cached at insert
+    void serialize_block(SerializedBlock& out) const;
 
     Hash hash();
 
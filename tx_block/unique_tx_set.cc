@@ -33,7 +33,7 @@ struct UniqueInsertFn
     {
         if (main_entry.nondeterministic_results.size() == 0)
         {
-            main_entry = other_entry;
+            main_entry = std::move(other_entry);
         }
 
         if (main_entry.nondeterministic_results.size() == 0)
@@ -76,13 +76,23 @@ static TxSetEntry const& get_txset_entry(trie::ByteArrayPrefix<sizeof(Hash)> con
     return entry;
 }
 
+static TxSetEntry
+make_txset_entry(const SignedTransaction& tx, NondeterministicResults&& nres)
+{
+    // not TxSetEntry(tx, {nres}), which copies nres out of the initializer list
+    TxSetEntry out;
+    out.tx = tx;
+    out.nondeterministic_results.push_back(std::move(nres));
+    return out;
+}
+
 bool
-UniqueTxSet::try_add_transaction(const Hash& hash, const SignedTransaction& tx, const NondeterministicResults& nres)
+UniqueTxSet::try_add_transaction(const Hash& hash, const SignedTransaction& tx, NondeterministicResults&& nres)
 {
     assert_txs_not_merged();
     auto& local_trie = cache.get(txs);
     return local_trie.template insert<UniqueInsertFn, TxSetEntry>(
-        hash, TxSetEntry(tx, xdr::xvector<NondeterministicResults>{nres}));
+        hash, make_txset_entry(tx, std::move(nres)));
 }
 
 void
@@ -64,7 +64,7 @@ class UniqueTxSet
 
   public:
 
-    bool try_add_transaction(const Hash& hash, const SignedTransaction& tx, const NondeterministicResults& nres);
+    bool try_add_transaction(const Hash& hash, const SignedTransaction& tx, NondeterministicResults&& nres);
 
     void finalize();
 
@@ -61,6 +61,16 @@ public:
 		return lowbits.load(std::memory_order_relaxed);
 	}
 
+	// Value as a signed 128-bit int.  For when the subs matching
+	// some adds may go to a different AtomicUint128 (so one
+	// accumulator can go negative), and the caller sums several.
+	__int128 fetch_signed()
+	{
+		int64_t high = static_cast<int64_t>(highbits.load(std::memory_order_relaxed));
+		return (static_cast<__int128>(high) << 64)
+			+ lowbits.load(std::memory_order_relaxed);
+	}
+
 	void clear()
 	{
 		highbits.store(0, std::memory_order_relaxed);
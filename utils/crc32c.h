@@ -0,0 +1,98 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+/**
+ * CRC32C (Castagnoli), for checksumming on-disk log records.
+ * Uses the SSE4.2 crc32 instruction when available.
+ *
+ * Usage: crc = crc32c::extend(crc32c::INIT, data, len) (repeatedly),
+ * then crc32c::finish(crc).
+ */
+
+namespace scs
+{
+
+namespace crc32c
+{
+
+constexpr static uint32_t INIT = 0xFFFF'FFFF;
+
+namespace detail
+{
+
+constexpr std::array<uint32_t, 256>
+make_table()
+{
+    std::array<uint32_t, 256> out {};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int j = 0; j < 8; j++) {
+            c = (c & 1) ? (0x82F6'3B78 ^ (c >> 1)) : (c >> 1);
+        }
+        out[i] = c;
+    }
+    return out;
+}
+
+constexpr static std::array<uint32_t, 256> TABLE = make_table();
+
+} // namespace detail
+
+inline uint32_t
+extend(uint32_t crc, const uint8_t* data, size_t len)
+{
+    size_t i = 0;
+#if defined(__SSE4_2__)
+    uint64_t c = crc;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        c = _mm_crc32_u64(c, word);
+    }
+    crc = static_cast<uint32_t>(c);
+#endif
+    for (; i < len; i++) {
+        crc = detail::TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+inline uint32_t
+finish(uint32_t crc)
+{
+    return crc ^ 0xFFFF'FFFF;
+}
+
+inline uint32_t
+compute(const uint8_t* data, size_t len)
+{
+    return finish(extend(INIT, data, len));
+}
+
+} // namespace crc32c
+
+} // namespace scs
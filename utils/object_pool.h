@@ -0,0 +1,120 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace scs
+{
+
+/**
+ * Process-wide pool of heap-allocated T, for objects that are
+ * allocated on one set of threads and freed on another
+ * (e.g. allocated during execution, released during parallel commit).
+ *
+ * Each thread keeps a small free list; when that overflows,
+ * a batch moves to a shared free list (under a mutex),
+ * where threads with an empty free list pick it back up.
+ * The shared list holds at most SHARED_MAX objects; past that,
+ * batches are freed, so a burst of allocations doesn't stay
+ * pinned in the pool.
+ *
+ * Objects come back as they were released (caller resets them).
+ */
+template<typename T, size_t LOCAL_MAX = 256, size_t BATCH = 64, size_t SHARED_MAX = 1 << 16>
+class ObjectPool
+{
+    static_assert(BATCH <= LOCAL_MAX, "batch must fit in local list");
+
+    using list_t = std::vector<std::unique_ptr<T>>;
+
+    struct Shared
+    {
+        std::mutex mtx;
+        list_t free;
+    };
+
+    static Shared& get_shared()
+    {
+        static Shared shared;
+        return shared;
+    }
+
+    static list_t& get_local()
+    {
+        static thread_local list_t local;
+        return local;
+    }
+
+    ObjectPool() = delete;
+
+public:
+
+    static T* acquire()
+    {
+        auto& local = get_local();
+        if (local.empty())
+        {
+            auto& shared = get_shared();
+            std::lock_guard lock(shared.mtx);
+
+            size_t n = std::min(BATCH, shared.free.size());
+            local.insert(local.end(),
+                std::make_move_iterator(shared.free.end() - n),
+                std::make_move_iterator(shared.free.end()));
+            shared.free.resize(shared.free.size() - n);
+        }
+
+        if (local.empty())
+        {
+            return new T();
+        }
+
+        T* out = local.back().release();
+        local.pop_back();
+        return out;
+    }
+
+    static void release(T* obj)
+    {
+        auto& local = get_local();
+        local.emplace_back(obj);
+
+        if (local.size() > LOCAL_MAX)
+        {
+            auto& shared = get_shared();
+            {
+                std::lock_guard lock(shared.mtx);
+
+                if (shared.free.size() + BATCH <= SHARED_MAX)
+                {
+                    shared.free.insert(shared.free.end(),
+                        std::make_move_iterator(local.end() - BATCH),
+                        std::make_move_iterator(local.end()));
+                }
+            }
+            // frees the batch, unless it moved to the shared list
+            local.resize(local.size() - BATCH);
+        }
+    }
+};
+
+} /* scs */
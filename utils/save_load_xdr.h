@@ -12,6 +12,8 @@ Utilities for saving and loading xdr objects to disk
 
 #include "utils/cleanup.h"
 
+#include "persistence/async_io.h"
+
 namespace scs {
 
 /*! Load an xdr object from disk, dynamically allocating buffer for deserialization
@@ -43,56 +45,30 @@ load_xdr_from_file(xdr_type& output, const char* filename)  {
 	return 0;
 }
 
-#if 0
-
 /*! Load an xdr object from disk, 
-    reading the disk into \a buffer and deserializing from this buffer.
+    reading the file (with O_DIRECT, where supported) into \a buffer 
+    and deserializing from this buffer.  \a buffer can be reused across calls.
 */
 template<typename xdr_type>
 int __attribute__((warn_unused_result)) 
 load_xdr_from_file_fast(
 	xdr_type& output, 
 	const char* filename, 
-	unsigned char* buffer, 
-	size_t BUF_SIZE)
+	AsyncIO& io,
+	AlignedBuffer& buffer)
 {
-
-	#ifdef __APPLE__
-
-		return load_xdr_from_file(output, filename);
-
-	#else
-
-	void* buf_head = static_cast<void*>(buffer);
-	size_t aligned_buf_size = BUF_SIZE;
-	unsigned char* aligned_buf = reinterpret_cast<unsigned char*>(std::align(512, sizeof(unsigned char), buf_head, aligned_buf_size));
-
-	utils::unique_fd fd{open(filename, O_DIRECT | O_RDONLY)};
-
-	if (!fd) {
+	if (!read_file(io, filename, buffer)) {
 		return -1;
 	}
-	
-	aligned_buf_size -= aligned_buf_size % 512;
-
-	int bytes_read = read(fd.get(), aligned_buf, aligned_buf_size);
-
-	if (bytes_read == -1) {
-		utils::threrror("read error");
-	}
 
-	if (static_cast<size_t>(bytes_read) >= aligned_buf_size) {
-		throw std::runtime_error("buffer wasn't big enough");
-	}
- 	
- 	xdr::xdr_get g(aligned_buf, aligned_buf + bytes_read);
+ 	xdr::xdr_get g(buffer.data(), buffer.data() + buffer.size());
  	xdr::xdr_argpack_archive(g, output);
  	g.done();
  	return 0;
- 	
- 	#endif
 }
 
+#if 0
+
 namespace detail {
 
 static inline void 
@@ -145,22 +121,31 @@ save_xdr_to_file(const xdr_type& value, const char* filename) {
 	return 0;
 }
 
-/*
-template<typename xdr_type, uint32_t BUF_SIZE = 65536>
-void save_xdr_to_file_fast(const xdr_type& value, const char* filename, const size_t prealloc_size = 64000000)
+/*! Save xdr object to disk.
+    Serializes directly into an aligned buffer and writes it
+    with O_DIRECT (where supported).  Durable on return.
+*/
+template<typename xdr_type>
+int __attribute__((warn_unused_result))
+save_xdr_to_file_fast(const xdr_type& value, const char* filename, AsyncIO& io)
 {
-	uint8_t buffer[BUF_SIZE];
-	auto fd = preallocate_file(filename, prealloc_size);
-
-
+	std::vector<FileWrite> files(1);
+	files[0].filename = filename;
 
+	auto& buf = files[0].contents;
+	buf.resize(xdr::xdr_argpack_size(value));
 
+	xdr::xdr_put p(buf.data(), buf.data() + buf.size());
+	xdr::xdr_argpack_archive(p, value);
+	p.done();
 
-
-
-
-
-} */
+	try {
+		write_files_durable(io, files);
+	} catch (std::runtime_error const&) {
+		return -1;
+	}
+	return 0;
+}
 
 #if 0
 /*! Save an xdr object to disk
@@ -0,0 +1,56 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace scs
+{
+
+/**
+ * Non-cryptographic hash of a fixed-size byte array (Address, AddressAndKey),
+ * for in-memory open-addressed tables.
+ *
+ * Tables pick a fresh random seed (per table or per block),
+ * so colliding keys can't be precomputed; callers should still
+ * bound what a collision costs (probe limits, overflow).
+ */
+template<typename key_t>
+uint64_t
+seeded_hash(key_t const& key, uint64_t seed)
+{
+    static_assert(sizeof(key_t) % sizeof(uint64_t) == 0);
+
+    uint64_t h = seed;
+    for (size_t i = 0; i < sizeof(key_t); i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, key.data() + i, sizeof(uint64_t));
+        h = (h ^ word) * 0x9E37'79B9'7F4A'7C15ull;
+        // fold high bits down, else keys that differ only
+        // in high bits of each word collide for every seed
+        h ^= h >> 32;
+    }
+    // murmur3 finalizer
+    h ^= h >> 33;
+    h *= 0xff51'afd7'ed55'8ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+} // namespace scs
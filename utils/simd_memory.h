@@ -0,0 +1,154 @@
+#pragma once
+
+/**
+ * Copyright 2023 Geoffrey Ramseyer
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Vectorized byte-range primitives backing the env.mem* imports.
+ * Callers are responsible for bounds checking; these never read
+ * outside of [ptr, ptr + len).
+ *
+ * copy/set go straight to libc's memmove/memset, which are already
+ * vectorized (and pick the widest available ISA at load time).
+ * compare and find_zero are open-coded so that they can
+ * process a full vector per iteration without a function call
+ * per mismatch check.
+ */
+
+namespace scs
+{
+
+namespace simd
+{
+
+namespace detail
+{
+
+#if defined(__AVX2__)
+constexpr static size_t VEC_BYTES = 32;
+
+inline uint32_t
+eq_mask(const uint8_t* a, const uint8_t* b)
+{
+	__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+	__m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+	return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+}
+
+inline uint32_t
+zero_mask(const uint8_t* a)
+{
+	__m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+	return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, _mm256_setzero_si256())));
+}
+
+constexpr static uint32_t ALL_EQ = 0xFFFF'FFFF;
+
+#elif defined(__SSE2__)
+constexpr static size_t VEC_BYTES = 16;
+
+inline uint32_t
+eq_mask(const uint8_t* a, const uint8_t* b)
+{
+	__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+	__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+	return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)));
+}
+
+inline uint32_t
+zero_mask(const uint8_t* a)
+{
+	__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+	return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(va, _mm_setzero_si128())));
+}
+
+constexpr static uint32_t ALL_EQ = 0xFFFF;
+#endif
+
+} /* detail */
+
+inline void
+copy(uint8_t* dst, const uint8_t* src, size_t len)
+{
+	// contracts can (and do) pass overlapping ranges
+	std::memmove(dst, src, len);
+}
+
+inline void
+set(uint8_t* dst, uint8_t val, size_t len)
+{
+	std::memset(dst, val, len);
+}
+
+// same sign convention as std::memcmp (bytes compared as unsigned)
+inline int32_t
+compare(const uint8_t* lhs, const uint8_t* rhs, size_t len)
+{
+	size_t i = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+	for (; i + detail::VEC_BYTES <= len; i += detail::VEC_BYTES)
+	{
+		uint32_t mask = detail::eq_mask(lhs + i, rhs + i);
+		if (mask != detail::ALL_EQ)
+		{
+			size_t idx = i + __builtin_ctz(~mask);
+			return static_cast<int32_t>(lhs[idx]) - static_cast<int32_t>(rhs[idx]);
+		}
+	}
+#endif
+	for (; i < len; i++)
+	{
+		if (lhs[i] != rhs[i])
+		{
+			return static_cast<int32_t>(lhs[i]) - static_cast<int32_t>(rhs[i]);
+		}
+	}
+	return 0;
+}
+
+// returns the index of the first zero byte, or len if none
+inline size_t
+find_zero(const uint8_t* ptr, size_t len)
+{
+	size_t i = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+	for (; i + detail::VEC_BYTES <= len; i += detail::VEC_BYTES)
+	{
+		uint32_t mask = detail::zero_mask(ptr + i);
+		if (mask != 0)
+		{
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+	const void* res = std::memchr(ptr + i, 0, len - i);
+	if (res == nullptr)
+	{
+		return len;
+	}
+	return static_cast<const uint8_t*>(res) - ptr;
+}
+
+} /* simd */
+
+} /* scs */
@@ -59,6 +59,8 @@ VM(bool)::validate_tx_block(Block const& txs)
 {
     std::atomic<bool> found_error = false;
 
+    global_context.contract_db.prepare_for_block(txs.transactions.size());
+
     ValidateReduce reduce(
         found_error, global_context, *current_block_context, txs, executors);
 
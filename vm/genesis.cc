@@ -25,6 +25,8 @@
 
 #include "cpp_contracts/sdk/shared.h"
 
+#include <stdexcept>
+
 namespace scs {
 
 Address
@@ -58,7 +60,9 @@ install_genesis_contracts(ContractDB& contract_db)
     {
         TransactionRewind rewind;
 
-        proxy.push_updates_to_db(rewind);
+        if (!proxy.push_updates_to_db(rewind)) {
+            throw std::runtime_error("failed to install genesis contracts");
+        }
 
         rewind.commit();
     }
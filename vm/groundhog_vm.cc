@@ -56,6 +56,7 @@ BlockHeader
 GroundhogVirtualMachine::propose_tx_block(AssemblyLimits& limits, uint64_t max_time_ms, uint32_t n_threads, Block& block_out)
 {
 	auto ts = utils::init_time_measurement();
+    global_context.contract_db.prepare_for_block(limits.remaining_txs());
     ThreadlocalContextStore::get_rate_limiter().prep_for_notify();
     ThreadlocalContextStore::enable_rpcs();
     ThreadlocalContextStore::get_rate_limiter().start_threads(n_threads);
@@ -100,13 +101,19 @@ GroundhogVirtualMachine::propose_tx_block(AssemblyLimits& limits, uint64_t max_t
     			out.modified_keys_hash = current_block_context -> modified_keys_list.hash();
 		    });
 
-	global_context.contract_db.commit(get_current_block_number());
+	// contract db commit (and hash) is disjoint from the state db
+	tbb::task_group contracts;
+	contracts.run([&] ()
+		{
+			global_context.contract_db.commit(get_current_block_number());
+			out.contract_db_hash = global_context.contract_db.hash();
+		});
 	global_context.state_db.commit_modifications(current_block_context->modified_keys_list);
+	contracts.wait();
 	ThreadlocalContextStore::post_block_clear();
 
 	std::printf("done commit mods %lf\n", utils::measure_time(ts));
 	out.state_db_hash = global_context.state_db.hash();
-	out.contract_db_hash = global_context.contract_db.hash();
 
 	std::printf("done statedb hash %lf\n", utils::measure_time(ts));
     txset.wait();
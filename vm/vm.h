@@ -24,6 +24,8 @@
 #include "xdr/transaction.h"
 #include "xdr/block.h"
 
+#include "tx_block/serialized_block.h"
+
 #include <utils/non_movable.h>
 
 #include "vm/base_vm.h"
@@ -50,7 +52,7 @@ class VirtualMachine : public BaseVirtualMachine<GlobalContext, BlockContext>
 {
 
   public:
-    BlockHeader propose_tx_block(AssemblyLimits& limits, uint64_t max_time_ms, uint32_t n_threads, Block& out);
+    BlockHeader propose_tx_block(AssemblyLimits& limits, uint64_t max_time_ms, uint32_t n_threads, SerializedBlock& out);
 };
 
 #if 0
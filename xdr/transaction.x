@@ -44,6 +44,11 @@ struct Transaction
 	uint64 gas_rate_bid;
 
 	Contract contracts_to_deploy<>;
+
+	// Keys that the tx expects to touch.
+	// Only a hint (used for prefetching); accessing
+	// keys not listed here is always allowed.
+	AddressAndKey access_list<>;
 };
 
 struct WitnessEntry